@@ -0,0 +1,107 @@
+// File:   crc.cpp
+// Brief:  CRC calculation with hardware acceleration
+//------------------------------------------------------
+
+#include "crc.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define CRC16_CCITT_CLMUL 1
+  #include <emmintrin.h>
+  #include <tmmintrin.h>
+  #include <wmmintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #endif
+#else
+  #define CRC16_CCITT_CLMUL 0
+#endif
+
+#if CRC16_CCITT_CLMUL && (defined(__GNUC__) || defined(__clang__))
+  #define CRC16_CCITT_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+#else
+  #define CRC16_CCITT_CLMUL_TARGET
+#endif
+
+
+/* Calculate x^n mod P(x) at compile time */
+static constexpr uint64_t xPowerModPolynomial(unsigned n)
+{
+    uint32_t remainder = 1;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        remainder <<= 1;
+        if (remainder & 0x10000)
+            remainder ^= (0x10000 | CRC16_CCITT_POLYNOMIAL);
+    }
+    return remainder;
+}
+
+
+bool isCCITTCRC16ClmulSupported()
+{
+#if CRC16_CCITT_CLMUL && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool ssse3 = (info[2] & (1 << 9)) != 0;
+    const bool pclmul = (info[2] & (1 << 1)) != 0;
+    return ssse3 && pclmul;
+#elif CRC16_CCITT_CLMUL
+    return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("pclmul");
+#else
+    return false;
+#endif
+}
+
+
+CRC16_CCITT_CLMUL_TARGET
+uint16_t calculateCCITTCRC16Clmul(const uint8_t* message, const size_t numberOfBytes)
+{
+#if CRC16_CCITT_CLMUL
+    if (numberOfBytes < CRC16_CCITT_CLMUL_MINIMUM_SIZE)
+        return calculateCCITTCRC16Table(message, numberOfBytes);
+
+    // Blocks are loaded as 128-bit big-endian numbers, the first byte is the highest term
+    const __m128i byteSwap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    // Folding A(x) * x^128 + B(x) with A = H * x^64 + L gives
+    // H * (x^192 mod P) + L * (x^128 mod P) + B, which is congruent modulo P
+    const __m128i foldConstants = _mm_set_epi64x(static_cast<long long>(xPowerModPolynomial(192)),
+                                                 static_cast<long long>(xPowerModPolynomial(128)));
+
+    __m128i accumulator = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(message)), byteSwap);
+
+    // Initial CRC value 0xffff is equivalent to inverting the first two bytes of the message
+    accumulator = _mm_xor_si128(accumulator, _mm_set_epi64x(static_cast<long long>(0xffff000000000000ULL), 0));
+
+    size_t byte = 16;
+    for (; byte + 16 <= numberOfBytes; byte += 16)
+    {
+        __m128i block = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(message + byte)), byteSwap);
+        __m128i high = _mm_clmulepi64_si128(accumulator, foldConstants, 0x11);
+        __m128i low = _mm_clmulepi64_si128(accumulator, foldConstants, 0x00);
+        accumulator = _mm_xor_si128(_mm_xor_si128(high, low), block);
+    }
+
+    // CRC with zero initial value of the folded 16 bytes is the CRC of the processed
+    // part of the message, the remaining bytes continue from it
+    uint8_t folded[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(folded), _mm_shuffle_epi8(accumulator, byteSwap));
+
+    uint16_t crcValue = updateCCITTCRC16(0, folded, sizeof(folded));
+    return updateCCITTCRC16(crcValue, message + byte, numberOfBytes - byte);
+#else
+    return calculateCCITTCRC16Table(message, numberOfBytes);
+#endif
+}
+
+
+typedef uint16_t (*crc16Function_t)(const uint8_t*, const size_t);
+
+uint16_t calculateCCITTCRC16(const uint8_t* message, const size_t numberOfBytes)
+{
+    // Implementation selected at the first call, also when it comes from a static initializer
+    static const crc16Function_t crc16Function =
+        isCCITTCRC16ClmulSupported() ? calculateCCITTCRC16Clmul : calculateCCITTCRC16Table;
+
+    return crc16Function(message, numberOfBytes);
+}
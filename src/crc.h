@@ -5,12 +5,68 @@
 #ifndef _CRC_H_
 #define _CRC_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 
 #define CRC16_CCITT_POLYNOMIAL 0X1021 // X^16 + X^12 + X^
 
-/* Calculate CRC for provided data */
+/* Messages shorter than this are not worth folding with 'calculateCCITTCRC16Clmul()' */
+#define CRC16_CCITT_CLMUL_MINIMUM_SIZE 32
+
+/* Number of bytes processed per step by 'calculateCCITTCRC16()': 1 (one table), 4 or 8 */
+#ifndef CRC16_CCITT_SLICE_SIZE
+  #define CRC16_CCITT_SLICE_SIZE 8
+#endif
+
+#if (CRC16_CCITT_SLICE_SIZE != 1) && (CRC16_CCITT_SLICE_SIZE != 4) && (CRC16_CCITT_SLICE_SIZE != 8)
+  #error "CRC16_CCITT_SLICE_SIZE must be 1, 4 or 8."
+#endif
+
+
+/* Lookup tables for CRC calculation. 'm_value[k][b]' is CRC of byte 'b' followed by 'k' zero bytes. */
+struct Crc16Table
+{
+    uint16_t m_value[CRC16_CCITT_SLICE_SIZE][256];
+};
+
+/* Generate lookup tables at compile time */
+constexpr Crc16Table makeCCITTCRC16Table()
+{
+    Crc16Table table = {};
+
+    for (unsigned byte = 0; byte < 256; ++byte)
+    {
+        uint16_t crcValue = static_cast<uint16_t>(byte << 8);
+        for (uint8_t bit = 8; bit > 0; --bit)
+        {
+            if (crcValue & 0x8000)
+                crcValue = static_cast<uint16_t>((crcValue << 1) ^ CRC16_CCITT_POLYNOMIAL);
+            else
+                crcValue = static_cast<uint16_t>(crcValue << 1);
+        }
+        table.m_value[0][byte] = crcValue;
+    }
+
+    for (unsigned slice = 1; slice < CRC16_CCITT_SLICE_SIZE; ++slice)
+    {
+        for (unsigned byte = 0; byte < 256; ++byte)
+        {
+            const uint16_t previous = table.m_value[slice - 1][byte];
+            table.m_value[slice][byte] =
+                static_cast<uint16_t>((previous << 8) ^ table.m_value[0][previous >> 8]);
+        }
+    }
+
+    return table;
+}
+
+static constexpr Crc16Table CRC16_CCITT_TABLE = makeCCITTCRC16Table();
+
+
+/* Calculate CRC for provided data bit by bit (reference implementation) */
 template<typename T>
-uint16_t calculateCCITTCRC16(const T message, const size_t numberOfBytes)
+uint16_t calculateCCITTCRC16Bitwise(const T message, const size_t numberOfBytes)
 {
     uint16_t crcValue = 0xffff;
     uint16_t MSB_IN_UNIT16 = 0x8000;
@@ -32,5 +88,58 @@ uint16_t calculateCCITTCRC16(const T message, const size_t numberOfBytes)
     return crcValue;
 }
 
+/* Continue CRC calculation from 'crcValue' with the lookup tables */
+inline uint16_t updateCCITTCRC16(uint16_t crcValue, const uint8_t* message, const size_t numberOfBytes)
+{
+    const Crc16Table& table = CRC16_CCITT_TABLE;
+    size_t byte = 0;
+
+#if CRC16_CCITT_SLICE_SIZE > 1
+    // The 16-bit CRC is combined with the first two bytes of each slice, the CRC of every
+    // byte followed by the rest of the slice is then taken from its own table
+    const size_t N = CRC16_CCITT_SLICE_SIZE;
+
+    for (; byte + N <= numberOfBytes; byte += N)
+    {
+        uint16_t sliceCrc =
+            table.m_value[N - 1][message[byte] ^ (crcValue >> 8)] ^
+            table.m_value[N - 2][message[byte + 1] ^ (crcValue & 0xff)];
+        for (size_t i = 2; i < N; ++i)
+        {
+            sliceCrc ^= table.m_value[N - 1 - i][message[byte + i]];
+        }
+        crcValue = sliceCrc;
+    }
+#endif
+
+    // Remaining bytes with one table lookup per byte
+    for (; byte < numberOfBytes; ++byte)
+    {
+        crcValue = static_cast<uint16_t>((crcValue << 8) ^
+                                         table.m_value[0][(crcValue >> 8) ^ message[byte]]);
+    }
+    return crcValue;
+}
+
+/* Calculate CRC for provided data with the lookup tables */
+inline uint16_t calculateCCITTCRC16Table(const uint8_t* message, const size_t numberOfBytes)
+{
+    return updateCCITTCRC16(0xffff, message, numberOfBytes);
+}
+
+
+/* Check if the CPU supports carry-less multiplication used by 'calculateCCITTCRC16Clmul()' */
+bool isCCITTCRC16ClmulSupported();
+
+/**
+ * Calculate CRC for provided data by folding 16-byte blocks with PCLMULQDQ.
+ *
+ * Note: Must be called only if 'isCCITTCRC16ClmulSupported()' returns true.
+ */
+uint16_t calculateCCITTCRC16Clmul(const uint8_t* message, const size_t numberOfBytes);
+
+/* Calculate CRC for provided data with the fastest implementation supported by the CPU */
+uint16_t calculateCCITTCRC16(const uint8_t* message, const size_t numberOfBytes);
+
 
 #endif //_CRC_H_
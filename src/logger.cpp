@@ -5,28 +5,480 @@
 
 #include "logger.h"
 
-static log_handler_t log_handler;
-static bool debugModeEnabled = false;
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
-void logger_SetEnable(bool enable)
-{
-    debugModeEnabled = enable;
-}
+/* Number of messages in the log ring of each thread, power of two */
+#define LOG_RING_SIZE  256
 
-bool logger_IsDebugModeEnabled()
+/* Interval of delivering the messages to the handler in ms */
+#define LOG_FLUSH_INTERVAL_MS  10
+
+std::atomic<bool> logger_isDebugModeEnabled{false};
+
+namespace Logger
 {
-    return debugModeEnabled;
-}
 
-void logger_SetHandler(log_handler_t fn)
+    /* Types of the arguments in 'Record::m_arguments' */
+    enum ArgumentType : uint8_t
+    {
+        ARGUMENT_SIGNED   = 1,     // int64_t
+        ARGUMENT_UNSIGNED = 2,     // uint64_t
+        ARGUMENT_DOUBLE   = 3,     // double
+        ARGUMENT_CHAR     = 4,     // char
+        ARGUMENT_HEX      = 5,     // uint64_t
+        ARGUMENT_TEXT     = 6,     // uint16_t size and the characters
+    };
+
+    /**
+     * Messages of a single thread. The thread is the only producer and the logger thread is
+     * the only consumer, so the ring needs no locks.
+     */
+    class ThreadRing
+    {
+    public:
+        /* Place for the next message, nullptr if the ring is full */
+        Record* reserve()
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == LOG_RING_SIZE)
+            {
+                m_droppedCount.store(m_droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            return &m_records[head % LOG_RING_SIZE];
+        }
+
+        /* Pass the reserved message to the consumer */
+        void commit()
+        {
+            m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /* Oldest message, nullptr if the ring is empty */
+        const Record* front() const
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+                return nullptr;
+            return &m_records[tail % LOG_RING_SIZE];
+        }
+
+        void pop()
+        {
+            m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /* Number of messages dropped since the last call */
+        uint64_t takeDroppedCount()
+        {
+            const uint64_t count = m_droppedCount.load(std::memory_order_relaxed);
+            const uint64_t newCount = count - m_reportedDroppedCount;
+            m_reportedDroppedCount = count;
+            return newCount;
+        }
+
+        std::atomic<bool> m_isThreadFinished{false};
+
+    private:
+        Record                m_records[LOG_RING_SIZE];
+        std::atomic<size_t>   m_head{0};                    // written by the producer
+        std::atomic<size_t>   m_tail{0};                    // written by the consumer
+        std::atomic<uint64_t> m_droppedCount{0};            // written by the producer
+        uint64_t              m_reportedDroppedCount = 0;   // used by the consumer
+    };
+
+
+    /* Rings of all threads and the logger thread delivering their messages */
+    class Backend
+    {
+    public:
+        static Backend& instance()
+        {
+            static Backend backend;
+            return backend;
+        }
+
+        ~Backend();
+
+        void setEnable(bool enable);
+
+        void setHandler(log_handler_t handler) { m_handler.store(handler); }
+
+        /* Ring of the calling thread, created by the first message */
+        ThreadRing* threadRing();
+
+        uint64_t nextSequence() { return m_sequence.fetch_add(1, std::memory_order_relaxed); }
+
+    private:
+        Backend() = default;
+
+        /* Function of the logger thread */
+        void run();
+
+        /* Deliver all waiting messages in the order of logging */
+        void flush();
+
+        /* Format the arguments of the message */
+        static std::string format(const Record& record);
+
+        std::mutex                m_threadMutex;      // starting and stopping of the thread
+        std::thread               m_thread;
+        std::mutex                m_stopMutex;
+        std::condition_variable   m_stopCondition;
+        bool                      m_isStopping = false;
+
+        std::mutex                m_ringsMutex;
+        std::vector<std::shared_ptr<ThreadRing>> m_rings;
+
+        std::atomic<log_handler_t> m_handler{nullptr};
+        std::atomic<uint64_t>      m_sequence{0};
+    };
+
+
+    /* Owner of the ring in the thread, the ring is released after the thread finishes */
+    struct ThreadRingHolder
+    {
+        ~ThreadRingHolder()
+        {
+            if (m_ring)
+                m_ring->m_isThreadFinished = true;
+        }
+
+        std::shared_ptr<ThreadRing> m_ring;
+    };
+
+
+    Backend::~Backend()
+    {
+        setEnable(false);
+    }
+
+    void Backend::setEnable(bool enable)
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+
+        logger_isDebugModeEnabled = enable;
+
+        if (enable && !m_thread.joinable())
+        {
+            m_isStopping = false;
+            try
+            {
+                m_thread = std::thread(&Backend::run, this);
+            }
+            catch (const std::system_error&)
+            {
+                // Without the thread the messages stay in the rings
+            }
+        }
+        else if (!enable && m_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> stopLock(m_stopMutex);
+                m_isStopping = true;
+            }
+            m_stopCondition.notify_all();
+            m_thread.join();
+        }
+    }
+
+    ThreadRing* Backend::threadRing()
+    {
+        static thread_local ThreadRingHolder holder;
+
+        if (!holder.m_ring)
+        {
+            std::shared_ptr<ThreadRing> ring(new (std::nothrow) ThreadRing);
+            if (!ring)
+                return nullptr;
+
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            m_rings.push_back(ring);
+            holder.m_ring = std::move(ring);
+        }
+
+        return holder.m_ring.get();
+    }
+
+    void Backend::run()
+    {
+        std::unique_lock<std::mutex> lock(m_stopMutex);
+
+        while (!m_isStopping)
+        {
+            m_stopCondition.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    void Backend::flush()
+    {
+        /* Formatted message waiting for the handler */
+        struct Message
+        {
+            uint64_t    m_sequence;
+            const char* m_file;
+            int         m_line;
+            const char* m_function;
+            char        m_level;
+            std::string m_text;
+        };
+
+        std::vector<Message> messages;
+        const log_handler_t handler = m_handler.load();
+
+        {
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+            for (const std::shared_ptr<ThreadRing>& ring : m_rings)
+            {
+                const uint64_t droppedCount = ring->takeDroppedCount();
+                if (droppedCount > 0)
+                {
+                    messages.push_back({ m_sequence.load(std::memory_order_relaxed), __FILE__, __LINE__, LOG_FUNCTION, 'E',
+                                         std::to_string(droppedCount) + " debug message(s) dropped, the log ring is full." });
+                }
+
+                // The message is formatted before its place is returned to the producer
+                for (const Record* record = ring->front(); record != nullptr; record = ring->front())
+                {
+                    if (handler != nullptr)
+                    {
+                        messages.push_back({ record->m_sequence, record->m_file, record->m_line, record->m_function,
+                                             record->m_level, format(*record) });
+                    }
+                    ring->pop();
+                }
+            }
+
+            // Rings of the finished threads are not needed once they are empty
+            m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<ThreadRing>& ring)
+            {
+                return ring->m_isThreadFinished && (ring->front() == nullptr);
+            }), m_rings.end());
+        }
+
+        if (handler == nullptr)
+            return;
+
+        // Messages of all threads in the order of logging
+        std::stable_sort(messages.begin(), messages.end(), [](const Message& first, const Message& second)
+        {
+            return first.m_sequence < second.m_sequence;
+        });
+
+        for (const Message& message : messages)
+            handler(message.m_file, message.m_line, message.m_function, message.m_level, message.m_text.c_str(), message.m_text.size());
+    }
+
+    std::string Backend::format(const Record& record)
+    {
+        std::ostringstream stream;
+        size_t index = 0;
+
+        while (index < record.m_size)
+        {
+            const uint8_t type = record.m_arguments[index++];
+            const uint8_t* data = record.m_arguments + index;
+
+            switch (type)
+            {
+                case ARGUMENT_SIGNED:
+                {
+                    int64_t value;
+                    memcpy(&value, data, sizeof(value));
+                    stream << value;
+                    index += sizeof(value);
+                    break;
+                }
+                case ARGUMENT_UNSIGNED:
+                {
+                    uint64_t value;
+                    memcpy(&value, data, sizeof(value));
+                    stream << value;
+                    index += sizeof(value);
+                    break;
+                }
+                case ARGUMENT_DOUBLE:
+                {
+                    double value;
+                    memcpy(&value, data, sizeof(value));
+                    stream << value;
+                    index += sizeof(value);
+                    break;
+                }
+                case ARGUMENT_CHAR:
+                {
+                    stream << static_cast<char>(data[0]);
+                    index += 1;
+                    break;
+                }
+                case ARGUMENT_HEX:
+                {
+                    uint64_t value;
+                    memcpy(&value, data, sizeof(value));
+                    char text[24];
+                    snprintf(text, sizeof(text), "0x%02llx", static_cast<unsigned long long>(value));
+                    stream << text;
+                    index += sizeof(value);
+                    break;
+                }
+                case ARGUMENT_TEXT:
+                {
+                    uint16_t size;
+                    memcpy(&size, data, sizeof(size));
+                    stream.write(reinterpret_cast<const char*>(data + sizeof(size)), size);
+                    index += sizeof(size) + size;
+                    break;
+                }
+                default:
+                {
+                    index = record.m_size;
+                    break;
+                }
+            }
+        }
+
+        if (record.m_isTruncated)
+            stream << "...";
+
+        return stream.str();
+    }
+
+
+    RecordWriter::RecordWriter(const char* file, int line, const char* function, char level)
+    {
+        Backend& backend = Backend::instance();
+
+        m_ring = backend.threadRing();
+        m_record = (m_ring != nullptr) ? m_ring->reserve() : nullptr;
+        if (m_record == nullptr)
+            return;
+
+        m_record->m_file = file;
+        m_record->m_function = function;
+        m_record->m_sequence = backend.nextSequence();
+        m_record->m_line = line;
+        m_record->m_level = level;
+        m_record->m_isTruncated = false;
+        m_record->m_size = 0;
+    }
+
+    RecordWriter::~RecordWriter()
+    {
+        if (m_record != nullptr)
+            m_ring->commit();
+    }
+
+    RecordWriter& RecordWriter::operator<<(const char* text)
+    {
+        if (text == nullptr)
+            text = "(null)";
+        appendText(text, strlen(text));
+        return *this;
+    }
+
+    RecordWriter& RecordWriter::operator<<(const std::string& text)
+    {
+        appendText(text.data(), text.size());
+        return *this;
+    }
+
+    RecordWriter& RecordWriter::operator<<(char value)
+    {
+        append(ARGUMENT_CHAR, &value, sizeof(value));
+        return *this;
+    }
+
+    RecordWriter& RecordWriter::operator<<(double value)
+    {
+        append(ARGUMENT_DOUBLE, &value, sizeof(value));
+        return *this;
+    }
+
+    RecordWriter& RecordWriter::operator<<(Hex value)
+    {
+        append(ARGUMENT_HEX, &value.m_value, sizeof(value.m_value));
+        return *this;
+    }
+
+    void RecordWriter::appendSigned(int64_t value)
+    {
+        append(ARGUMENT_SIGNED, &value, sizeof(value));
+    }
+
+    void RecordWriter::appendUnsigned(uint64_t value)
+    {
+        append(ARGUMENT_UNSIGNED, &value, sizeof(value));
+    }
+
+    void RecordWriter::appendText(const char* text, size_t size)
+    {
+        if ((m_record == nullptr) || m_record->m_isTruncated)
+            return;
+
+        // Type, size and as much of the text as fits
+        const size_t space = RecordArgumentsSize - m_record->m_size;
+        if (space <= 1 + sizeof(uint16_t))
+        {
+            m_record->m_isTruncated = true;
+            return;
+        }
+
+        if (size > space - 1 - sizeof(uint16_t))
+        {
+            size = space - 1 - sizeof(uint16_t);
+            m_record->m_isTruncated = true;
+        }
+
+        const uint16_t textSize = static_cast<uint16_t>(size);
+        uint8_t* data = m_record->m_arguments + m_record->m_size;
+        data[0] = ARGUMENT_TEXT;
+        memcpy(data + 1, &textSize, sizeof(textSize));
+        memcpy(data + 1 + sizeof(textSize), text, size);
+        m_record->m_size = static_cast<uint16_t>(m_record->m_size + 1 + sizeof(textSize) + size);
+    }
+
+    void RecordWriter::append(uint8_t type, const void* data, size_t size)
+    {
+        if ((m_record == nullptr) || m_record->m_isTruncated)
+            return;
+
+        if (m_record->m_size + 1 + size > RecordArgumentsSize)
+        {
+            m_record->m_isTruncated = true;
+            return;
+        }
+
+        uint8_t* argument = m_record->m_arguments + m_record->m_size;
+        argument[0] = type;
+        memcpy(argument + 1, data, size);
+        m_record->m_size = static_cast<uint16_t>(m_record->m_size + 1 + size);
+    }
+
+} // namespace Logger
+
+
+void logger_SetEnable(bool enable)
 {
-    log_handler = fn;
+    Logger::Backend::instance().setEnable(enable);
 }
 
-void logger_LogLine(const char* file, int line,
-                    const char* function, char level,
-                    const std::string& str)
+void logger_SetHandler(log_handler_t fn)
 {
-    if (log_handler)
-        log_handler(file, line, function, level, str.c_str(), str.size());
+    Logger::Backend::instance().setHandler(fn);
 }
@@ -6,36 +6,145 @@
 #ifndef _LOGGER_H_
 #define _LOGGER_H_
 
+#include <atomic>
 #include <cstddef>
-#include <string>
 #include <sstream>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
 
 #define logFunctionBadUse "Bad use of the function."
 typedef void(*log_handler_t)(const char*, int, const char*, char, const char*, size_t);
 
+/* Messages compiled into the library: 0 - none, 1 - errors, 2 - errors and information */
+#ifndef TRACK_HAT_LOG_LEVEL
+#   define TRACK_HAT_LOG_LEVEL 2
+#endif
+
 #if defined _MSC_VER
 #   define LOG_FUNCTION __FUNCSIG__
 #else
 #   define LOG_FUNCTION __PRETTY_FUNCTION__
 #endif
 
+/*
+ * The arguments are stored in binary form in the log ring of the calling thread, the message
+ * is formatted and passed to the handler on the logger thread.
+ */
 #define LOG(L, M)                                                       \
     do {                                                                \
         if (logger_IsDebugModeEnabled())                                \
-            logger_LogLine(__FILE__, __LINE__, LOG_FUNCTION,            \
-                           (L), (std::stringstream() << M).str());      \
+            Logger::RecordWriter(__FILE__, __LINE__, LOG_FUNCTION, (L)) << M; \
     } while (false)
 
-#define LOG_INFO(...)  LOG('I', __VA_ARGS__)
-#define LOG_ERROR(...) LOG('E', __VA_ARGS__)
+#if TRACK_HAT_LOG_LEVEL >= 2
+#   define LOG_INFO(...)  LOG('I', __VA_ARGS__)
+#else
+#   define LOG_INFO(...)  do {} while (false)
+#endif
+
+#if TRACK_HAT_LOG_LEVEL >= 1
+#   define LOG_ERROR(...) LOG('E', __VA_ARGS__)
+#else
+#   define LOG_ERROR(...) do {} while (false)
+#endif
 
-/* Enable or disable debug messages on stdout */
+/* Enable or disable debug messages, the logger thread runs while they are enabled */
 void logger_SetEnable(bool enable);
 
+extern std::atomic<bool> logger_isDebugModeEnabled;
+
 /* Check if debug mode is enabled */
-bool logger_IsDebugModeEnabled();
+inline bool logger_IsDebugModeEnabled()
+{
+    return logger_isDebugModeEnabled.load(std::memory_order_relaxed);
+}
 
 void logger_SetHandler(log_handler_t fn);
-void logger_LogLine(const char*, int, const char*, char, const std::string&);
+
+namespace Logger
+{
+
+    class ThreadRing;
+
+    /* Size of the binary arguments of a single message, longer messages are truncated */
+    const size_t RecordArgumentsSize = 200;
+
+    /* Message waiting in the log ring */
+    struct Record
+    {
+        const char* m_file;
+        const char* m_function;
+        uint64_t    m_sequence;         // order of the messages of all threads
+        int         m_line;
+        char        m_level;
+        bool        m_isTruncated;
+        uint16_t    m_size;             // used bytes of 'm_arguments'
+        uint8_t     m_arguments[RecordArgumentsSize];
+    };
+
+    /* Integer written as hexadecimal '0x..' number */
+    struct Hex
+    {
+        explicit Hex(uint64_t value) : m_value(value) {}
+        uint64_t m_value;
+    };
+
+    /**
+     * Message created by the 'LOG' macro directly in the log ring of the thread.
+     *
+     * Numbers are copied in binary form and strings are copied as they are, other types are
+     * formatted with 'std::ostream' at once. The message is passed to the logger thread when
+     * the writer is destroyed. It is dropped if the ring is full.
+     */
+    class RecordWriter
+    {
+    public:
+        RecordWriter(const char* file, int line, const char* function, char level);
+        ~RecordWriter();
+
+        RecordWriter(const RecordWriter&) = delete;
+        RecordWriter& operator=(const RecordWriter&) = delete;
+
+        RecordWriter& operator<<(const char* text);
+        RecordWriter& operator<<(const std::string& text);
+        RecordWriter& operator<<(char value);
+        RecordWriter& operator<<(signed char value) { return *this << static_cast<char>(value); }
+        RecordWriter& operator<<(unsigned char value) { return *this << static_cast<char>(value); }
+        RecordWriter& operator<<(double value);
+        RecordWriter& operator<<(Hex value);
+
+        template<typename T>
+        typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, RecordWriter&>::type
+        operator<<(T value)
+        {
+            if (std::is_signed<T>::value || std::is_enum<T>::value)
+                appendSigned(static_cast<int64_t>(value));
+            else
+                appendUnsigned(static_cast<uint64_t>(value));
+            return *this;
+        }
+
+        template<typename T>
+        typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value &&
+                                !std::is_convertible<const T&, const char*>::value, RecordWriter&>::type
+        operator<<(const T& value)
+        {
+            std::ostringstream stream;
+            stream << value;
+            return *this << stream.str();
+        }
+
+    private:
+        void appendSigned(int64_t value);
+        void appendUnsigned(uint64_t value);
+        void appendText(const char* text, size_t size);
+        void append(uint8_t type, const void* data, size_t size);
+
+        ThreadRing* m_ring;     // log ring of the calling thread
+        Record*     m_record;   // nullptr if the message is dropped
+    };
+
+} // namespace Logger
 
 #endif //_LOGGER_H_
@@ -0,0 +1,98 @@
+// File:   track_hat_capture.cpp
+// Brief:  Capture file of the data received from the TrackHat camera
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_capture.h"
+
+#include "logger.h"
+#include "track_hat_driver.h"
+
+#include <cerrno>
+#include <cstring>
+
+namespace Capture
+{
+
+    Recorder::~Recorder()
+    {
+        stop();
+    }
+
+    TH_ErrorCode Recorder::start(const char* fileName, uint32_t serialNumber)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_file != nullptr)
+        {
+            LOG_ERROR("Recording is already running.");
+            return TH_ERROR_WRONG_PARAMETER;
+        }
+
+        m_file = std::fopen(fileName, "wb");
+        if (m_file == nullptr)
+        {
+            LOG_ERROR("Cannot create capture file " << fileName << ". Error " << std::strerror(errno) << ".");
+            return TH_ERROR_WRONG_PARAMETER;
+        }
+
+        FileHeader header = {};
+        std::memcpy(header.m_magic, FileMagic, sizeof(header.m_magic));
+        header.m_version = FileVersion;
+        header.m_headerSize = sizeof(FileHeader);
+        header.m_serialNumber = serialNumber;
+        header.m_startTimestampUs = trackHat_GetTimestampUs();
+
+        if (std::fwrite(&header, sizeof(header), 1, m_file) != 1)
+        {
+            LOG_ERROR("Cannot write capture file " << fileName << ".");
+            std::fclose(m_file);
+            m_file = nullptr;
+            return TH_ERROR_WRONG_PARAMETER;
+        }
+
+        m_isRecording = true;
+        return TH_SUCCESS;
+    }
+
+    void Recorder::stop()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_isRecording = false;
+        if (m_file != nullptr)
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+    void Recorder::write(uint64_t timestampUs, const uint8_t* data, size_t size)
+    {
+        if (!m_isRecording.load(std::memory_order_relaxed))
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file == nullptr)
+            return;
+
+        static const uint8_t padding[ChunkAlignment] = {};
+        const size_t paddingSize = alignedChunkSize(size) - size;
+
+        ChunkHeader header = {};
+        header.m_timestampUs = timestampUs;
+        header.m_size = static_cast<uint32_t>(size);
+
+        // The data is buffered by the stream, the receiver is not blocked by the disk
+        if ((std::fwrite(&header, sizeof(header), 1, m_file) != 1) ||
+            (std::fwrite(data, 1, size, m_file) != size) ||
+            (std::fwrite(padding, 1, paddingSize, m_file) != paddingSize))
+        {
+            LOG_ERROR("Cannot write capture file. Recording stopped.");
+            m_isRecording = false;
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+} // namespace Capture
@@ -0,0 +1,101 @@
+// File:   track_hat_capture.h
+// Brief:  Capture file of the data received from the TrackHat camera
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _TRACK_HAT_CAPTURE_H_
+#define _TRACK_HAT_CAPTURE_H_
+
+#include "track_hat_types.h"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+namespace Capture
+{
+
+    /*
+     * Capture file layout:
+     *
+     *   FileHeader
+     *   ChunkHeader, data of 'm_size' bytes, padding to 'ChunkAlignment'
+     *   ChunkHeader, ...
+     *
+     * Every chunk is the data of a single 'UsbSerial::read()'. The headers are stored in
+     * the host byte order (little endian on all supported platforms) and aligned, so the
+     * file can be memory mapped and used in place. A file cut by a crash is valid up to
+     * the last complete chunk.
+     */
+
+    /* "THCAPTUR" */
+    static const char FileMagic[8] = { 'T', 'H', 'C', 'A', 'P', 'T', 'U', 'R' };
+    static const uint32_t FileVersion = 1;
+    static const size_t ChunkAlignment = 8;
+
+    struct FileHeader
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_headerSize;        // Offset of the first chunk
+        uint32_t m_serialNumber;      // Serial number of the recorded device, if known
+        uint32_t m_reserved;
+        uint64_t m_startTimestampUs;  // 'trackHat_GetTimestampUs()' when the recording started
+    };
+
+    struct ChunkHeader
+    {
+        uint64_t m_timestampUs;       // 'trackHat_GetTimestampUs()' when the data was read
+        uint32_t m_size;              // Size of the data following the header
+        uint32_t m_reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "Capture file header must not depend on the compiler");
+    static_assert(sizeof(ChunkHeader) == 16, "Capture chunk header must not depend on the compiler");
+
+    /* Size of the chunk data with the padding */
+    inline size_t alignedChunkSize(size_t size)
+    {
+        return (size + ChunkAlignment - 1) & ~(ChunkAlignment - 1);
+    }
+
+
+    /**
+     * Writer of the capture file used by the receiving thread.
+     *
+     * 'write()' costs a single atomic load when the recording is not running.
+     */
+    class Recorder
+    {
+    public:
+        Recorder() = default;
+        ~Recorder();
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        /**
+         * Create the capture file and start recording.
+         *
+         * \param[in]  fileName       Name of the capture file, an existing file is replaced.
+         * \param[in]  serialNumber   Serial number of the device stored in the file header.
+         *
+         * \return     TH_SUCCESS or error code.
+         */
+        TH_ErrorCode start(const char* fileName, uint32_t serialNumber);
+
+        /* Finish recording and close the file */
+        void stop();
+
+        /* Append the received data to the capture file */
+        void write(uint64_t timestampUs, const uint8_t* data, size_t size);
+
+    private:
+        std::mutex        m_mutex;
+        std::FILE*        m_file = nullptr;
+        std::atomic<bool> m_isRecording{false};
+    };
+
+} // namespace Capture
+
+#endif //_TRACK_HAT_CAPTURE_H_
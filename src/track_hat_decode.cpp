@@ -0,0 +1,650 @@
+// File:   track_hat_decode.cpp
+// Brief:  Decoding of the points of the coordinates frames
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_decode.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define TRACK_HAT_DECODE_X86 1
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #endif
+#else
+  #define TRACK_HAT_DECODE_X86 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+  #define TRACK_HAT_DECODE_NEON 1
+  #include <arm_neon.h>
+#else
+  #define TRACK_HAT_DECODE_NEON 0
+#endif
+
+#if TRACK_HAT_DECODE_X86 && (defined(__GNUC__) || defined(__clang__))
+  #define TRACK_HAT_DECODE_SSSE3_TARGET __attribute__((target("ssse3")))
+  #define TRACK_HAT_DECODE_AVX2_TARGET __attribute__((target("avx2")))
+#else
+  #define TRACK_HAT_DECODE_SSSE3_TARGET
+  #define TRACK_HAT_DECODE_AVX2_TARGET
+#endif
+
+namespace Decode
+{
+
+    /* Points decoded by the vector decoders of the basic frames at once */
+    const size_t PointGroupSize = 8;
+
+    /* Offsets of the three 16-byte loads covering the 40 bytes of a point group */
+    constexpr size_t PointLoadOffsets[3] = { 0, 16, 24 };
+
+    /* Shuffle masks gathering X, Y and brightness of a point group from each load, 0x80 clears the byte */
+    struct PointShuffleMasks
+    {
+        uint8_t m_mask[3][3][16];   // [field][load][output byte]
+    };
+
+    /* Generate the masks at compile time */
+    constexpr PointShuffleMasks makePointShuffleMasks()
+    {
+        PointShuffleMasks masks = {};
+        const size_t fieldOffsets[3] = { 0, 2, 4 };
+        const size_t fieldSizes[3] = { 2, 2, 1 };
+
+        for (size_t field = 0; field < 3; field++)
+        {
+            for (size_t load = 0; load < 3; load++)
+            {
+                for (size_t byte = 0; byte < 16; byte++)
+                {
+                    const size_t size = fieldSizes[field];
+                    const size_t point = byte / size;
+
+                    // Big-endian values are stored little-endian, the low byte is the second one
+                    const size_t source = PointSize * point + fieldOffsets[field] + ((size == 2) ? (1 - byte % 2) : 0);
+                    const size_t loadOffset = PointLoadOffsets[load];
+                    const bool isInLoad = (point < PointGroupSize) && (source >= loadOffset) && (source < loadOffset + 16);
+
+                    masks.m_mask[field][load][byte] = isInLoad ? static_cast<uint8_t>(source - loadOffset) : 0x80;
+                }
+            }
+        }
+
+        return masks;
+    }
+
+    static constexpr PointShuffleMasks POINT_SHUFFLE_MASKS = makePointShuffleMasks();
+
+    /* Indexes of the same bytes in the 48-byte table of the three loads, 0xff gives zero (NEON) */
+    struct PointTableIndexes
+    {
+        uint8_t m_index[3][16];   // [field][output byte]
+    };
+
+    constexpr PointTableIndexes makePointTableIndexes()
+    {
+        PointTableIndexes indexes = {};
+
+        for (size_t field = 0; field < 3; field++)
+        {
+            for (size_t byte = 0; byte < 16; byte++)
+            {
+                uint8_t index = 0xff;
+                for (size_t load = 0; load < 3; load++)
+                {
+                    const uint8_t mask = POINT_SHUFFLE_MASKS.m_mask[field][load][byte];
+                    if (mask != 0x80)
+                        index = static_cast<uint8_t>(mask + 16 * load);
+                }
+                indexes.m_index[field][byte] = index;
+            }
+        }
+
+        return indexes;
+    }
+
+    static constexpr PointTableIndexes POINT_TABLE_INDEXES = makePointTableIndexes();
+
+    // The public raw point must keep the wire layout for the code which copies the payload into it
+    static_assert(sizeof(trackHat_ExtendedPointRaw_t) == ExtendedPointSize, "Wrong size of the raw extended point");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_areaLow) == ExtendedPointView::AreaOffset, "Wrong offset of the area");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_coordinateXLow) == ExtendedPointView::CoordinateXOffset, "Wrong offset of the X coordinate");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_coordinateYLow) == ExtendedPointView::CoordinateYOffset, "Wrong offset of the Y coordinate");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_averageBrightness) == ExtendedPointView::AverageBrightnessOffset, "Wrong offset of the average brightness");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_maximumBrightness) == ExtendedPointView::MaximumBrightnessOffset, "Wrong offset of the maximum brightness");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_boundryLeft) == ExtendedPointView::BoundryLeftOffset, "Wrong offset of the left boundry");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_boundryRigth) == ExtendedPointView::BoundryRigthOffset, "Wrong offset of the right boundry");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_boundryUp) == ExtendedPointView::BoundryUpOffset, "Wrong offset of the upper boundry");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_boundryDown) == ExtendedPointView::BoundryDownOffset, "Wrong offset of the lower boundry");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_aspectRatio) == ExtendedPointView::AspectRatioOffset, "Wrong offset of the aspect ratio");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_vx) == ExtendedPointView::VxOffset, "Wrong offset of the X velocity");
+    static_assert(offsetof(trackHat_ExtendedPointRaw_t, m_vy) == ExtendedPointView::VyOffset, "Wrong offset of the Y velocity");
+    static_assert(ExtendedPointView::VyOffset + 1 == ExtendedPointSize, "Wrong size of the extended point");
+
+    // The accessors of 'trackHat_ExtendedPointsRaw_t' decode the fields as the view does
+    static_assert(sizeof(trackHat_ExtendedPointsRaw_t::m_point) == ExtendedPointsPayloadSize, "Wrong size of the raw extended points");
+    static_assert(TRACK_HAT_RAW_RANGE_RADIUS_OFFSET == ExtendedPointView::RangeRadiusOffset, "Wrong offset of the range and the radius");
+    static_assert(TRACK_HAT_EXTENDED_COORDINATE_MASK == ExtendedCoordinateMask, "Wrong mask of the extended coordinates");
+
+
+    bool ExtendedPointView::isDetected() const
+    {
+        // The whole point as two words, the same on every byte order
+        uint64_t words[2];
+        memcpy(words, m_point, sizeof(words));
+        return (words[0] | words[1]) != 0;
+    }
+
+    void ExtendedPointView::decode(trackHat_ExtendedPoint_t& point) const
+    {
+        point.m_area = area();
+        point.m_coordinateX = coordinateX();
+        point.m_coordinateY = coordinateY();
+        point.m_averageBrightness = averageBrightness();
+        point.m_maximumBrightness = maximumBrightness();
+        point.m_range = range();
+        point.m_radius = radius();
+        point.m_boundryLeft = boundryLeft();
+        point.m_boundryRigth = boundryRigth();
+        point.m_boundryUp = boundryUp();
+        point.m_boundryDown = boundryDown();
+        point.m_aspectRatio = aspectRatio();
+        point.m_vx = vx();
+        point.m_vy = vy();
+    }
+
+
+    void decodePoints(const uint8_t* payload, trackHat_Point_t* points)
+    {
+        uint16_t value = 0;
+        size_t byte = 0;
+
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            value = static_cast<uint16_t>(payload[byte++] << 8);
+            value = value | payload[byte++];
+            points[i].m_x = value;
+
+            value = static_cast<uint16_t>(payload[byte++] << 8);
+            value = value | payload[byte++];
+            points[i].m_y = value;
+
+            points[i].m_brightness = payload[byte++];
+        }
+    }
+
+
+    bool isSsse3Supported()
+    {
+#if TRACK_HAT_DECODE_X86 && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#elif TRACK_HAT_DECODE_X86
+        return __builtin_cpu_supports("ssse3");
+#else
+        return false;
+#endif
+    }
+
+    bool isAvx2Supported()
+    {
+#if TRACK_HAT_DECODE_X86 && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || ((_xgetbv(0) & 0x6) != 0x6))
+            return false;   // the system does not save the AVX registers
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#elif TRACK_HAT_DECODE_X86
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+
+    void decodePointsSoAScalar(const uint8_t* payload, trackHat_PointsSoA_t& points)
+    {
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            const uint8_t* point = payload + i * PointSize;
+            points.m_x[i] = static_cast<uint16_t>((point[0] << 8) | point[1]);
+            points.m_y[i] = static_cast<uint16_t>((point[2] << 8) | point[3]);
+            points.m_brightness[i] = point[4];
+        }
+    }
+
+    TRACK_HAT_DECODE_SSSE3_TARGET
+    void decodePointsSoASsse3(const uint8_t* payload, trackHat_PointsSoA_t& points)
+    {
+#if TRACK_HAT_DECODE_X86
+        for (size_t group = 0; group < TRACK_HAT_NUMBER_OF_POINTS / PointGroupSize; group++)
+        {
+            const uint8_t* input = payload + group * PointGroupSize * PointSize;
+
+            __m128i loads[3];
+            for (size_t load = 0; load < 3; load++)
+                loads[load] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + PointLoadOffsets[load]));
+
+            // Bytes found in two loads are the same, the loads without the byte give zero
+            __m128i fields[3];
+            for (size_t field = 0; field < 3; field++)
+            {
+                fields[field] = _mm_setzero_si128();
+                for (size_t load = 0; load < 3; load++)
+                {
+                    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(POINT_SHUFFLE_MASKS.m_mask[field][load]));
+                    fields[field] = _mm_or_si128(fields[field], _mm_shuffle_epi8(loads[load], mask));
+                }
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_x + group * PointGroupSize), fields[0]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_y + group * PointGroupSize), fields[1]);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(points.m_brightness + group * PointGroupSize), fields[2]);
+        }
+#else
+        decodePointsSoAScalar(payload, points);
+#endif
+    }
+
+    TRACK_HAT_DECODE_AVX2_TARGET
+    void decodePointsSoAAvx2(const uint8_t* payload, trackHat_PointsSoA_t& points)
+    {
+#if TRACK_HAT_DECODE_X86
+        // Both groups at once, the first one in the lower lane and the second in the upper lane
+        const uint8_t* secondGroup = payload + PointGroupSize * PointSize;
+
+        __m256i loads[3];
+        for (size_t load = 0; load < 3; load++)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(payload + PointLoadOffsets[load]));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secondGroup + PointLoadOffsets[load]));
+            loads[load] = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        }
+
+        __m256i fields[3];
+        for (size_t field = 0; field < 3; field++)
+        {
+            fields[field] = _mm256_setzero_si256();
+            for (size_t load = 0; load < 3; load++)
+            {
+                const __m256i mask = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(POINT_SHUFFLE_MASKS.m_mask[field][load])));
+                fields[field] = _mm256_or_si256(fields[field], _mm256_shuffle_epi8(loads[load], mask));
+            }
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(points.m_x), fields[0]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(points.m_y), fields[1]);
+
+        // Brightness is in the lowest 8 bytes of each lane
+        const __m256i brightness = _mm256_permute4x64_epi64(fields[2], 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_brightness), _mm256_castsi256_si128(brightness));
+#else
+        decodePointsSoAScalar(payload, points);
+#endif
+    }
+
+    void decodePointsSoANeon(const uint8_t* payload, trackHat_PointsSoA_t& points)
+    {
+#if TRACK_HAT_DECODE_NEON
+        for (size_t group = 0; group < TRACK_HAT_NUMBER_OF_POINTS / PointGroupSize; group++)
+        {
+            const uint8_t* input = payload + group * PointGroupSize * PointSize;
+
+            // The loads form a 48-byte table, the bytes of the third load have indexes 32 to 47
+            uint8x16x3_t table;
+            for (size_t load = 0; load < 3; load++)
+                table.val[load] = vld1q_u8(input + PointLoadOffsets[load]);
+
+            uint8x16_t fields[3];
+            for (size_t field = 0; field < 3; field++)
+                fields[field] = vqtbl3q_u8(table, vld1q_u8(POINT_TABLE_INDEXES.m_index[field]));
+
+            vst1q_u8(reinterpret_cast<uint8_t*>(points.m_x + group * PointGroupSize), fields[0]);
+            vst1q_u8(reinterpret_cast<uint8_t*>(points.m_y + group * PointGroupSize), fields[1]);
+            vst1_u8(points.m_brightness + group * PointGroupSize, vget_low_u8(fields[2]));
+        }
+#else
+        decodePointsSoAScalar(payload, points);
+#endif
+    }
+
+
+    void decodeExtendedPointsSoAScalar(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points)
+    {
+        const ExtendedPointsView view(payload);
+
+        for (size_t i = 0; i < view.size(); i++)
+        {
+            const ExtendedPointView point = view[i];
+            points.m_area[i] = point.area();
+            points.m_coordinateX[i] = point.coordinateX();
+            points.m_coordinateY[i] = point.coordinateY();
+            points.m_averageBrightness[i] = point.averageBrightness();
+            points.m_maximumBrightness[i] = point.maximumBrightness();
+            points.m_range[i] = point.range();
+            points.m_radius[i] = point.radius();
+            points.m_boundryLeft[i] = point.boundryLeft();
+            points.m_boundryRigth[i] = point.boundryRigth();
+            points.m_boundryUp[i] = point.boundryUp();
+            points.m_boundryDown[i] = point.boundryDown();
+            points.m_aspectRatio[i] = point.aspectRatio();
+            points.m_vx[i] = point.vx();
+            points.m_vy[i] = point.vy();
+        }
+    }
+
+#if TRACK_HAT_DECODE_X86
+    /* Store the transposed payload, 'columns[k]' is byte 'k' of all points */
+    TRACK_HAT_DECODE_SSSE3_TARGET
+    static inline void storeExtendedColumns(const __m128i* columns, trackHat_ExtendedPointsSoA_t& points)
+    {
+        const __m128i coordinateMask = _mm_set1_epi16(static_cast<short>(ExtendedCoordinateMask));
+        const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+
+        __m128i* area = reinterpret_cast<__m128i*>(points.m_area);
+        _mm_storeu_si128(area, _mm_unpacklo_epi8(columns[0], columns[1]));
+        _mm_storeu_si128(area + 1, _mm_unpackhi_epi8(columns[0], columns[1]));
+
+        __m128i* coordinateX = reinterpret_cast<__m128i*>(points.m_coordinateX);
+        _mm_storeu_si128(coordinateX, _mm_and_si128(_mm_unpacklo_epi8(columns[2], columns[3]), coordinateMask));
+        _mm_storeu_si128(coordinateX + 1, _mm_and_si128(_mm_unpackhi_epi8(columns[2], columns[3]), coordinateMask));
+
+        __m128i* coordinateY = reinterpret_cast<__m128i*>(points.m_coordinateY);
+        _mm_storeu_si128(coordinateY, _mm_and_si128(_mm_unpacklo_epi8(columns[4], columns[5]), coordinateMask));
+        _mm_storeu_si128(coordinateY + 1, _mm_and_si128(_mm_unpackhi_epi8(columns[4], columns[5]), coordinateMask));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_averageBrightness), columns[6]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_maximumBrightness), columns[7]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_range), _mm_and_si128(columns[8], nibbleMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_radius), _mm_and_si128(_mm_srli_epi16(columns[8], 4), nibbleMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_boundryLeft), columns[9]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_boundryRigth), columns[10]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_boundryUp), columns[11]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_boundryDown), columns[12]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_aspectRatio), columns[13]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_vx), columns[14]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(points.m_vy), columns[15]);
+    }
+#endif
+
+    /* Register 'i' holds byte 'BitReversed[i]' of all points after the 16x16 transposition */
+    static const size_t BitReversed[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+    TRACK_HAT_DECODE_SSSE3_TARGET
+    void decodeExtendedPointsSoASsse3(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points)
+    {
+#if TRACK_HAT_DECODE_X86
+        __m128i rows[16];
+        for (size_t i = 0; i < 16; i++)
+            rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(payload + i * ExtendedPointSize));
+
+        // Interleave the pairs of registers with 8, 16, 32 and 64-bit elements
+        __m128i next[16];
+        for (size_t i = 0; i < 8; i++)
+        {
+            next[i] = _mm_unpacklo_epi8(rows[2 * i], rows[2 * i + 1]);
+            next[i + 8] = _mm_unpackhi_epi8(rows[2 * i], rows[2 * i + 1]);
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            rows[i] = _mm_unpacklo_epi16(next[2 * i], next[2 * i + 1]);
+            rows[i + 8] = _mm_unpackhi_epi16(next[2 * i], next[2 * i + 1]);
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            next[i] = _mm_unpacklo_epi32(rows[2 * i], rows[2 * i + 1]);
+            next[i + 8] = _mm_unpackhi_epi32(rows[2 * i], rows[2 * i + 1]);
+        }
+
+        __m128i columns[16];
+        for (size_t i = 0; i < 8; i++)
+        {
+            columns[BitReversed[i]] = _mm_unpacklo_epi64(next[2 * i], next[2 * i + 1]);
+            columns[BitReversed[i + 8]] = _mm_unpackhi_epi64(next[2 * i], next[2 * i + 1]);
+        }
+
+        storeExtendedColumns(columns, points);
+#else
+        decodeExtendedPointsSoAScalar(payload, points);
+#endif
+    }
+
+    TRACK_HAT_DECODE_AVX2_TARGET
+    void decodeExtendedPointsSoAAvx2(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points)
+    {
+#if TRACK_HAT_DECODE_X86
+        // Points 'i' and 'i + 8' in the lanes of register 'i', transposed as two 8x16 blocks
+        __m256i rows[8];
+        for (size_t i = 0; i < 8; i++)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(payload + i * ExtendedPointSize));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(payload + (i + 8) * ExtendedPointSize));
+            rows[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        }
+
+        __m256i next[8];
+        for (size_t i = 0; i < 4; i++)
+        {
+            next[i] = _mm256_unpacklo_epi8(rows[2 * i], rows[2 * i + 1]);
+            next[i + 4] = _mm256_unpackhi_epi8(rows[2 * i], rows[2 * i + 1]);
+        }
+        for (size_t i = 0; i < 4; i++)
+        {
+            rows[i] = _mm256_unpacklo_epi16(next[2 * i], next[2 * i + 1]);
+            rows[i + 4] = _mm256_unpackhi_epi16(next[2 * i], next[2 * i + 1]);
+        }
+        for (size_t i = 0; i < 4; i++)
+        {
+            next[i] = _mm256_unpacklo_epi32(rows[2 * i], rows[2 * i + 1]);
+            next[i + 4] = _mm256_unpackhi_epi32(rows[2 * i], rows[2 * i + 1]);
+        }
+
+        // Each lane has two bytes of 8 points, joining the halves of the lanes gives
+        // bytes '2 * BitReversed[2 * i]' and '2 * BitReversed[2 * i] + 1' of all points
+        __m128i columns[16];
+        for (size_t i = 0; i < 8; i++)
+        {
+            const __m256i joined = _mm256_permute4x64_epi64(next[i], 0xd8);
+            const size_t column = 2 * BitReversed[2 * i];
+            columns[column] = _mm256_castsi256_si128(joined);
+            columns[column + 1] = _mm256_extracti128_si256(joined, 1);
+        }
+
+        storeExtendedColumns(columns, points);
+#else
+        decodeExtendedPointsSoAScalar(payload, points);
+#endif
+    }
+
+    void decodeExtendedPointsSoANeon(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points)
+    {
+#if TRACK_HAT_DECODE_NEON
+        // The same transposition as 'decodeExtendedPointsSoASsse3()', 'vzip' interleaves as 'unpack'
+        uint8x16_t rows[16];
+        for (size_t i = 0; i < 16; i++)
+            rows[i] = vld1q_u8(payload + i * ExtendedPointSize);
+
+        uint8x16_t next[16];
+        for (size_t i = 0; i < 8; i++)
+        {
+            next[i] = vzip1q_u8(rows[2 * i], rows[2 * i + 1]);
+            next[i + 8] = vzip2q_u8(rows[2 * i], rows[2 * i + 1]);
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            const uint16x8_t first = vreinterpretq_u16_u8(next[2 * i]);
+            const uint16x8_t second = vreinterpretq_u16_u8(next[2 * i + 1]);
+            rows[i] = vreinterpretq_u8_u16(vzip1q_u16(first, second));
+            rows[i + 8] = vreinterpretq_u8_u16(vzip2q_u16(first, second));
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            const uint32x4_t first = vreinterpretq_u32_u8(rows[2 * i]);
+            const uint32x4_t second = vreinterpretq_u32_u8(rows[2 * i + 1]);
+            next[i] = vreinterpretq_u8_u32(vzip1q_u32(first, second));
+            next[i + 8] = vreinterpretq_u8_u32(vzip2q_u32(first, second));
+        }
+
+        uint8x16_t columns[16];
+        for (size_t i = 0; i < 8; i++)
+        {
+            const uint64x2_t first = vreinterpretq_u64_u8(next[2 * i]);
+            const uint64x2_t second = vreinterpretq_u64_u8(next[2 * i + 1]);
+            columns[BitReversed[i]] = vreinterpretq_u8_u64(vzip1q_u64(first, second));
+            columns[BitReversed[i + 8]] = vreinterpretq_u8_u64(vzip2q_u64(first, second));
+        }
+
+        const uint16x8_t coordinateMask = vdupq_n_u16(ExtendedCoordinateMask);
+        const uint8x16_t nibbleMask = vdupq_n_u8(0x0f);
+
+        // Little-endian 16-bit values from the low and high bytes
+        vst1q_u16(points.m_area, vreinterpretq_u16_u8(vzip1q_u8(columns[0], columns[1])));
+        vst1q_u16(points.m_area + 8, vreinterpretq_u16_u8(vzip2q_u8(columns[0], columns[1])));
+        vst1q_u16(points.m_coordinateX, vandq_u16(vreinterpretq_u16_u8(vzip1q_u8(columns[2], columns[3])), coordinateMask));
+        vst1q_u16(points.m_coordinateX + 8, vandq_u16(vreinterpretq_u16_u8(vzip2q_u8(columns[2], columns[3])), coordinateMask));
+        vst1q_u16(points.m_coordinateY, vandq_u16(vreinterpretq_u16_u8(vzip1q_u8(columns[4], columns[5])), coordinateMask));
+        vst1q_u16(points.m_coordinateY + 8, vandq_u16(vreinterpretq_u16_u8(vzip2q_u8(columns[4], columns[5])), coordinateMask));
+
+        vst1q_u8(points.m_averageBrightness, columns[6]);
+        vst1q_u8(points.m_maximumBrightness, columns[7]);
+        vst1q_u8(points.m_range, vandq_u8(columns[8], nibbleMask));
+        vst1q_u8(points.m_radius, vshrq_n_u8(columns[8], 4));
+        vst1q_u8(points.m_boundryLeft, columns[9]);
+        vst1q_u8(points.m_boundryRigth, columns[10]);
+        vst1q_u8(points.m_boundryUp, columns[11]);
+        vst1q_u8(points.m_boundryDown, columns[12]);
+        vst1q_u8(points.m_aspectRatio, columns[13]);
+        vst1q_u8(points.m_vx, columns[14]);
+        vst1q_u8(points.m_vy, columns[15]);
+#else
+        decodeExtendedPointsSoAScalar(payload, points);
+#endif
+    }
+
+
+    void decodeCompactPoints(const uint8_t* payload, trackHat_CompactPoints_t& points)
+    {
+        uint32_t count = 0;
+
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            const uint8_t* point = payload + i * PointSize;
+            trackHat_CompactPoint_t& output = points.m_point[count];
+
+            output.m_point.m_x = static_cast<uint16_t>((point[0] << 8) | point[1]);
+            output.m_point.m_y = static_cast<uint16_t>((point[2] << 8) | point[3]);
+            output.m_point.m_brightness = point[4];
+            output.m_index = static_cast<uint8_t>(i);
+
+            const bool isDetected = (point[0] | point[1] | point[2] | point[3] | point[4]) != 0;
+            count += isDetected ? 1 : 0;
+        }
+
+        points.m_count = count;
+    }
+
+    void decodeCompactExtendedPoints(const uint8_t* payload, trackHat_CompactExtendedPoints_t& points)
+    {
+        const ExtendedPointsView view(payload);
+        uint32_t count = 0;
+
+        for (size_t i = 0; i < view.size(); i++)
+        {
+            const ExtendedPointView point = view[i];
+            trackHat_CompactExtendedPoint_t& output = points.m_point[count];
+
+            point.decode(output.m_point);
+            output.m_index = static_cast<uint8_t>(i);
+            count += point.isDetected() ? 1 : 0;
+        }
+
+        points.m_count = count;
+    }
+
+
+    void decodeExtendedPoints(const uint8_t* payload, trackHat_ExtendedPoints_t& points)
+    {
+        const ExtendedPointsView view(payload);
+
+        // The empty slots are zero, as their raw bytes
+        for (size_t i = 0; i < view.size(); i++)
+        {
+            if (view[i].isDetected())
+                view[i].decode(points.m_point[i]);
+            else
+                points.m_point[i] = trackHat_ExtendedPoint_t();
+        }
+    }
+
+    void copyExtendedPointsRaw(const uint8_t* payload, trackHat_ExtendedPointsRaw_t& points)
+    {
+        memcpy(points.m_point, payload, sizeof(points.m_point));
+    }
+
+
+    typedef void (*decodePointsFunction_t)(const uint8_t*, trackHat_PointsSoA_t&);
+    typedef void (*decodeExtendedPointsFunction_t)(const uint8_t*, trackHat_ExtendedPointsSoA_t&);
+
+    /* Implementations of the CPU */
+    enum class Implementation
+    {
+        SCALAR,
+        SSSE3,
+        AVX2,
+        NEON,
+    };
+
+    /* Implementation selected at the first use, also when it comes from a static initializer */
+    static Implementation selectedImplementation()
+    {
+        static const Implementation implementation =
+            TRACK_HAT_DECODE_NEON ? Implementation::NEON :
+            isAvx2Supported()     ? Implementation::AVX2 :
+            isSsse3Supported()    ? Implementation::SSSE3 : Implementation::SCALAR;
+
+        return implementation;
+    }
+
+
+    const char* implementationName()
+    {
+        switch (selectedImplementation())
+        {
+            case Implementation::NEON:  return "neon";
+            case Implementation::AVX2:  return "avx2";
+            case Implementation::SSSE3: return "ssse3";
+            default:                    return "scalar";
+        }
+    }
+
+    void decodePointsSoA(const uint8_t* payload, trackHat_PointsSoA_t& points)
+    {
+        static const Implementation implementation = selectedImplementation();
+        static const decodePointsFunction_t decodePointsFunction =
+            (implementation == Implementation::NEON)  ? decodePointsSoANeon :
+            (implementation == Implementation::AVX2)  ? decodePointsSoAAvx2 :
+            (implementation == Implementation::SSSE3) ? decodePointsSoASsse3 : decodePointsSoAScalar;
+
+        decodePointsFunction(payload, points);
+    }
+
+    void decodeExtendedPointsSoA(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points)
+    {
+        static const Implementation implementation = selectedImplementation();
+        static const decodeExtendedPointsFunction_t decodeExtendedPointsFunction =
+            (implementation == Implementation::NEON)  ? decodeExtendedPointsSoANeon :
+            (implementation == Implementation::AVX2)  ? decodeExtendedPointsSoAAvx2 :
+            (implementation == Implementation::SSSE3) ? decodeExtendedPointsSoASsse3 : decodeExtendedPointsSoAScalar;
+
+        decodeExtendedPointsFunction(payload, points);
+    }
+
+} // namespace Decode
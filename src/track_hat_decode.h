@@ -0,0 +1,170 @@
+// File:   track_hat_decode.h
+// Brief:  Decoding of the points of the coordinates frames
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _TRACK_HAT_DECODE_H_
+#define _TRACK_HAT_DECODE_H_
+
+#include "track_hat_types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Decode
+{
+
+    /* Payload of the coordinates frame: 16 points of 5 bytes (big-endian X, Y and brightness) */
+    const size_t PointSize = 5;
+    const size_t PointsPayloadSize = TRACK_HAT_NUMBER_OF_POINTS * PointSize;
+
+    /* Payload of the extended coordinates frame: 16 points of 'trackHat_ExtendedPointRaw_t' */
+    const size_t ExtendedPointSize = 16;
+    const size_t ExtendedPointsPayloadSize = TRACK_HAT_NUMBER_OF_POINTS * ExtendedPointSize;
+
+    /* Coordinates of the extended points have 14 bits */
+    const uint16_t ExtendedCoordinateMask = 0x3fff;
+
+
+    /**
+     * Point of the extended coordinates frame read in place from the received payload.
+     *
+     * The offsets follow the wire layout and not the layout of 'trackHat_ExtendedPointRaw_t'
+     * chosen by the compiler (the order of the 'm_range' and 'm_radius' bitfields is not
+     * portable). The fields are decoded only when they are read, the view does not copy
+     * the point and is valid as long as the payload.
+     */
+    class ExtendedPointView
+    {
+    public:
+        /* Offsets of the fields in the point, the 16-bit values are little-endian */
+        enum Offset : size_t
+        {
+            AreaOffset              = 0,
+            CoordinateXOffset       = 2,
+            CoordinateYOffset       = 4,
+            AverageBrightnessOffset = 6,
+            MaximumBrightnessOffset = 7,
+            RangeRadiusOffset       = 8,    // range in the low nibble, radius in the high one
+            BoundryLeftOffset       = 9,
+            BoundryRigthOffset      = 10,
+            BoundryUpOffset         = 11,
+            BoundryDownOffset       = 12,
+            AspectRatioOffset       = 13,
+            VxOffset                = 14,
+            VyOffset                = 15,
+        };
+
+        explicit ExtendedPointView(const uint8_t* point) : m_point(point) {}
+
+        uint16_t area() const               { return readUint16(AreaOffset); }
+        uint16_t coordinateX() const        { return readUint16(CoordinateXOffset) & ExtendedCoordinateMask; }
+        uint16_t coordinateY() const        { return readUint16(CoordinateYOffset) & ExtendedCoordinateMask; }
+        uint8_t  averageBrightness() const  { return m_point[AverageBrightnessOffset]; }
+        uint8_t  maximumBrightness() const  { return m_point[MaximumBrightnessOffset]; }
+        uint8_t  range() const              { return m_point[RangeRadiusOffset] & 0x0f; }
+        uint8_t  radius() const             { return m_point[RangeRadiusOffset] >> 4; }
+        uint8_t  boundryLeft() const        { return m_point[BoundryLeftOffset]; }
+        uint8_t  boundryRigth() const       { return m_point[BoundryRigthOffset]; }
+        uint8_t  boundryUp() const          { return m_point[BoundryUpOffset]; }
+        uint8_t  boundryDown() const        { return m_point[BoundryDownOffset]; }
+        uint8_t  aspectRatio() const        { return m_point[AspectRatioOffset]; }
+        uint8_t  vx() const                 { return m_point[VxOffset]; }
+        uint8_t  vy() const                 { return m_point[VyOffset]; }
+
+        /* Check if the point is detected, the empty slots have all bytes zero */
+        bool isDetected() const;
+
+        /* Decode all fields of the point */
+        void decode(trackHat_ExtendedPoint_t& point) const;
+
+    private:
+        uint16_t readUint16(size_t offset) const
+        {
+            return static_cast<uint16_t>(m_point[offset] | (m_point[offset + 1] << 8));
+        }
+
+        const uint8_t* m_point;
+    };
+
+    /* The 16 points of the extended coordinates frame read in place from the received payload */
+    class ExtendedPointsView
+    {
+    public:
+        explicit ExtendedPointsView(const uint8_t* payload) : m_payload(payload) {}
+
+        size_t size() const { return TRACK_HAT_NUMBER_OF_POINTS; }
+
+        ExtendedPointView operator[](size_t index) const
+        {
+            return ExtendedPointView(m_payload + index * ExtendedPointSize);
+        }
+
+    private:
+        const uint8_t* m_payload;
+    };
+
+
+    /* Decode the payload into 'trackHat_Points_t::m_point' */
+    void decodePoints(const uint8_t* payload, trackHat_Point_t* points);
+
+    /* Decode the extended payload into 'trackHat_ExtendedPoints_t', without the timestamp and the frame number */
+    void decodeExtendedPoints(const uint8_t* payload, trackHat_ExtendedPoints_t& points);
+
+    /* Copy the extended payload to 'trackHat_ExtendedPointsRaw_t' without decoding, see 'decodeExtendedPoints()' */
+    void copyExtendedPointsRaw(const uint8_t* payload, trackHat_ExtendedPointsRaw_t& points);
+
+
+    /* Check if the CPU supports the SSSE3 and AVX2 decoders (NEON is always present on AArch64) */
+    bool isSsse3Supported();
+    bool isAvx2Supported();
+
+    /* Name of the decoder selected by 'decodePointsSoA()' and 'decodeExtendedPointsSoA()' */
+    const char* implementationName();
+
+
+    /**
+     * Decode the payload into the arrays of 'trackHat_PointsSoA_t', without the timestamp
+     * and the frame number.
+     *
+     * The scalar decoder is the reference implementation. The others shuffle the bytes of
+     * 8 or 16 points at once and must be called only if the CPU supports them, otherwise they
+     * use the scalar decoder.
+     */
+    void decodePointsSoAScalar(const uint8_t* payload, trackHat_PointsSoA_t& points);
+    void decodePointsSoASsse3(const uint8_t* payload, trackHat_PointsSoA_t& points);
+    void decodePointsSoAAvx2(const uint8_t* payload, trackHat_PointsSoA_t& points);
+    void decodePointsSoANeon(const uint8_t* payload, trackHat_PointsSoA_t& points);
+
+    /* Decode the payload with the fastest implementation supported by the CPU */
+    void decodePointsSoA(const uint8_t* payload, trackHat_PointsSoA_t& points);
+
+
+    /**
+     * Decode the extended payload into the arrays of 'trackHat_ExtendedPointsSoA_t', without
+     * the timestamp and the frame number.
+     *
+     * The vector decoders transpose the 16 points of 16 bytes, see 'decodePointsSoAScalar()'.
+     */
+    void decodeExtendedPointsSoAScalar(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points);
+    void decodeExtendedPointsSoASsse3(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points);
+    void decodeExtendedPointsSoAAvx2(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points);
+    void decodeExtendedPointsSoANeon(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points);
+
+    /* Decode the extended payload with the fastest implementation supported by the CPU */
+    void decodeExtendedPointsSoA(const uint8_t* payload, trackHat_ExtendedPointsSoA_t& points);
+
+
+    /**
+     * Decode only the detected points of the payload, the empty slots (all bytes zero) are
+     * skipped. The timestamp and the frame number are not set.
+     *
+     * Every slot is written at position 'm_count', which grows only for the detected points,
+     * so the decoding does not branch on the data.
+     */
+    void decodeCompactPoints(const uint8_t* payload, trackHat_CompactPoints_t& points);
+    void decodeCompactExtendedPoints(const uint8_t* payload, trackHat_CompactExtendedPoints_t& points);
+
+} // namespace Decode
+
+#endif //_TRACK_HAT_DECODE_H_
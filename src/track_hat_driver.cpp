@@ -8,14 +8,24 @@
 #include "track_hat_types.h"
 
 #include "logger.h"
+#include "track_hat_decode.h"
 #include "track_hat_parser.h"
+#include "track_hat_reactor.h"
 #include "usb_serial.h"
+#include "usb_serial_mock.h"
+#include "usb_serial_replay.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <deque>
+#include <new>
 #include <string>
+#include <system_error>
 #include <time.h>
 #include <vector>
 #include <chrono>
+#include <thread>
 
 
 const size_t CAMERA_ERROR_CHECK_INTERVAL = 2;
@@ -57,20 +67,24 @@ void trackHat_Deinitialize(trackHat_Device_t* device)
     if (device->m_pInternal != nullptr)
     {
         trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
-        if (pInternal->m_receiver.m_threadHandler != nullptr)
+        if (pInternal->m_receiver.m_threadHandler.joinable())
         {
             trackHat_Disconnect(device);
         }
+        for (trackHat_Subscription_t& subscription : pInternal->m_subscriptions)
+        {
+            if (subscription.m_thread.m_threadHandler.joinable())
+                trackHat_StopSubscription(subscription);
+        }
         delete pInternal;
     }
     ::memset(device, 0, sizeof(trackHat_Device_t));
 }
 
 
-TH_ErrorCode trackHat_DetectDevice(trackHat_Device_t* device)
+/* Detect the camera on the given port, or on the first found if 'portName' is nullptr */
+static TH_ErrorCode trackHat_DetectDeviceOn(trackHat_Device_t* device, const char* portName)
 {
-    LOG_INFO("Detecting TrackHat camera.");
-
     if ((device == nullptr) || (device->m_pInternal == nullptr))
     {
         LOG_ERROR("Bad use of the function.");
@@ -79,45 +93,125 @@ TH_ErrorCode trackHat_DetectDevice(trackHat_Device_t* device)
 
     trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
     usbSerial_t& serial = pInternal->m_serial;
-    serial.m_comNumber = UsbSerial::getComPort(TRACK_HAT_USB_VENDOR_ID, TRACK_HAT_USB_PRODUCT_ID);
 
-    if (serial.m_comNumber == 0)
+    if (serial.m_isPortOpen)
+    {
+        LOG_ERROR("Device cannot be detected while it is connected.");
+        return TH_ERROR_DEVICE_ALREADY_OPEN;
+    }
+
+    serial.m_transport.reset();
+
+    if (UsbSerial::detect(serial, TRACK_HAT_USB_VENDOR_ID, TRACK_HAT_USB_PRODUCT_ID, portName) != TH_SUCCESS)
     {
         LOG_INFO("Camera NOT detected.");
         return TH_ERROR_DEVICE_NOT_DETECTED;
     }
 
-    LOG_INFO("Camera detected on the COM" << serial.m_comNumber << " port.");
+    LOG_INFO("Camera detected on the " << serial.m_comFileName << " port.");
     return TH_SUCCESS;
 }
 
-TH_ErrorCode trackHat_WaitForResponse(const trackHat_Internal_t* pInternal, uint8_t transactionID)
+TH_ErrorCode trackHat_DetectDevice(trackHat_Device_t* device)
+{
+    LOG_INFO("Detecting TrackHat camera.");
+    return trackHat_DetectDeviceOn(device, nullptr);
+}
+
+TH_ErrorCode trackHat_EnumerateDevices(trackHat_DetectedDevice_t* devices, uint32_t maxCount, uint32_t* count)
 {
-    const trackHat_Messages_t* pMessages = &pInternal->m_messages;
-    std::chrono::high_resolution_clock clk;
-    const auto START = clk.now();
-    const auto TIMEOUT = std::chrono::milliseconds(100);
-    do
+    if ((count == nullptr) || ((devices == nullptr) && (maxCount > 0)))
     {
-        if (pMessages->m_nack.m_transactionID == transactionID)
-        {
-            return TH_FAILED_TO_SET_REGISTER;
-        }
-        else if (pMessages->m_lastACKTransactionId >= transactionID)
-        {
-            return TH_SUCCESS;
-        }
-        else
-        {
-            // do nothing
-        }
+        LOG_ERROR("Bad use of the function.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    const std::vector<usbSerialPort_t> ports = UsbSerial::enumerate(TRACK_HAT_USB_VENDOR_ID, TRACK_HAT_USB_PRODUCT_ID);
+
+    for (size_t i = 0; (i < ports.size()) && (i < maxCount); i++)
+    {
+        static_assert(sizeof(devices[i].m_portName) == sizeof(ports[i].m_comFileName), "Port name sizes must be the same");
+        static_assert(sizeof(devices[i].m_usbSerialNumber) == sizeof(ports[i].m_serialNumber), "Serial number sizes must be the same");
+        std::memcpy(devices[i].m_portName, ports[i].m_comFileName, sizeof(devices[i].m_portName));
+        std::memcpy(devices[i].m_usbSerialNumber, ports[i].m_serialNumber, sizeof(devices[i].m_usbSerialNumber));
+    }
 
-        ::Sleep(1);
-    } while (clk.now() - START <= TIMEOUT);
+    *count = static_cast<uint32_t>(ports.size());
+    LOG_INFO("Found " << ports.size() << " TrackHat camera(s).");
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_DetectDeviceOnPort(trackHat_Device_t* device, const char* portName)
+{
+    if (portName == nullptr)
+    {
+        LOG_ERROR("Bad use of the function.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    LOG_INFO("Detecting TrackHat camera on the " << portName << " port.");
+    return trackHat_DetectDeviceOn(device, portName);
+}
+
+TH_ErrorCode trackHat_DetectMockDevice(trackHat_Device_t* device, const trackHat_MockConfig_t* config)
+{
+    LOG_INFO("Using simulated TrackHat camera.");
+
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+    {
+        LOG_ERROR("Bad use of the function.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    usbSerial_t& serial = pInternal->m_serial;
+
+    if (serial.m_isPortOpen)
+    {
+        LOG_ERROR("Device cannot be detected while it is connected.");
+        return TH_ERROR_DEVICE_ALREADY_OPEN;
+    }
 
-    return TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
+    const trackHat_MockConfig_t mockConfig = (config != nullptr) ? *config : UsbSerial::MockTransport::defaultConfig();
+    serial.m_transport.reset(new UsbSerial::MockTransport(mockConfig));
+    ::snprintf(serial.m_comFileName, sizeof(serial.m_comFileName), "mock");
+    serial.m_isDetected = true;
+
+    return TH_SUCCESS;
 }
 
+TH_ErrorCode trackHat_DetectReplayDevice(trackHat_Device_t* device, const char* fileName, double speed)
+{
+    LOG_INFO("Using capture file as TrackHat camera.");
+
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (fileName == nullptr) || (speed < 0))
+    {
+        LOG_ERROR("Bad use of the function.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    usbSerial_t& serial = pInternal->m_serial;
+
+    if (serial.m_isPortOpen)
+    {
+        LOG_ERROR("Device cannot be detected while it is connected.");
+        return TH_ERROR_DEVICE_ALREADY_OPEN;
+    }
+
+    std::unique_ptr<UsbSerial::ReplayTransport> replay(new UsbSerial::ReplayTransport(speed));
+    TH_ErrorCode result = replay->load(fileName);
+    if (result != TH_SUCCESS)
+    {
+        return result;
+    }
+
+    serial.m_transport = std::move(replay);
+    ::snprintf(serial.m_comFileName, sizeof(serial.m_comFileName), "replay");
+    serial.m_isDetected = true;
+
+    return TH_SUCCESS;
+}
 
 TH_ErrorCode trackHat_Connect(trackHat_Device_t* device, TH_FrameType frameType)
 {
@@ -140,7 +234,7 @@ TH_ErrorCode trackHat_Connect(trackHat_Device_t* device, TH_FrameType frameType)
         return TH_ERROR_DEVICE_ALREADY_OPEN;
     }
 
-    if (serial.m_comNumber == 0)
+    if (!serial.m_isDetected)
     {
         LOG_ERROR(logFunctionBadUse);
         return TH_ERROR_DEVICE_NOT_DETECTED;
@@ -154,32 +248,62 @@ TH_ErrorCode trackHat_Connect(trackHat_Device_t* device, TH_FrameType frameType)
     }
 
     pInternal->m_isUnplugged = false;
-
-    // Start receiving thread
-    receiverThread.m_isRunning = true;
-    receiverThread.m_threadHandler =
-        ::CreateThread(0, 0, trackHat_ReceiverThreadFunction, pInternal, 0, &receiverThread.m_threadID);
-    if (receiverThread.m_threadHandler == nullptr)
+    pInternal->m_messages.m_coordinates.m_frameNumber = 0;
+    pInternal->m_messages.m_extendedCoordinates.m_frameNumber = 0;
+    pInternal->m_messages.m_coordinates.m_queue.clear();
+    pInternal->m_messages.m_extendedCoordinates.m_queue.clear();
+    pInternal->m_registerShadow.invalidate();   // the camera could be reset while disconnected
+    trackHat_SetupInlineCallbacks(pInternal);
+
+    if (pInternal->m_useSharedReceiver && serial.m_transport)
     {
-        LOG_ERROR("Cannot start rceiving. Error " << GetLastError() <<".");
-        trackHat_Disconnect(device);
-        return TH_ERROR_WRONG_PARAMETER;
+        LOG_INFO("Simulated device is received on its own threads.");
     }
 
-    // Start callback thread
-    callbackThread.m_isRunning = true;
-    callbackThread.m_threadHandler =
-        ::CreateThread(0, 0, trackHat_CallbackThreadFunction, pInternal, 0, &callbackThread.m_threadID);
-    if (callbackThread.m_threadHandler == nullptr)
+    if (pInternal->m_useSharedReceiver && !serial.m_transport)
     {
-        LOG_ERROR("Cannot start callback system. Error " << GetLastError() << ".");
-        trackHat_Disconnect(device);
-        return TH_ERROR_WRONG_PARAMETER;
+        // The reactor thread receives the data and calls the callbacks
+        result = Reactor::attach(pInternal);
+        if (result != TH_SUCCESS)
+        {
+            LOG_ERROR("Cannot start shared receiving.");
+            trackHat_Disconnect(device);
+            return result;
+        }
+        pInternal->m_isAttachedToReactor = true;
     }
+    else
+    {
+        // Start receiving thread
+        receiverThread.m_isRunning = true;
+        try
+        {
+            receiverThread.m_threadHandler = std::thread(trackHat_ReceiverThreadFunction, pInternal);
+        }
+        catch (const std::system_error& error)
+        {
+            LOG_ERROR("Cannot start rceiving. Error " << error.what() <<".");
+            receiverThread.m_isRunning = false;
+            trackHat_Disconnect(device);
+            return TH_ERROR_WRONG_PARAMETER;
+        }
 
-    pInternal->m_callback.m_mutex = ::CreateMutex(NULL, false, NULL);
+        // Start callback thread
+        callbackThread.m_isRunning = true;
+        try
+        {
+            callbackThread.m_threadHandler = std::thread(trackHat_CallbackThreadFunction, pInternal);
+        }
+        catch (const std::system_error& error)
+        {
+            LOG_ERROR("Cannot start callback system. Error " << error.what() << ".");
+            callbackThread.m_isRunning = false;
+            trackHat_Disconnect(device);
+            return TH_ERROR_WRONG_PARAMETER;
+        }
+    }
 
-    ::Sleep(50);  // Give 50 ms time to flush the buffers.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Give 50 ms time to flush the buffers.
 
     // Update device info
 #if 1
@@ -229,30 +353,28 @@ TH_ErrorCode trackHat_Disconnect(trackHat_Device_t* device)
     }
 #endif
 
-    // Stop receiving thread
-    receiverThread.m_isRunning = false;
-    if (receiverThread.m_threadHandler != nullptr)
+    // Stop shared receiving
+    if (pInternal->m_isAttachedToReactor)
     {
-        ::WaitForSingleObject(receiverThread.m_threadHandler, MESSAGE_EVENT_TIMEOUT_MS);
-        ::CloseHandle(receiverThread.m_threadHandler);
-        receiverThread.m_threadHandler = nullptr;
-        receiverThread.m_threadID = 0;
+        Reactor::detach(pInternal);
+        pInternal->m_isAttachedToReactor = false;
     }
 
-    // Stop callback thread
-    callbackThread.m_isRunning = false;
-    if (callbackThread.m_threadHandler != nullptr)
+    // Stop receiving thread
+    receiverThread.m_isRunning = false;
+    UsbSerial::wakeup(serial);
+    if (receiverThread.m_threadHandler.joinable())
     {
-        ::WaitForSingleObject(callbackThread.m_threadHandler, MESSAGE_EVENT_TIMEOUT_MS);
-        ::CloseHandle(callbackThread.m_threadHandler);
-        callbackThread.m_threadHandler = nullptr;
-        callbackThread.m_threadID = 0;
+        receiverThread.m_threadHandler.join();
     }
 
-    if (pInternal->m_callback.m_mutex != nullptr)
+    // Stop callback thread (wake it up instead of waiting for the timeout)
+    callbackThread.m_isRunning = false;
+    pInternal->m_messages.m_coordinates.m_newCallbackEvent.set();
+    pInternal->m_messages.m_extendedCoordinates.m_newCallbackEvent.set();
+    if (callbackThread.m_threadHandler.joinable())
     {
-        ::CloseHandle(pInternal->m_callback.m_mutex);
-        pInternal->m_callback.m_mutex = nullptr;
+        callbackThread.m_threadHandler.join();
     }
 
     pInternal->m_isOpen = false;
@@ -301,27 +423,38 @@ TH_ErrorCode trackHat_UpdateInternalStatus(trackHat_Device_t* device)
     //LOG_INFO("Update internal status.");
 
     uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE];
-    size_t txMessageSize = Parser::createMessageGetStatus(txMessage);
+    const uint8_t transactionID = pInternal->m_transactionID++;
+    size_t txMessageSize = Parser::createMessageGetStatus(txMessage, transactionID);
 
     // Update Status
 
-    ::ResetEvent(messageStatus.m_newMessageEvent);
+    messageStatus.m_newMessageEvent.reset();
     TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
     if (result != TH_SUCCESS)
     {
         return result;
     }
 
-    result = trackHat_WaitForNewMessageEvent(messageStatus.m_newMessageEvent, "Status message");
-    if (result != TH_SUCCESS)
+    // A late answer to an earlier request (or a status replayed from a capture file)
+    // is skipped, it can report the mode from before 'SET_MODE'
+    CameraStatus cameraStatus;
+    while (true)
     {
-        return result;
-    }
+        result = trackHat_WaitForNewMessageEvent(messageStatus.m_newMessageEvent, "Status message");
+        if (result != TH_SUCCESS)
+        {
+            return result;
+        }
 
-    ::WaitForSingleObject(messageStatus.m_mutex, INFINITE);
-    CameraStatus cameraStatus = messageStatus.m_camStatus;
-    device->m_isIdleMode = (messageStatus.m_camMode == CameraMode::CAM_IDLE);
-    ::ReleaseMutex(messageStatus.m_mutex);
+        std::lock_guard<std::mutex> lock(messageStatus.m_mutex);
+        if (messageStatus.m_transactionID == transactionID)
+        {
+            cameraStatus = messageStatus.m_camStatus;
+            device->m_isIdleMode = (messageStatus.m_camMode == CameraMode::CAM_IDLE);
+            break;
+        }
+        messageStatus.m_newMessageEvent.reset();
+    }
 
     switch (cameraStatus)
     {
@@ -371,9 +504,9 @@ TH_ErrorCode trackHat_UpdateInternalDeviceInfo(trackHat_Device_t* device)
     //LOG_INFO("Update internal device info.");
 
     uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE];
-    size_t txMessageSize = Parser::createMessageGetDeviceInfo(txMessage);
+    size_t txMessageSize = Parser::createMessageGetDeviceInfo(txMessage, pInternal->m_transactionID++);
 
-    ::ResetEvent(messageDeviceInfo.m_newMessageEvent);
+    messageDeviceInfo.m_newMessageEvent.reset();
     TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
     if (result != TH_SUCCESS)
     {
@@ -386,12 +519,13 @@ TH_ErrorCode trackHat_UpdateInternalDeviceInfo(trackHat_Device_t* device)
         return result;
     }
 
-    ::WaitForSingleObject(messageDeviceInfo.m_mutex, INFINITE);
-    device->m_hardwareVersion = messageDeviceInfo.m_hardwareVersion;
-    device->m_softwareVersionMajor = messageDeviceInfo.m_softwareVersionMajor;
-    device->m_softwareVersionMinor = messageDeviceInfo.m_softwareVersionMinor;
-    device->m_serialNumber = messageDeviceInfo.m_serialNumber;
-    ::ReleaseMutex(messageDeviceInfo.m_mutex);
+    {
+        std::lock_guard<std::mutex> lock(messageDeviceInfo.m_mutex);
+        device->m_hardwareVersion = messageDeviceInfo.m_hardwareVersion;
+        device->m_softwareVersionMajor = messageDeviceInfo.m_softwareVersionMajor;
+        device->m_softwareVersionMinor = messageDeviceInfo.m_softwareVersionMinor;
+        device->m_serialNumber = messageDeviceInfo.m_serialNumber;
+    }
 
     return TH_SUCCESS;
 }
@@ -414,7 +548,7 @@ TH_ErrorCode trackHat_EnableSendingCoordinates(trackHat_Device_t* device, bool e
     LOG_INFO((enable ? "Enable" : "Disable") << " sending of the coordinates.");
 
     uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE];
-    size_t txMessageSize = Parser::createMessageSetMode(txMessage, enable, frameType);
+    size_t txMessageSize = Parser::createMessageSetMode(txMessage, pInternal->m_transactionID++, enable, frameType);
 
     TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
     if (result != TH_SUCCESS)
@@ -469,37 +603,31 @@ TH_ErrorCode trackHat_GetUptime(trackHat_Device_t* device, uint32_t* seconds)
 }
 
 
-DWORD WINAPI trackHat_ReceiverThreadFunction(LPVOID lpParameter)
+void trackHat_ReceiverThreadFunction(trackHat_Internal_t* pInternal)
 {
-    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(lpParameter);
     trackHat_Thread_t& receiver = pInternal->m_receiver;
-    trackHat_Messages_t& messages = pInternal->m_messages;
     usbSerial_t& serial = pInternal->m_serial;
     TH_ErrorCode result = TH_SUCCESS;
 
-    // Buffer for serial per iteration MessageCoordinates::FrameSize size makes the USB
-    // return the data immediately after receiving the coordinate frame and not wait until
-    // the end of the timeout in case the buffer is large
-    uint8_t serialBuffer[MessageExtendedCoordinates::FrameSize];
+    // 'UsbSerial::read()' returns as soon as any data arrives, so the whole free space of
+    // the buffer is used. It is woken up by 'UsbSerial::wakeup()' when receiving is stopped.
     size_t readSize = 0;
 
-    std::vector<uint8_t> dataBuffer;   // data to parse
-    dataBuffer.reserve(MESSAGE_RX_BUFFER_SIZE);
+    Parser::RxBuffer dataBuffer;   // data to parse, received directly into the buffer
 
     LOG_INFO("Receiving started.");
 
     while (receiver.m_isRunning)
     {
-        result = UsbSerial::read(serial, serialBuffer, sizeof(serialBuffer), readSize);
+        result = UsbSerial::read(serial, dataBuffer.writePointer(), dataBuffer.writeSpace(), readSize);
+        const uint64_t timestampUs = trackHat_GetTimestampUs();
 
         if (!receiver.m_isRunning)
             break;
 
         if ((result==TH_SUCCESS) && (readSize>0))
         {
-            dataBuffer.insert(dataBuffer.end(), serialBuffer, serialBuffer + readSize);
-
-            Parser::parseInputData(dataBuffer, messages);
+            trackHat_HandleReceivedData(pInternal, dataBuffer, readSize, timestampUs);
         }
         else if (result==TH_ERROR_DEVICE_COMMUNICATION_FAILED)
         {
@@ -514,124 +642,246 @@ DWORD WINAPI trackHat_ReceiverThreadFunction(LPVOID lpParameter)
     }
 
     LOG_INFO("Receiving finished.");
-    return 0;
 }
 
 
-DWORD WINAPI trackHat_CallbackThreadFunction(LPVOID lpParameter)
+void trackHat_HandleReceivedData(trackHat_Internal_t* pInternal, Parser::RxBuffer& dataBuffer, size_t readSize, uint64_t timestampUs)
 {
-    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(lpParameter);
-    trackHat_Callback_t& callback = pInternal->m_callback;
-    MessageCoordinates& coordinates = pInternal->m_messages.m_coordinates;
-    MessageExtendedCoordinates& extendedCoordinates = pInternal->m_messages.m_extendedCoordinates;
+    pInternal->m_recorder.write(timestampUs, dataBuffer.writePointer(), readSize);
+    dataBuffer.commit(readSize);
+
+    Statistics::DeviceStatistics& statistics = pInternal->m_messages.m_statistics;
+    statistics.m_receivedBytes.add(readSize);
+    statistics.m_readSize.add(readSize);
+
+    Parser::parseInputData(dataBuffer, pInternal->m_messages, timestampUs);
+}
+
 
+void trackHat_CallbackThreadFunction(trackHat_Internal_t* pInternal)
+{
+    trackHat_Callback_t& callback = pInternal->m_callback;
     time_t lastErrorTimeSec = 0;
-    trackHat_Points_t points;
-    trackHat_ExtendedPoints_t extendedPoints;
-    DWORD result;
 
     LOG_INFO("Callback system started.");
 
     while (callback.m_thread.m_isRunning)
     {
-        if (pInternal->m_frameType == TH_FRAME_BASIC)
-        {
-            // Check 'm_thread.m_isRunning' every 100 ms
+        // Check 'm_thread.m_isRunning' every 100 ms
+        bool isNewPoints = trackHat_WaitForNewPoints(pInternal, CALLBACK_WAIT_TIMEOUT_MS);
 
-            result = ::WaitForSingleObject(coordinates.m_newCallbackEvent, 100);
+        if (callback.m_thread.m_isRunning == false)
+            break;
 
-            if (callback.m_thread.m_isRunning == false)
-                break;
+        trackHat_RunCallbacks(pInternal, isNewPoints, lastErrorTimeSec);
+    }
 
-            ::WaitForSingleObject(callback.m_mutex, INFINITE);
+    LOG_INFO("Callback system finished.");
+}
 
-            if (callback.m_simplePointsCallbackFunction != nullptr)
-            {
-                if (result == WAIT_OBJECT_0)
-                {
-                    ::WaitForSingleObject(coordinates.m_mutex, INFINITE);
-                    ::memcpy(&points, &coordinates.m_points, sizeof(trackHat_Points_t));
-                    ::ReleaseMutex(coordinates.m_mutex);
-
-                    trackHat_CallbackFunction(callback.m_simplePointsCallbackFunction, TH_SUCCESS, &points);
-                }
-                else
-                {
-                    time_t currentTimeSec;
-                    time(&currentTimeSec);
-
-                    // Run callback function with error at intervals of 2 seconds
-                    if (currentTimeSec - lastErrorTimeSec > CAMERA_ERROR_CHECK_INTERVAL)
-                    {
-                        TH_ErrorCode error = TH_ERROR_WRONG_PARAMETER;
-                        if (result == WAIT_TIMEOUT)
-                        {
-                            if (pInternal->m_isUnplugged)
-                                error = TH_ERROR_DEVICE_DISCONNECTED;
-                            else if (pInternal->m_isOpen)
-                                error = TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
-                            else
-                                error = TH_ERROR_DEVICE_NOT_OPEN;
-                        }
-
-                        trackHat_CallbackFunction(callback.m_simplePointsCallbackFunction, error, nullptr);
-                        lastErrorTimeSec = currentTimeSec;
-                    }
-                }
-            }
-        }
-        else if (pInternal->m_frameType == TH_FRAME_EXTENDED)
+
+bool trackHat_WaitForNewPoints(trackHat_Internal_t* pInternal, uint32_t timeoutMs)
+{
+    if (pInternal->m_useInlineCallbacks)
+    {
+        // The callbacks were called by the receiver, only the time without points matters,
+        // so the thread sleeps instead of waiting for the events of the parser
+        std::atomic<bool>& isInlinePointsReceived = pInternal->m_callback.m_isInlinePointsReceived;
+        if (isInlinePointsReceived.exchange(false))
+            return true;
+
+        if (timeoutMs > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return isInlinePointsReceived.exchange(false);
+    }
+
+    if (pInternal->m_frameType == TH_FRAME_EXTENDED)
+        return pInternal->m_messages.m_extendedCoordinates.m_newCallbackEvent.wait(timeoutMs);
+
+    return pInternal->m_messages.m_coordinates.m_newCallbackEvent.wait(timeoutMs);
+}
+
+
+/* Time from receiving the points to passing them to the callback or a subscriber, from any of their threads */
+static void trackHat_AddCallbackLatency(trackHat_Internal_t* pInternal, uint64_t pointsTimestampUs)
+{
+    const uint64_t timestampUs = trackHat_GetTimestampUs();
+    pInternal->m_messages.m_statistics.m_callbackLatencyUs.addConcurrent((timestampUs > pointsTimestampUs) ? (timestampUs - pointsTimestampUs) : 0);
+}
+
+/* Decode the payload of the latest frame of the message */
+template<typename Message, typename Points>
+static void trackHat_DecodeLatestPoints(const Message& message, Points& points, void (*decoder)(const uint8_t*, Points&))
+{
+    RawPoints<Message::FrameSize - 3> rawPoints;
+    message.m_rawPoints.load(rawPoints);
+
+    decoder(rawPoints.m_payload, points);
+    points.m_timestampUs = rawPoints.m_timestampUs;
+    points.m_frameNumber = rawPoints.m_frameNumber;
+}
+
+/* Pass the latest frame without the empty points to the compact callback */
+template<typename Message, typename CompactPoints, typename Callback>
+static void trackHat_RunCompactCallback(trackHat_Internal_t* pInternal, const Message& message, Callback callbackFunction,
+                                        void (*decoder)(const uint8_t*, CompactPoints&))
+{
+    CompactPoints points;
+    trackHat_DecodeLatestPoints(message, points, decoder);
+    trackHat_AddCallbackLatency(pInternal, points.m_timestampUs);
+
+    trackHat_CallbackFunction(callbackFunction, TH_SUCCESS, &points);
+}
+
+/* Pass the points to the callbacks directly from the receiver */
+template<typename Points, typename Callback, typename Message, typename CompactPoints, typename CompactCallback>
+static void trackHat_RunInlineCallback(trackHat_Internal_t* pInternal, Callback trackHat_Callback_t::* callbackFunction,
+                                       CompactCallback trackHat_Callback_t::* compactCallbackFunction,
+                                       const Message& message, void (*compactDecoder)(const uint8_t*, CompactPoints&),
+                                       TH_FrameType frameType, const Points* points)
+{
+    trackHat_Callback_t& callback = pInternal->m_callback;
+
+    // Frames of the other type may arrive while the frame type is changed
+    if (pInternal->m_frameType != frameType)
+        return;
+
+    {
+        std::lock_guard<std::mutex> callbackLock(callback.m_mutex);
+
+        if (callback.*callbackFunction != nullptr)
         {
-            // Check 'm_thread.m_isRunning' every 100 ms
+            trackHat_AddCallbackLatency(pInternal, points->m_timestampUs);
+            trackHat_CallbackFunction(callback.*callbackFunction, TH_SUCCESS, points);
+        }
+
+        // The receiver is the writer of the raw points, they are the same frame
+        if (callback.*compactCallbackFunction != nullptr)
+            trackHat_RunCompactCallback(pInternal, message, callback.*compactCallbackFunction, compactDecoder);
+    }
+
+    callback.m_isInlinePointsReceived.store(true, std::memory_order_relaxed);
+}
+
+void trackHat_SetupInlineCallbacks(trackHat_Internal_t* pInternal)
+{
+    MessageCoordinates& coordinates = pInternal->m_messages.m_coordinates;
+    MessageExtendedCoordinates& extendedCoordinates = pInternal->m_messages.m_extendedCoordinates;
+
+    if (!pInternal->m_useInlineCallbacks)
+    {
+        coordinates.m_inlineCallback = nullptr;
+        extendedCoordinates.m_inlineCallback = nullptr;
+        return;
+    }
+
+    coordinates.m_inlineCallbackContext = pInternal;
+    coordinates.m_inlineCallback = [](void* context, const trackHat_Points_t* points)
+    {
+        trackHat_Internal_t* pInternal = static_cast<trackHat_Internal_t*>(context);
+        trackHat_RunInlineCallback(pInternal, &trackHat_Callback_t::m_simplePointsCallbackFunction,
+                                   &trackHat_Callback_t::m_compactPointsCallbackFunction,
+                                   pInternal->m_messages.m_coordinates, Decode::decodeCompactPoints, TH_FRAME_BASIC, points);
+    };
+
+    extendedCoordinates.m_inlineCallbackContext = pInternal;
+    extendedCoordinates.m_inlineCallback = [](void* context, const trackHat_ExtendedPoints_t* points)
+    {
+        trackHat_Internal_t* pInternal = static_cast<trackHat_Internal_t*>(context);
+        trackHat_RunInlineCallback(pInternal, &trackHat_Callback_t::m_extendedPointsCallbackFunction,
+                                   &trackHat_Callback_t::m_compactExtendedPointsCallbackFunction,
+                                   pInternal->m_messages.m_extendedCoordinates, Decode::decodeCompactExtendedPoints,
+                                   TH_FRAME_EXTENDED, points);
+    };
+}
+
+/* Error passed to the callbacks and the subscribers when no points arrive */
+static TH_ErrorCode trackHat_GetPointsError(trackHat_Internal_t* pInternal)
+{
+    if (pInternal->m_isUnplugged)
+        return TH_ERROR_DEVICE_DISCONNECTED;
+    if (pInternal->m_isOpen)
+        return TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
+    return TH_ERROR_DEVICE_NOT_OPEN;
+}
+
+void trackHat_RunCallbacks(trackHat_Internal_t* pInternal, bool isNewPoints, time_t& lastErrorTimeSec)
+{
+    trackHat_Callback_t& callback = pInternal->m_callback;
+    trackHat_Messages_t& messages = pInternal->m_messages;
+    const TH_FrameType frameType = pInternal->m_frameType;
 
-            result = ::WaitForSingleObject(extendedCoordinates.m_newCallbackEvent, 100);
+    std::lock_guard<std::mutex> callbackLock(callback.m_mutex);
 
-            if (callback.m_thread.m_isRunning == false)
-                break;
+    const bool isCallbackSet = (frameType == TH_FRAME_EXTENDED)
+        ? ((callback.m_extendedPointsCallbackFunction != nullptr) || (callback.m_compactExtendedPointsCallbackFunction != nullptr))
+        : ((callback.m_simplePointsCallbackFunction != nullptr) || (callback.m_compactPointsCallbackFunction != nullptr));
+    if (!isCallbackSet)
+        return;
 
-            ::WaitForSingleObject(callback.m_mutex, INFINITE);
+    if (isNewPoints)
+    {
+        // Already passed to the callback by the receiver
+        if (pInternal->m_useInlineCallbacks)
+            return;
 
+        if (frameType == TH_FRAME_EXTENDED)
+        {
             if (callback.m_extendedPointsCallbackFunction != nullptr)
             {
-                if (result == WAIT_OBJECT_0)
-                {
-                    ::WaitForSingleObject(extendedCoordinates.m_mutex, INFINITE);
-                    ::memcpy(&extendedPoints, &extendedCoordinates.m_points, sizeof(trackHat_ExtendedPoints_t));
-                    ::ReleaseMutex(extendedCoordinates.m_mutex);
-
-                    trackHat_CallbackFunction(callback.m_extendedPointsCallbackFunction, TH_SUCCESS, &extendedPoints);
-                }
-                else
-                {
-                    time_t currentTimeSec;
-                    time(&currentTimeSec);
-
-                    // Run callback function with error at intervals of 2 seconds
-                    if (currentTimeSec - lastErrorTimeSec > 2)
-                    {
-                        TH_ErrorCode error = TH_ERROR_WRONG_PARAMETER;
-                        if (result == WAIT_TIMEOUT)
-                        {
-                            if (pInternal->m_isUnplugged)
-                                error = TH_ERROR_DEVICE_DISCONNECTED;
-                            else if (pInternal->m_isOpen)
-                                error = TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
-                            else
-                                error = TH_ERROR_DEVICE_NOT_OPEN;
-                        }
-
-                        trackHat_CallbackFunction(callback.m_extendedPointsCallbackFunction, error, nullptr);
-                        lastErrorTimeSec = currentTimeSec;
-                    }
-                }
+                trackHat_ExtendedPoints_t extendedPoints;
+                trackHat_DecodeLatestPoints(messages.m_extendedCoordinates, extendedPoints, Decode::decodeExtendedPoints);
+                trackHat_AddCallbackLatency(pInternal, extendedPoints.m_timestampUs);
+
+                trackHat_CallbackFunction(callback.m_extendedPointsCallbackFunction, TH_SUCCESS, &extendedPoints);
             }
+
+            if (callback.m_compactExtendedPointsCallbackFunction != nullptr)
+                trackHat_RunCompactCallback(pInternal, messages.m_extendedCoordinates,
+                                            callback.m_compactExtendedPointsCallbackFunction, Decode::decodeCompactExtendedPoints);
         }
+        else
+        {
+            if (callback.m_simplePointsCallbackFunction != nullptr)
+            {
+                trackHat_Points_t points;
+                messages.m_coordinates.m_points.load(points);
+                trackHat_AddCallbackLatency(pInternal, points.m_timestampUs);
+
+                trackHat_CallbackFunction(callback.m_simplePointsCallbackFunction, TH_SUCCESS, &points);
+            }
 
-        ::ReleaseMutex(callback.m_mutex);
+            if (callback.m_compactPointsCallbackFunction != nullptr)
+                trackHat_RunCompactCallback(pInternal, messages.m_coordinates,
+                                            callback.m_compactPointsCallbackFunction, Decode::decodeCompactPoints);
+        }
+        return;
     }
 
-    LOG_INFO("Callback system finished.");
-    return 0;
+    time_t currentTimeSec;
+    time(&currentTimeSec);
+
+    // Run callback function with error at intervals of 2 seconds
+    if (currentTimeSec - lastErrorTimeSec > static_cast<time_t>(CAMERA_ERROR_CHECK_INTERVAL))
+    {
+        const TH_ErrorCode error = trackHat_GetPointsError(pInternal);
+
+        if (frameType == TH_FRAME_EXTENDED)
+        {
+            if (callback.m_extendedPointsCallbackFunction != nullptr)
+                trackHat_CallbackFunction(callback.m_extendedPointsCallbackFunction, error, nullptr);
+            if (callback.m_compactExtendedPointsCallbackFunction != nullptr)
+                trackHat_CallbackFunction(callback.m_compactExtendedPointsCallbackFunction, error, nullptr);
+        }
+        else
+        {
+            if (callback.m_simplePointsCallbackFunction != nullptr)
+                trackHat_CallbackFunction(callback.m_simplePointsCallbackFunction, error, nullptr);
+            if (callback.m_compactPointsCallbackFunction != nullptr)
+                trackHat_CallbackFunction(callback.m_compactPointsCallbackFunction, error, nullptr);
+        }
+        lastErrorTimeSec = currentTimeSec;
+    }
 }
 
 
@@ -662,55 +912,207 @@ void trackHat_CallbackFunction(trackHat_ExtendedPointsCallback_t callbackFunctio
     }
 }
 
-TH_ErrorCode trackHat_WaitForNewMessageEvent(HANDLE event, const char* eventName)
+void trackHat_CallbackFunction(trackHat_CompactPointsCallback_t callbackFunction,
+                               TH_ErrorCode errorCode,
+                               const trackHat_CompactPoints_t* const points)
 {
-    if (eventName == nullptr)
-        eventName = "";
-
-    DWORD result = ::WaitForSingleObject(event, MESSAGE_EVENT_TIMEOUT_MS);
-    switch (result)
+    try
     {
-        case WAIT_OBJECT_0:
-            //LOG_INFO("Receiving event " << eventName << " OK.");
-            return TH_SUCCESS;
-
-        case WAIT_TIMEOUT:
-            LOG_ERROR("Receiving event " << eventName << " tiemout.");
-            return TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
-
-        default:
-            LOG_ERROR("Receiving event " << eventName <<" filed. Error " << GetLastError() << ".");
-            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        callbackFunction(errorCode, points);
+    }
+    catch (const std::exception&)
+    {
+        LOG_ERROR("An exception has occurred in the callback function.");
     }
 }
 
-TH_ErrorCode trackHat_GetDetectedPoints(trackHat_Device_t* device, trackHat_Points_t* points)
+void trackHat_CallbackFunction(trackHat_CompactExtendedPointsCallback_t callbackFunction,
+                               TH_ErrorCode errorCode,
+                               const trackHat_CompactExtendedPoints_t* const points)
 {
-    if ((device == nullptr) || (device->m_pInternal == nullptr) || (points == nullptr))
-        return TH_ERROR_WRONG_PARAMETER;
-
-    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
-    MessageCoordinates& coordinates = pInternal->m_messages.m_coordinates;
-    TH_ErrorCode result = TH_ERROR_WRONG_PARAMETER;
-
-    if (pInternal->m_isUnplugged)
+    try
     {
-        return TH_ERROR_DEVICE_DISCONNECTED;
+        callbackFunction(errorCode, points);
     }
+    catch (const std::exception&)
+    {
+        LOG_ERROR("An exception has occurred in the callback function.");
+    }
+}
 
-    result = trackHat_WaitForNewMessageEvent(coordinates.m_newMessageEvent /*, "Coordinates message" */);
-    ::ResetEvent(coordinates.m_newMessageEvent);
 
-    if (result != TH_SUCCESS)
-        return result;
+/* Run subscriber function with provided parameters */
+template<typename Function, typename Points>
+static void trackHat_SubscriberFunction(Function subscriberFunction, void* context, TH_ErrorCode errorCode, const Points* points)
+{
+    try
+    {
+        subscriberFunction(context, errorCode, points);
+    }
+    catch (const std::exception&)
+    {
+        LOG_ERROR("An exception has occurred in the subscriber function.");
+    }
+}
+
+/* Pass the points published in the ring to the subscriber according to its delivery policy */
+template<typename Points, typename Function>
+static void trackHat_DeliverToSubscriber(trackHat_Internal_t* pInternal, trackHat_Subscription_t& subscription,
+                                         Sync::BroadcastRing<Points, TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH>& ring,
+                                         Function subscriberFunction, TH_FrameType frameType)
+{
+    const trackHat_SubscriptionConfig_t& config = subscription.m_config;
+    const uint64_t step = (config.m_policy == TH_DELIVER_DECIMATED) ? config.m_decimation : 1;
+    uint64_t nextIndex = ring.writeIndex();   // only the points received from now on
+    time_t lastErrorTimeSec = 0;
+    Points points;
+
+    while (subscription.m_thread.m_isRunning)
+    {
+        // Check 'm_thread.m_isRunning' every 100 ms
+        if (!ring.wait(nextIndex, CALLBACK_WAIT_TIMEOUT_MS))
+        {
+            time_t currentTimeSec;
+            time(&currentTimeSec);
+
+            // Report the errors of the connected device as the callbacks do, at intervals of 2 seconds
+            const bool isConnected = pInternal->m_isOpen || pInternal->m_isUnplugged;
+            if (subscription.m_thread.m_isRunning && isConnected && (pInternal->m_frameType == frameType) &&
+                (currentTimeSec - lastErrorTimeSec > static_cast<time_t>(CAMERA_ERROR_CHECK_INTERVAL)))
+            {
+                trackHat_SubscriberFunction(subscriberFunction, subscription.m_context, trackHat_GetPointsError(pInternal),
+                                            static_cast<const Points*>(nullptr));
+                lastErrorTimeSec = currentTimeSec;
+            }
+            continue;
+        }
+
+        const uint64_t writeIndex = ring.writeIndex();
+        if (config.m_policy == TH_DELIVER_LATEST)
+        {
+            nextIndex = writeIndex - 1;
+        }
+        else
+        {
+            // Drop the oldest points over the queue depth
+            const uint64_t pendingCount = (writeIndex - nextIndex - 1) / step + 1;
+            if (pendingCount > config.m_queueDepth)
+                nextIndex += (pendingCount - config.m_queueDepth) * step;
+        }
+
+        // The slot may be reused meanwhile if the subscriber is very late, the points are skipped then
+        if (ring.read(nextIndex, points))
+        {
+            trackHat_AddCallbackLatency(pInternal, points.m_timestampUs);
+            trackHat_SubscriberFunction(subscriberFunction, subscription.m_context, TH_SUCCESS, &points);
+        }
+        nextIndex += step;
+    }
+}
+
+void trackHat_SubscriptionThreadFunction(trackHat_Internal_t* pInternal, trackHat_Subscription_t* subscription)
+{
+    if (subscription->m_pointsFunction != nullptr)
+        trackHat_DeliverToSubscriber(pInternal, *subscription, pInternal->m_messages.m_coordinates.m_subscriptionRing,
+                                     subscription->m_pointsFunction, TH_FRAME_BASIC);
+    else
+        trackHat_DeliverToSubscriber(pInternal, *subscription, pInternal->m_messages.m_extendedCoordinates.m_subscriptionRing,
+                                     subscription->m_extendedPointsFunction, TH_FRAME_EXTENDED);
+}
+
+TH_ErrorCode trackHat_WaitForNewMessageEvent(Sync::Event& event, const char* eventName)
+{
+    if (eventName == nullptr)
+        eventName = "";
+
+    if (!event.wait(MESSAGE_EVENT_TIMEOUT_MS))
+    {
+        LOG_ERROR("Receiving event " << eventName << " tiemout.");
+        return TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
+    }
+
+    //LOG_INFO("Receiving event " << eventName << " OK.");
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_GetDetectedPoints(trackHat_Device_t* device, trackHat_Points_t* points)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (points == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    MessageCoordinates& coordinates = pInternal->m_messages.m_coordinates;
+    TH_ErrorCode result = TH_ERROR_WRONG_PARAMETER;
+
+    if (pInternal->m_isUnplugged)
+    {
+        return TH_ERROR_DEVICE_DISCONNECTED;
+    }
+
+    result = trackHat_WaitForNewMessageEvent(coordinates.m_newMessageEvent /*, "Coordinates message" */);
+    coordinates.m_newMessageEvent.reset();
+
+    if (result != TH_SUCCESS)
+        return result;
+
+    coordinates.m_points.load(*points);
+
+    return TH_SUCCESS;
+}
+
+/* Wait for the next frame and decode its payload */
+template<typename Message, typename Points>
+static TH_ErrorCode trackHat_GetDecodedPoints(trackHat_Device_t* device, Message trackHat_Messages_t::* message,
+                                              Points* points, void (*decoder)(const uint8_t*, Points&))
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (points == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    Message& coordinates = pInternal->m_messages.*message;
+
+    if (pInternal->m_isUnplugged)
+    {
+        return TH_ERROR_DEVICE_DISCONNECTED;
+    }
+
+    TH_ErrorCode result = trackHat_WaitForNewMessageEvent(coordinates.m_newMessageEvent);
+    coordinates.m_newMessageEvent.reset();
+
+    if (result != TH_SUCCESS)
+        return result;
 
-    ::WaitForSingleObject(coordinates.m_mutex, INFINITE);
-    ::memcpy(points, &coordinates.m_points, sizeof(trackHat_Points_t));
-    ::ReleaseMutex(coordinates.m_mutex);
+    // Only the payload is copied from the receiver, it is decoded on this thread
+    trackHat_DecodeLatestPoints(coordinates, *points, decoder);
 
     return TH_SUCCESS;
 }
 
+TH_ErrorCode trackHat_GetDetectedPointsSoA(trackHat_Device_t* device, trackHat_PointsSoA_t* points)
+{
+    return trackHat_GetDecodedPoints(device, &trackHat_Messages_t::m_coordinates, points, Decode::decodePointsSoA);
+}
+
+TH_ErrorCode trackHat_GetDetectedPointsExtendedSoA(trackHat_Device_t* device, trackHat_ExtendedPointsSoA_t* points)
+{
+    return trackHat_GetDecodedPoints(device, &trackHat_Messages_t::m_extendedCoordinates, points, Decode::decodeExtendedPointsSoA);
+}
+
+TH_ErrorCode trackHat_GetDetectedCompactPoints(trackHat_Device_t* device, trackHat_CompactPoints_t* points)
+{
+    return trackHat_GetDecodedPoints(device, &trackHat_Messages_t::m_coordinates, points, Decode::decodeCompactPoints);
+}
+
+TH_ErrorCode trackHat_GetDetectedCompactExtendedPoints(trackHat_Device_t* device, trackHat_CompactExtendedPoints_t* points)
+{
+    return trackHat_GetDecodedPoints(device, &trackHat_Messages_t::m_extendedCoordinates, points, Decode::decodeCompactExtendedPoints);
+}
+
+TH_ErrorCode trackHat_GetDetectedPointsExtendedRaw(trackHat_Device_t* device, trackHat_ExtendedPointsRaw_t* points)
+{
+    return trackHat_GetDecodedPoints(device, &trackHat_Messages_t::m_extendedCoordinates, points, Decode::copyExtendedPointsRaw);
+}
+
 TH_ErrorCode trackHat_GetDetectedExtendedPoints(trackHat_Device_t* device, trackHat_ExtendedPoints_t* points)
 {
     if ((device == nullptr) || (device->m_pInternal == nullptr) || (points == nullptr))
@@ -726,14 +1128,13 @@ TH_ErrorCode trackHat_GetDetectedExtendedPoints(trackHat_Device_t* device, track
     }
 
     result = trackHat_WaitForNewMessageEvent(extendedCoordinates.m_newMessageEvent /*, "Coordinates message" */);
-    ::ResetEvent(extendedCoordinates.m_newMessageEvent);
+    extendedCoordinates.m_newMessageEvent.reset();
 
     if (result != TH_SUCCESS)
         return result;
 
-    ::WaitForSingleObject(extendedCoordinates.m_mutex, INFINITE);
-    ::memcpy(points, &extendedCoordinates.m_points, sizeof(trackHat_ExtendedPoints_t));
-    ::ReleaseMutex(extendedCoordinates.m_mutex);
+    // Only the payload is copied from the receiver, it is decoded on this thread
+    trackHat_DecodeLatestPoints(extendedCoordinates, *points, Decode::decodeExtendedPoints);
 
     return TH_SUCCESS;
 }
@@ -760,9 +1161,10 @@ TH_ErrorCode trackHat_SetCallback(trackHat_Device_t* device, trackHat_PointsCall
         // do nothing
     }
 
-    ::WaitForSingleObject(callback.m_mutex, INFINITE);
-    callback.m_simplePointsCallbackFunction = newPoints_callback;
-    ::ReleaseMutex(callback.m_mutex);
+    {
+        std::lock_guard<std::mutex> lock(callback.m_mutex);
+        callback.m_simplePointsCallbackFunction = newPoints_callback;
+    }
 
     return TH_SUCCESS;
 }
@@ -795,13 +1197,153 @@ TH_ErrorCode trackHat_SetExtendedPointsCallback(trackHat_Device_t *device, track
         //do nothing
     }
 
-    ::WaitForSingleObject(callback.m_mutex, INFINITE);
-    callback.m_extendedPointsCallbackFunction = newExtendedPointsCallback;
-    ::ReleaseMutex(callback.m_mutex);
+    {
+        std::lock_guard<std::mutex> lock(callback.m_mutex);
+        callback.m_extendedPointsCallbackFunction = newExtendedPointsCallback;
+    }
 
     return TH_SUCCESS;
 }
 
+/* Set or remove (nullptr) a callback of the device */
+template<typename Callback>
+static TH_ErrorCode trackHat_SetCallbackFunction(trackHat_Device_t* device, Callback trackHat_Callback_t::* callbackFunction,
+                                                 Callback newCallback)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Callback_t& callback = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal)->m_callback;
+
+    if (newCallback != nullptr)
+        LOG_INFO("Set callback.");
+    else if (callback.*callbackFunction != nullptr)
+        LOG_INFO("Remove callback.");
+
+    {
+        std::lock_guard<std::mutex> lock(callback.m_mutex);
+        callback.*callbackFunction = newCallback;
+    }
+
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_SetCompactPointsCallback(trackHat_Device_t* device, trackHat_CompactPointsCallback_t newCompactPointsCallback)
+{
+    return trackHat_SetCallbackFunction(device, &trackHat_Callback_t::m_compactPointsCallbackFunction, newCompactPointsCallback);
+}
+
+TH_ErrorCode trackHat_SetCompactExtendedPointsCallback(trackHat_Device_t* device,
+                                                       trackHat_CompactExtendedPointsCallback_t newCompactExtendedPointsCallback)
+{
+    return trackHat_SetCallbackFunction(device, &trackHat_Callback_t::m_compactExtendedPointsCallbackFunction,
+                                        newCompactExtendedPointsCallback);
+}
+
+/* Start the delivery thread of a free subscription, only one of the functions is set */
+static TH_ErrorCode trackHat_StartSubscription(trackHat_Device_t* device, const trackHat_SubscriptionConfig_t* config,
+                                               trackHat_PointsSubscriber_t pointsFunction,
+                                               trackHat_ExtendedPointsSubscriber_t extendedPointsFunction,
+                                               void* context, uint32_t* subscriptionID)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (config == nullptr) || (subscriptionID == nullptr) ||
+        ((pointsFunction == nullptr) && (extendedPointsFunction == nullptr)))
+    {
+        LOG_ERROR("Bad use of the function.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    const bool isPolicyValid = (config->m_policy == TH_DELIVER_LATEST) || (config->m_policy == TH_DELIVER_EVERY_FRAME) ||
+                               ((config->m_policy == TH_DELIVER_DECIMATED) && (config->m_decimation > 0));
+    if (!isPolicyValid || (config->m_queueDepth == 0) || (config->m_queueDepth > TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH))
+    {
+        LOG_ERROR("Wrong subscription configuration.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    std::lock_guard<std::mutex> lock(pInternal->m_subscriptionMutex);
+
+    size_t index = 0;
+    while ((index < TRACK_HAT_MAX_SUBSCRIPTIONS) && pInternal->m_subscriptions[index].m_thread.m_threadHandler.joinable())
+        index++;
+
+    if (index == TRACK_HAT_MAX_SUBSCRIPTIONS)
+    {
+        LOG_ERROR("No free subscription.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    // The ring is allocated for the first subscriber and kept, the receiver may already run
+    const bool isAllocated = (pointsFunction != nullptr) ? pInternal->m_messages.m_coordinates.m_subscriptionRing.allocate()
+                                                         : pInternal->m_messages.m_extendedCoordinates.m_subscriptionRing.allocate();
+    if (!isAllocated)
+    {
+        LOG_ERROR("Lack of memory.");
+        return TH_MEMORY_ALLOCATION_FAILED;
+    }
+
+    trackHat_Subscription_t& subscription = pInternal->m_subscriptions[index];
+    subscription.m_config = *config;
+    subscription.m_pointsFunction = pointsFunction;
+    subscription.m_extendedPointsFunction = extendedPointsFunction;
+    subscription.m_context = context;
+
+    subscription.m_thread.m_isRunning = true;
+    try
+    {
+        subscription.m_thread.m_threadHandler = std::thread(trackHat_SubscriptionThreadFunction, pInternal, &subscription);
+    }
+    catch (const std::system_error& error)
+    {
+        LOG_ERROR("Cannot start subscription. Error " << error.what() << ".");
+        subscription.m_thread.m_isRunning = false;
+        return TH_MEMORY_ALLOCATION_FAILED;
+    }
+
+    *subscriptionID = static_cast<uint32_t>(index + 1);
+    LOG_INFO("Subscription " << *subscriptionID << " started.");
+    return TH_SUCCESS;
+}
+
+void trackHat_StopSubscription(trackHat_Subscription_t& subscription)
+{
+    subscription.m_thread.m_isRunning = false;
+    subscription.m_thread.m_threadHandler.join();
+    subscription.m_pointsFunction = nullptr;
+    subscription.m_extendedPointsFunction = nullptr;
+}
+
+TH_ErrorCode trackHat_Subscribe(trackHat_Device_t* device, const trackHat_SubscriptionConfig_t* config,
+                                trackHat_PointsSubscriber_t subscriber, void* context, uint32_t* subscriptionID)
+{
+    return trackHat_StartSubscription(device, config, subscriber, nullptr, context, subscriptionID);
+}
+
+TH_ErrorCode trackHat_SubscribeExtended(trackHat_Device_t* device, const trackHat_SubscriptionConfig_t* config,
+                                        trackHat_ExtendedPointsSubscriber_t subscriber, void* context, uint32_t* subscriptionID)
+{
+    return trackHat_StartSubscription(device, config, nullptr, subscriber, context, subscriptionID);
+}
+
+TH_ErrorCode trackHat_Unsubscribe(trackHat_Device_t* device, uint32_t subscriptionID)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) ||
+        (subscriptionID == 0) || (subscriptionID > TRACK_HAT_MAX_SUBSCRIPTIONS))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    std::lock_guard<std::mutex> lock(pInternal->m_subscriptionMutex);
+
+    trackHat_Subscription_t& subscription = pInternal->m_subscriptions[subscriptionID - 1];
+    if (!subscription.m_thread.m_threadHandler.joinable())
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_StopSubscription(subscription);
+    LOG_INFO("Subscription " << subscriptionID << " finished.");
+    return TH_SUCCESS;
+}
+
 TH_ErrorCode trackHat_GetDetectedPointsExtended(trackHat_Device_t *device, trackHat_ExtendedPoints_t *points)
 {
     if ((device == nullptr) || (device->m_pInternal == nullptr) || (points == nullptr))
@@ -817,129 +1359,515 @@ TH_ErrorCode trackHat_GetDetectedPointsExtended(trackHat_Device_t *device, track
     }
 
     result = trackHat_WaitForNewMessageEvent(extendedCoordinates.m_newMessageEvent /*, "Coordinates message" */);
-    ::ResetEvent(extendedCoordinates.m_newMessageEvent);
+    extendedCoordinates.m_newMessageEvent.reset();
 
     if (result != TH_SUCCESS)
         return result;
 
-    ::WaitForSingleObject(extendedCoordinates.m_mutex, INFINITE);
-    ::memcpy(points, &extendedCoordinates.m_points, sizeof(trackHat_ExtendedPoints_t));
-    ::ReleaseMutex(extendedCoordinates.m_mutex);
+    // Only the payload is copied from the receiver, it is decoded on this thread
+    trackHat_DecodeLatestPoints(extendedCoordinates, *points, Decode::decodeExtendedPoints);
 
     return TH_SUCCESS;
 }
 
-TH_ErrorCode trackHat_SetRegisterValue(trackHat_Device_t* device, trackHat_SetRegister_t* newRegisterValue)
+TH_ErrorCode trackHat_EnableFrameQueue(trackHat_Device_t* device, uint32_t depth)
 {
-    if ((device==nullptr) || (device->m_pInternal == nullptr))
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
         return TH_ERROR_WRONG_PARAMETER;
 
     trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
-    usbSerial_t& serial = pInternal->m_serial;
 
-    if (pInternal->m_isUnplugged)
+    // The queues are resized without synchronization, so the receiver must be stopped
+    if (pInternal->m_serial.m_isPortOpen)
     {
-        return TH_ERROR_DEVICE_DISCONNECTED;
+        LOG_ERROR("Frame queue cannot be changed while the device is connected.");
+        return TH_ERROR_DEVICE_ALREADY_OPEN;
     }
 
-    uint8_t transactionID = 0;
-    uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE] = {};
-    size_t  txMessageSize = Parser::createMessageSetRegister(txMessage, MESSAGE_TX_BUFFER_SIZE, newRegisterValue, &transactionID);
-    TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
-    if (result != TH_SUCCESS)
+    LOG_INFO("Set frame queue depth to " << depth << ".");
+
+    try
     {
-        return result;
+        pInternal->m_messages.m_coordinates.m_queue.resize(depth);
+        pInternal->m_messages.m_extendedCoordinates.m_queue.resize(depth);
+    }
+    catch (const std::bad_alloc&)
+    {
+        LOG_ERROR("Lack of memory.");
+        pInternal->m_messages.m_coordinates.m_queue.resize(0);
+        pInternal->m_messages.m_extendedCoordinates.m_queue.resize(0);
+        return TH_MEMORY_ALLOCATION_FAILED;
     }
 
-    result = trackHat_WaitForResponse(pInternal, transactionID);
-    return result;
+    return TH_SUCCESS;
 }
 
-TH_ErrorCode trackHat_SetRegisterGroupValue(trackHat_Device_t* device, trackHat_SetRegisterGroup_t* newRegisterGroupValue)
+TH_ErrorCode trackHat_EnableSharedReceiver(trackHat_Device_t* device, uint8_t enable)
 {
-    if ((device==nullptr) || (device->m_pInternal == nullptr))
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
         return TH_ERROR_WRONG_PARAMETER;
 
     trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
-    usbSerial_t& serial = pInternal->m_serial;
+
+    if (pInternal->m_serial.m_isPortOpen)
+    {
+        LOG_ERROR("Receiving mode cannot be changed while the device is connected.");
+        return TH_ERROR_DEVICE_ALREADY_OPEN;
+    }
+
+    pInternal->m_useSharedReceiver = (enable != 0);
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_EnableInlineCallbacks(trackHat_Device_t* device, uint8_t enable)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+
+    if (pInternal->m_serial.m_isPortOpen)
+    {
+        LOG_ERROR("Callback mode cannot be changed while the device is connected.");
+        return TH_ERROR_DEVICE_ALREADY_OPEN;
+    }
+
+    pInternal->m_useInlineCallbacks = (enable != 0);
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_EnableRegisterCache(trackHat_Device_t* device, uint8_t enable)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    pInternal->m_registerShadow.enable(enable != 0);
+
+    if ((enable != 0) && !pInternal->m_registerShadow.isEnabled())
+        return TH_MEMORY_ALLOCATION_FAILED;
+
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_InvalidateRegisterCache(trackHat_Device_t* device)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    pInternal->m_registerShadow.invalidate();
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_GetStatistics(trackHat_Device_t* device, trackHat_Statistics_t* statistics)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (statistics == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    pInternal->m_messages.m_statistics.load(*statistics);
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_ResetStatistics(trackHat_Device_t* device)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    pInternal->m_messages.m_statistics.reset();
+    return TH_SUCCESS;
+}
+
+/* Move the queued sets of points to 'points', common part of the batch functions */
+template<typename Points, typename Coordinates>
+static TH_ErrorCode trackHat_GetQueuedPoints(trackHat_Device_t* device, Coordinates trackHat_Messages_t::* message,
+                                             Points* points, uint32_t maxCount, uint32_t* count)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (points == nullptr) || (count == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    Coordinates& coordinates = pInternal->m_messages.*message;
+
+    *count = 0;
+
+    if (coordinates.m_queue.capacity() == 0)
+    {
+        LOG_ERROR("Frame queue is not enabled.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    *count = static_cast<uint32_t>(coordinates.m_queue.pop(points, maxCount));
+
+    // Points received before the device was unplugged are returned first
+    if ((*count == 0) && pInternal->m_isUnplugged)
+    {
+        return TH_ERROR_DEVICE_DISCONNECTED;
+    }
+
+    return TH_SUCCESS;
+}
+
+TH_ErrorCode trackHat_GetDetectedPointsBatch(trackHat_Device_t* device, trackHat_Points_t* points,
+                                             uint32_t maxCount, uint32_t* count)
+{
+    return trackHat_GetQueuedPoints(device, &trackHat_Messages_t::m_coordinates, points, maxCount, count);
+}
+
+TH_ErrorCode trackHat_GetDetectedPointsExtendedBatch(trackHat_Device_t* device, trackHat_ExtendedPoints_t* points,
+                                                     uint32_t maxCount, uint32_t* count)
+{
+    return trackHat_GetQueuedPoints(device, &trackHat_Messages_t::m_extendedCoordinates, points, maxCount, count);
+}
+
+TH_ErrorCode trackHat_GetFrameQueueStatus(trackHat_Device_t* device, trackHat_FrameQueueStatus_t* status)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (status == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    MessageCoordinates& coordinates = pInternal->m_messages.m_coordinates;
+    MessageExtendedCoordinates& extendedCoordinates = pInternal->m_messages.m_extendedCoordinates;
+
+    status->m_depth = static_cast<uint32_t>(coordinates.m_queue.capacity());
+    status->m_pendingPoints = static_cast<uint32_t>(coordinates.m_queue.size());
+    status->m_pendingExtendedPoints = static_cast<uint32_t>(extendedCoordinates.m_queue.size());
+    status->m_droppedPoints = coordinates.m_queue.overflowCount();
+    status->m_droppedExtendedPoints = extendedCoordinates.m_queue.overflowCount();
+
+    return TH_SUCCESS;
+}
+
+/* Result of a transaction waiting longer than 'RESPONSE_TIMEOUT_MS' becomes a timeout */
+static void trackHat_ExpireTransaction(trackHat_Internal_t* pInternal, uint8_t transactionID, uint64_t timestampUs)
+{
+    Sync::CompletionTable& transactions = pInternal->m_messages.m_transactions;
+
+    if (transactions.isPending(transactionID) && (timestampUs >= pInternal->m_transactionDeadlineUs[transactionID]))
+    {
+        if (transactions.complete(transactionID, TRANSACTION_TIMEOUT))
+            pInternal->m_messages.m_statistics.m_commandTimeouts.addConcurrent();
+    }
+}
+
+/**
+ * Send a command answered with ACK or NACK without waiting for the response.
+ *
+ * At most 'MAX_TRANSACTIONS_IN_FLIGHT' commands wait for the response, the next one waits
+ * until any of them is answered or times out. The registers written by the command are
+ * passed to the register cache, which removes the ones with known values before the message
+ * is created. A command left without registers is completed with ACK without sending.
+ */
+template<typename CreateMessage>
+static TH_ErrorCode trackHat_SendCommand(trackHat_Device_t* device, uint8_t* transactionID, CreateMessage createMessage,
+                                         trackHat_SetRegister_t* registers = nullptr, size_t* registerCount = nullptr)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (transactionID == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    Sync::CompletionTable& transactions = pInternal->m_messages.m_transactions;
 
     if (pInternal->m_isUnplugged)
     {
         return TH_ERROR_DEVICE_DISCONNECTED;
     }
 
-    uint8_t transactionID = 0;
+    std::lock_guard<std::mutex> lock(pInternal->m_commandMutex);
+    Registers::Shadow& registerShadow = pInternal->m_registerShadow;
+
+    size_t sentRegisterCount = (registerCount != nullptr) ? *registerCount : 0;
+    if (sentRegisterCount > 0)
+    {
+        sentRegisterCount = registerShadow.removeClean(registers, sentRegisterCount);
+        *registerCount = sentRegisterCount;
+
+        if (sentRegisterCount == 0)
+        {
+            const uint8_t newTransactionID = pInternal->m_transactionID++;
+            pInternal->m_transactionDeadlineUs[newTransactionID] = trackHat_GetTimestampUs();
+            registerShadow.send(newTransactionID, nullptr, 0);
+            transactions.start(newTransactionID);
+            transactions.complete(newTransactionID, TRANSACTION_ACK);
+
+            *transactionID = newTransactionID;
+            return TH_SUCCESS;
+        }
+    }
+
+    while (!transactions.waitForPendingBelow(MAX_TRANSACTIONS_IN_FLIGHT, RESPONSE_TIMEOUT_MS / 10))
+    {
+        const uint64_t timestampUs = trackHat_GetTimestampUs();
+        for (size_t i = 0; i < Sync::CompletionTable::Size; i++)
+            trackHat_ExpireTransaction(pInternal, static_cast<uint8_t>(i), timestampUs);
+    }
+
+    const uint8_t newTransactionID = pInternal->m_transactionID++;
     uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE] = {};
-    size_t  txMessageSize = Parser::createMessageSetRegisterGroup(txMessage, MESSAGE_TX_BUFFER_SIZE, newRegisterGroupValue, &transactionID);
-    TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
+    size_t  txMessageSize = createMessage(txMessage, newTransactionID);
+    if (txMessageSize == 0)
+    {
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    const uint64_t sendTimestampUs = trackHat_GetTimestampUs();
+    pInternal->m_transactionDeadlineUs[newTransactionID] = sendTimestampUs + RESPONSE_TIMEOUT_MS * 1000;
+    pInternal->m_messages.m_statistics.commandSent(newTransactionID, sendTimestampUs);
+    registerShadow.send(newTransactionID, registers, sentRegisterCount);
+    transactions.start(newTransactionID);
+
+    TH_ErrorCode result = UsbSerial::write(pInternal->m_serial, txMessage, txMessageSize);
     if (result != TH_SUCCESS)
     {
+        transactions.cancel(newTransactionID);
+        registerShadow.complete(newTransactionID, false);
         return result;
     }
 
-    result = trackHat_WaitForResponse(pInternal, transactionID);
-    return result;
+    *transactionID = newTransactionID;
+    return TH_SUCCESS;
 }
 
-TH_ErrorCode trackHat_EnableBootloader(trackHat_Device_t* device, TH_BootloaderMode bootloaderMode)
+TH_ErrorCode trackHat_GetTransactionResult(trackHat_Device_t* device, uint8_t transactionID, uint32_t timeoutMs)
 {
-    if ((device==nullptr) || (device->m_pInternal == nullptr))
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
         return TH_ERROR_WRONG_PARAMETER;
 
-    trackHat_Internal_t* internal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
-    usbSerial_t& serial = internal->m_serial;
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    Sync::CompletionTable& transactions = pInternal->m_messages.m_transactions;
 
-    if (internal->m_isUnplugged)
+    if (transactions.isIdle(transactionID))
     {
-        return TH_ERROR_DEVICE_DISCONNECTED;
+        LOG_ERROR("Transaction " << static_cast<int>(transactionID) << " is not known.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
+    // Do not wait after the deadline of the transaction
+    const uint64_t timestampUs = trackHat_GetTimestampUs();
+    const uint64_t deadlineUs = pInternal->m_transactionDeadlineUs[transactionID];
+    const uint64_t deadlineMs = (deadlineUs > timestampUs) ? (deadlineUs - timestampUs + 999) / 1000 : 0;
+    if (timeoutMs > deadlineMs)
+        timeoutMs = static_cast<uint32_t>(deadlineMs);
+
+    // Woken up by the receiver as soon as the ACK or NACK is parsed
+    uint16_t response = 0;
+    if (!transactions.wait(transactionID, timeoutMs, response))
+    {
+        trackHat_ExpireTransaction(pInternal, transactionID, trackHat_GetTimestampUs());
+        if (!transactions.poll(transactionID, response))
+            return TH_TRANSACTION_PENDING;
+    }
+
+    pInternal->m_registerShadow.complete(transactionID, response == TRANSACTION_ACK);
+
+    if (response == TRANSACTION_ACK)
+        return TH_SUCCESS;
+    else if (response == TRANSACTION_TIMEOUT)
+        return TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT;
+    else
+        return TH_FAILED_TO_SET_REGISTER;
+}
+
+TH_ErrorCode trackHat_SetRegisterValueAsync(trackHat_Device_t* device, trackHat_SetRegister_t* newRegisterValue, uint8_t* transactionID)
+{
+    if (newRegisterValue == nullptr)
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_SetRegister_t registerValue = *newRegisterValue;
+    size_t registerCount = 1;
+
+    return trackHat_SendCommand(device, transactionID, [&registerValue](uint8_t* txMessage, uint8_t newTransactionID)
+    {
+        return Parser::createMessageSetRegister(txMessage, MESSAGE_TX_BUFFER_SIZE, newTransactionID, &registerValue);
+    }, &registerValue, &registerCount);
+}
+
+TH_ErrorCode trackHat_SetRegisterGroupValueAsync(trackHat_Device_t* device, trackHat_SetRegisterGroup_t* newRegisterGroupValue, uint8_t* transactionID)
+{
+    if ((newRegisterGroupValue == nullptr) || (newRegisterGroupValue->numberOfRegisters > MAX_NUMBER_OF_REGISTERS))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    // Only the registers changed by the group are sent
+    trackHat_SetRegisterGroup_t registerGroup = *newRegisterGroupValue;
+
+    return trackHat_SendCommand(device, transactionID, [&registerGroup](uint8_t* txMessage, uint8_t newTransactionID)
+    {
+        return Parser::createMessageSetRegisterGroup(txMessage, MESSAGE_TX_BUFFER_SIZE, newTransactionID, &registerGroup);
+    }, registerGroup.setRegisterGroupValue, &registerGroup.numberOfRegisters);
+}
+
+TH_ErrorCode trackHat_SetLedsAsync(trackHat_Device_t* device, trackHat_SetLeds_t* newLedState, uint8_t* transactionID)
+{
+    if (newLedState == nullptr)
+        return TH_ERROR_WRONG_PARAMETER;
+
+    return trackHat_SendCommand(device, transactionID, [newLedState](uint8_t* txMessage, uint8_t newTransactionID)
+    {
+        return Parser::createMessageSetLeds(txMessage, newTransactionID, newLedState);
+    });
+}
+
+TH_ErrorCode trackHat_SetRegisterValue(trackHat_Device_t* device, trackHat_SetRegister_t* newRegisterValue)
+{
+    uint8_t transactionID = 0;
+    TH_ErrorCode result = trackHat_SetRegisterValueAsync(device, newRegisterValue, &transactionID);
+    if (result != TH_SUCCESS)
+    {
+        return result;
     }
 
+    return trackHat_GetTransactionResult(device, transactionID, RESPONSE_TIMEOUT_MS);
+}
+
+TH_ErrorCode trackHat_SetRegisterGroupValue(trackHat_Device_t* device, trackHat_SetRegisterGroup_t* newRegisterGroupValue)
+{
     uint8_t transactionID = 0;
-    uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE] = {};
-    size_t  txMessageSize = Parser::createMessageEnableBootloader(txMessage, MESSAGE_TX_BUFFER_SIZE, bootloaderMode, &transactionID);
-    TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
+    TH_ErrorCode result = trackHat_SetRegisterGroupValueAsync(device, newRegisterGroupValue, &transactionID);
     if (result != TH_SUCCESS)
     {
         return result;
     }
 
-    result = trackHat_WaitForResponse(internal, transactionID);
-    return result;
+    return trackHat_GetTransactionResult(device, transactionID, RESPONSE_TIMEOUT_MS);
 }
 
-TH_ErrorCode trackHat_SetLeds(trackHat_Device_t* device, trackHat_SetLeds_t* newLedState)
+TH_ErrorCode trackHat_SetRegisters(trackHat_Device_t* device, const trackHat_SetRegister_t* registers, uint32_t count,
+                                   TH_ErrorCode* chunkResults)
 {
-    if ((device==nullptr) || (device->m_pInternal == nullptr))
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || ((registers == nullptr) && (count > 0)))
         return TH_ERROR_WRONG_PARAMETER;
 
-    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
-    usbSerial_t& serial = pInternal->m_serial;
+    TH_ErrorCode result = TH_SUCCESS;
 
-    if (pInternal->m_isUnplugged)
+    // The register cache removes the known values of each group when it is sent, so the
+    // results stay the results of the groups of the caller
+    const size_t chunkCount = (count + MAX_NUMBER_OF_REGISTERS - 1) / MAX_NUMBER_OF_REGISTERS;
+
+    // Store the result of the chunk, the first error is returned
+    auto setChunkResult = [&result, chunkResults](size_t chunk, TH_ErrorCode chunkResult)
     {
-        return TH_ERROR_DEVICE_DISCONNECTED;
+        if (chunkResults != nullptr)
+            chunkResults[chunk] = chunkResult;
+        if (result == TH_SUCCESS)
+            result = chunkResult;
+    };
+
+    // Chunks waiting for the response (index and transaction ID), the oldest first. The results
+    // are taken before the window is full, so the transaction IDs are never reused too early.
+    std::deque<std::pair<size_t, uint8_t>> pendingChunks;
+    auto takeOldestResult = [&]()
+    {
+        setChunkResult(pendingChunks.front().first,
+                       trackHat_GetTransactionResult(device, pendingChunks.front().second, RESPONSE_TIMEOUT_MS));
+        pendingChunks.pop_front();
+    };
+
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        if (pendingChunks.size() == MAX_TRANSACTIONS_IN_FLIGHT)
+            takeOldestResult();
+
+        const size_t firstRegister = chunk * MAX_NUMBER_OF_REGISTERS;
+        const size_t registerCount = std::min(MAX_NUMBER_OF_REGISTERS, count - firstRegister);
+
+        trackHat_SetRegisterGroup_t registerGroup;
+        std::copy(registers + firstRegister, registers + firstRegister + registerCount, registerGroup.setRegisterGroupValue);
+        registerGroup.numberOfRegisters = registerCount;
+
+        uint8_t transactionID = 0;
+        TH_ErrorCode sendResult = trackHat_SetRegisterGroupValueAsync(device, &registerGroup, &transactionID);
+        if (sendResult == TH_SUCCESS)
+            pendingChunks.emplace_back(chunk, transactionID);
+        else
+            setChunkResult(chunk, sendResult);
     }
 
+    while (!pendingChunks.empty())
+        takeOldestResult();
+
+    return result;
+}
+
+TH_ErrorCode trackHat_EnableBootloader(trackHat_Device_t* device, TH_BootloaderMode bootloaderMode)
+{
     uint8_t transactionID = 0;
-    uint8_t txMessage[MESSAGE_TX_BUFFER_SIZE] = {};
-    size_t  txMessageSize = Parser::createMessageSetLeds(txMessage, newLedState, &transactionID);
-    TH_ErrorCode result = UsbSerial::write(serial, txMessage, txMessageSize);
+    TH_ErrorCode result = trackHat_SendCommand(device, &transactionID, [bootloaderMode](uint8_t* txMessage, uint8_t newTransactionID)
+    {
+        return Parser::createMessageEnableBootloader(txMessage, MESSAGE_TX_BUFFER_SIZE, newTransactionID, bootloaderMode);
+    });
     if (result != TH_SUCCESS)
     {
         return result;
     }
 
-    result = trackHat_WaitForResponse(pInternal, transactionID);
+    result = trackHat_GetTransactionResult(device, transactionID, RESPONSE_TIMEOUT_MS);
+
+    // The camera is reset, even a lost response may mean the registers have the default values
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+    pInternal->m_registerShadow.invalidate();
+
     return result;
 }
 
+TH_ErrorCode trackHat_SetLeds(trackHat_Device_t* device, trackHat_SetLeds_t* newLedState)
+{
+    uint8_t transactionID = 0;
+    TH_ErrorCode result = trackHat_SetLedsAsync(device, newLedState, &transactionID);
+    if (result != TH_SUCCESS)
+    {
+        return result;
+    }
+
+    return trackHat_GetTransactionResult(device, transactionID, RESPONSE_TIMEOUT_MS);
+}
+
+TH_ErrorCode trackHat_StartRecording(trackHat_Device_t* device, const char* fileName)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr) || (fileName == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+
+    LOG_INFO("Start recording to " << fileName << ".");
+
+    return pInternal->m_recorder.start(fileName, device->m_serialNumber);
+}
+
+TH_ErrorCode trackHat_StopRecording(trackHat_Device_t* device)
+{
+    if ((device == nullptr) || (device->m_pInternal == nullptr))
+        return TH_ERROR_WRONG_PARAMETER;
+
+    trackHat_Internal_t* pInternal = reinterpret_cast<trackHat_Internal_t*>(device->m_pInternal);
+
+    LOG_INFO("Stop recording.");
+
+    pInternal->m_recorder.stop();
+    return TH_SUCCESS;
+}
+
 void trackHat_SetDebugHandler(TH_LogHandler_t fn)
 {
     return logger_SetHandler(fn);
 }
 
-void setRegisterGroupValue(uint8_t registerBank, uint8_t registerAdress, uint8_t registerValue, trackHat_SetRegisterGroup_t& setRegisterGroup)
+uint64_t trackHat_GetTimestampUs(void)
 {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+TH_ErrorCode setRegisterGroupValue(uint8_t registerBank, uint8_t registerAdress, uint8_t registerValue, trackHat_SetRegisterGroup_t& setRegisterGroup)
+{
+    if (setRegisterGroup.numberOfRegisters >= MAX_NUMBER_OF_REGISTERS)
+    {
+        LOG_ERROR("Register group is full, use 'trackHat_SetRegisters()' for more registers.");
+        return TH_ERROR_WRONG_PARAMETER;
+    }
+
     setRegisterGroup.setRegisterGroupValue[setRegisterGroup.numberOfRegisters] = {registerBank, registerAdress, registerValue};
     setRegisterGroup.numberOfRegisters++;
+    return TH_SUCCESS;
 }
@@ -9,8 +9,10 @@
 /* Macro EXPORT_CPP export symbol to DLL. */
 #if defined(_WIN32)
   #define EXPORT_API
+#elif defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+  #define EXPORT_API __attribute__((visibility("default")))
 #else
-  #error "Currently only Windows is supported."
+  #error "Currently only Windows and POSIX systems are supported."
 #endif
 
 /* Export symbol as in C language. */
@@ -31,7 +33,8 @@ EXPORT_API
 void trackHat_EnableDebugMode(void);
 
 /**
- * Disable the debugging mode of the library. 
+ * Disable the debugging mode of the library. The messages logged before are passed to the
+ * handler before the function returns.
  */
 EXPORT_API
 void trackHat_DisableDebugMode(void);
@@ -69,6 +72,74 @@ void trackHat_Deinitialize(trackHat_Device_t* device);
 EXPORT_API
 TH_ErrorCode trackHat_DetectDevice(trackHat_Device_t* device);
 
+/**
+ * List all TrackHat devices connected to USB ports.
+ *
+ * Every device can be selected with 'trackHat_DetectDeviceOnPort()' for its own
+ * 'trackHat_Device_t' and all of them can be connected at the same time. The devices are
+ * sorted by the port number. The serial number reported by the camera itself is available
+ * in 'trackHat_Device_t' after connection.
+ *
+ * \param[out] devices    Array for the found devices, can be nullptr if 'maxCount' is 0.
+ * \param[in]  maxCount   Size of the 'devices' array.
+ * \param[out] count      Number of all found devices, can be more than 'maxCount'.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_EnumerateDevices(trackHat_DetectedDevice_t* devices, uint32_t maxCount, uint32_t* count);
+
+/**
+ * Detect TrackHat device connected to the given USB port, like 'trackHat_DetectDevice()'.
+ *
+ * Note: 'device' parameter should be first initialized with 'trackHat_Initialize()'.
+ *
+ * \param[in]  device     pointer to trackHat_Device_t.
+ * \param[in]  portName   'm_portName' from 'trackHat_EnumerateDevices()', the short name
+ *                        (e.g. "ttyACM1" or "COM3") is accepted too.
+ *
+ * \return     TH_SUCCESS if detected or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_DetectDeviceOnPort(trackHat_Device_t* device, const char* portName);
+
+/**
+ * Use the simulated TrackHat device instead of the one connected to USB port.
+ *
+ * The simulated device sends the points with the configured rate, jitter and corruption
+ * and responds to the commands, so the library can be tested without the camera.
+ * 'trackHat_DetectDevice()' switches back to the real device.
+ *
+ * Note: 'device' parameter should be first initialized with 'trackHat_Initialize()'.
+ *
+ * \param[in]  device   pointer to trackHat_Device_t.
+ * \param[in]  config   Configuration of the simulated device or nullptr for the default one
+ *                      (100 sets of points per second, no errors).
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_DetectMockDevice(trackHat_Device_t* device, const trackHat_MockConfig_t* config);
+
+/**
+ * Use the data of a capture file instead of the device connected to USB port.
+ *
+ * The file is created with 'trackHat_StartRecording()'. After connection the recorded data
+ * is passed to the library as if it was received from the device. When the whole file is
+ * replayed the device is reported as disconnected.
+ *
+ * Note: 'device' parameter should be first initialized with 'trackHat_Initialize()'.
+ *
+ * \param[in]  device     pointer to trackHat_Device_t.
+ * \param[in]  fileName   Name of the capture file.
+ * \param[in]  speed      Multiplier of the recorded speed (1.0 for real time) or 0 to replay
+ *                        the data as fast as it is parsed.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_DetectReplayDevice(trackHat_Device_t* device, const char* fileName, double speed);
+
 /**
  * Connect with TrackHat device.
  *
@@ -111,6 +182,198 @@ TH_ErrorCode trackHat_GetDetectedPoints(trackHat_Device_t* device, trackHat_Poin
 EXPORT_API
 TH_ErrorCode trackHat_GetDetectedPointsExtended(trackHat_Device_t* device, trackHat_ExtendedPoints_t* points);
 
+/**
+ * Get list of detected points as separate arrays of X, Y and brightness.
+ *
+ * The points are decoded from the frame with SIMD instructions (SSSE3 or AVX2 on x86, NEON
+ * on ARM64) when the CPU supports them.
+ *
+ * Note: This function waits for the next set of points as 'trackHat_GetDetectedPoints()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedPointsSoA(trackHat_Device_t* device, trackHat_PointsSoA_t* points);
+
+/**
+ * Get list of detected extended points as separate arrays of each field.
+ *
+ * Note: See 'trackHat_GetDetectedPointsSoA()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedPointsExtendedSoA(trackHat_Device_t* device, trackHat_ExtendedPointsSoA_t* points);
+
+/**
+ * Get only the detected points, without the empty slots, with their number and slot indexes.
+ *
+ * Note: This function waits for the next set of points as 'trackHat_GetDetectedPoints()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedCompactPoints(trackHat_Device_t* device, trackHat_CompactPoints_t* points);
+
+/**
+ * Get only the detected extended points, see 'trackHat_GetDetectedCompactPoints()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedCompactExtendedPoints(trackHat_Device_t* device, trackHat_CompactExtendedPoints_t* points);
+
+/**
+ * Get the extended points as received, without decoding any field.
+ *
+ * The fields are read with 'trackHat_RawPointArea()', 'trackHat_RawPointX()' and the other
+ * 'trackHat_RawPoint*()' functions, each one decoded only when it is read. The receiver does
+ * not decode the extended frames either, unless the frame queue, a subscriber or an inline
+ * callback needs them.
+ *
+ * Note: This function waits for the next set of points as 'trackHat_GetDetectedPoints()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedPointsExtendedRaw(trackHat_Device_t* device, trackHat_ExtendedPointsRaw_t* points);
+
+/**
+ * Enable queues that keep every received set of points for 'trackHat_GetDetectedPointsBatch()'
+ * and 'trackHat_GetDetectedPointsExtendedBatch()'.
+ *
+ * Without the queues only the latest set of points is kept. When a queue is full the new sets
+ * of points are dropped and counted in 'trackHat_GetFrameQueueStatus()'.
+ *
+ * Note: The device must not be connected.
+ *
+ * \param[in]  device   pointer to trackHat_Device_t.
+ * \param[in]  depth    Number of sets of points in each queue (rounded up to a power of two),
+ *                      '0' disables the queues.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_EnableFrameQueue(trackHat_Device_t* device, uint32_t depth);
+
+/**
+ * Receive the data of the device on a single thread shared by all devices with this option.
+ *
+ * By default every connected device uses two threads, one for receiving the data and one for
+ * the callbacks. With the shared receiver the data of all devices is waited for at once
+ * (epoll on Linux, overlapped I/O on Windows) and the callbacks of all devices are called
+ * from that thread. The callbacks must not block and must not connect or disconnect any
+ * device: while a callback runs no device is received, so one slow callback delays the
+ * points of all cameras and can overflow their buffers. Slow consumers should use
+ * 'trackHat_Subscribe()', the subscribers keep their own threads. Simulated devices always
+ * use their own threads.
+ *
+ * Note: The device must not be connected.
+ *
+ * \param[in]  device   pointer to trackHat_Device_t.
+ * \param[in]  enable   '1' to use the shared thread, '0' to use own threads (default).
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_EnableSharedReceiver(trackHat_Device_t* device, uint8_t enable);
+
+/**
+ * Call the points callbacks directly on the thread receiving the data.
+ *
+ * By default the receiver wakes up the callback thread, which copies the points and calls the
+ * callback. With this option the callback is called right after the frame is parsed with
+ * a pointer to the decoded points, which removes the thread switch from every frame. The
+ * callback thread only reports the errors. The receiving is delayed until the callback
+ * returns, so it should be short and must not call the functions waiting for the device
+ * (e.g. 'trackHat_SetRegisterValue()' or 'trackHat_Disconnect()'). The pointer is valid only
+ * during the call.
+ *
+ * Note: The device must not be connected.
+ *
+ * \param[in]  device   pointer to trackHat_Device_t.
+ * \param[in]  enable   '1' to call the callbacks on the receiver, '0' to use the callback thread (default).
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_EnableInlineCallbacks(trackHat_Device_t* device, uint8_t enable);
+
+/**
+ * Skip the register writes that do not change the values.
+ *
+ * The driver remembers the value of every register acknowledged by the camera. Registers
+ * written again with the same value are removed from 'trackHat_SetRegisterValue()',
+ * 'trackHat_SetRegisterGroupValue()', 'trackHat_SetRegisters()' and their asynchronous
+ * versions, a command without changed registers succeeds without sending. Registers not
+ * acknowledged yet, rejected or timed out are always written. The values are forgotten on
+ * 'trackHat_Connect()' and 'trackHat_EnableBootloader()'.
+ *
+ * Note: Registers that must be written every time (e.g. the one applying the changes of a bank)
+ *       should not be used with the cache or 'trackHat_InvalidateRegisterCache()' should be
+ *       called before writing them.
+ *
+ * \param[in]  device   pointer to trackHat_Device_t.
+ * \param[in]  enable   '1' to use the cache, '0' to write all registers (default).
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_EnableRegisterCache(trackHat_Device_t* device, uint8_t enable);
+
+/**
+ * Forget the register values remembered by 'trackHat_EnableRegisterCache()', e.g. when the
+ * camera could be changed by another application.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_InvalidateRegisterCache(trackHat_Device_t* device);
+
+/**
+ * Get the counters of the communication with the device, e.g. to check the quality of the link.
+ *
+ * The counters are always updated and are kept when the device is disconnected and connected
+ * again. They are read one by one, so the values may differ by the data received meanwhile.
+ *
+ * \param[in]  device       pointer to trackHat_Device_t.
+ * \param[out] statistics   Counters since 'trackHat_Initialize()' or 'trackHat_ResetStatistics()'.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetStatistics(trackHat_Device_t* device, trackHat_Statistics_t* statistics);
+
+/**
+ * Set all counters of 'trackHat_GetStatistics()' to zero.
+ *
+ * Note: The counters are not locked, a counter updated at the same moment by the receiving
+ *       thread may keep its previous value. Reset the statistics of a disconnected device to
+ *       get exact values.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_ResetStatistics(trackHat_Device_t* device);
+
+/**
+ * Get all sets of points received since the previous call, oldest first.
+ *
+ * Note: This function does not wait, 'count' is 0 if there are no new points. Only one
+ * thread may call it at a time.
+ *
+ * \param[in]  device     pointer to trackHat_Device_t.
+ * \param[out] points     Array for the sets of points.
+ * \param[in]  maxCount   Size of the 'points' array.
+ * \param[out] count      Number of sets of points stored in 'points'.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedPointsBatch(trackHat_Device_t* device, trackHat_Points_t* points,
+                                             uint32_t maxCount, uint32_t* count);
+
+/**
+ * Get all sets of extended points received since the previous call, oldest first.
+ *
+ * Note: See 'trackHat_GetDetectedPointsBatch()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetDetectedPointsExtendedBatch(trackHat_Device_t* device, trackHat_ExtendedPoints_t* points,
+                                                     uint32_t maxCount, uint32_t* count);
+
+/**
+ * Get the number of waiting and dropped sets of points in the frame queues.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetFrameQueueStatus(trackHat_Device_t* device, trackHat_FrameQueueStatus_t* status);
+
 
 /**
  * Set callback that will be executed automatically when new set of points are received.
@@ -125,6 +388,64 @@ EXPORT_API
 TH_ErrorCode trackHat_SetExtendedPointsCallback(trackHat_Device_t* device, trackHat_ExtendedPointsCallback_t newExtendedPointsCallback);
 
 
+/**
+ * Set callback that will be executed with only the detected points when new set of points
+ * is received, see 'trackHat_GetDetectedCompactPoints()'. It may be set together with the
+ * callback of 'trackHat_SetCallback()', nullptr removes it.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SetCompactPointsCallback(trackHat_Device_t* device, trackHat_CompactPointsCallback_t newCompactPointsCallback);
+
+/**
+ * Set callback that will be executed with only the detected extended points, see
+ * 'trackHat_SetCompactPointsCallback()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SetCompactExtendedPointsCallback(trackHat_Device_t* device,
+                                                       trackHat_CompactExtendedPointsCallback_t newCompactExtendedPointsCallback);
+
+/**
+ * Add a subscriber of the sets of points, called on its own thread with the given 'context'.
+ *
+ * Unlike 'trackHat_SetCallback()' any number of subscribers (up to TRACK_HAT_MAX_SUBSCRIPTIONS
+ * per device) may receive the points, each one with its own delivery policy and queue depth.
+ * Every set of points is decoded and stored once, the subscribers copy it at their own pace,
+ * so a slow subscriber delays neither the receiving nor the other subscribers. The sets of
+ * points dropped for a subscriber are visible as gaps in 'm_frameNumber'.
+ *
+ * The subscriber gets the points of the basic frames. When the device is connected with this
+ * frame type and no points arrive, it is called with the error and nullptr at most every
+ * 2 seconds. Subscriptions are kept when the device is disconnected and connected again.
+ *
+ * \param[in]  device           pointer to trackHat_Device_t.
+ * \param[in]  config           Delivery policy and queue depth.
+ * \param[in]  subscriber       Function called with the points, the pointer is valid only during the call.
+ * \param[in]  context          Passed to every call of 'subscriber'.
+ * \param[out] subscriptionID   ID for 'trackHat_Unsubscribe()'.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_Subscribe(trackHat_Device_t* device, const trackHat_SubscriptionConfig_t* config,
+                                trackHat_PointsSubscriber_t subscriber, void* context, uint32_t* subscriptionID);
+
+/**
+ * Add a subscriber of the sets of extended points.
+ *
+ * Note: See 'trackHat_Subscribe()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SubscribeExtended(trackHat_Device_t* device, const trackHat_SubscriptionConfig_t* config,
+                                        trackHat_ExtendedPointsSubscriber_t subscriber, void* context, uint32_t* subscriptionID);
+
+/**
+ * Remove the subscriber, it is not called after this function returns.
+ *
+ * Note: Must not be called from the subscriber itself.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_Unsubscribe(trackHat_Device_t* device, uint32_t subscriptionID);
+
 /**
  * Remove previously added callback.
  */
@@ -149,16 +470,129 @@ TH_ErrorCode trackHat_SetLeds(trackHat_Device_t* device, trackHat_SetLeds_t* new
 EXPORT_API
 TH_ErrorCode trackHat_SetRegisterGroupValue(trackHat_Device_t* device, trackHat_SetRegisterGroup_t* newRegisterGroupValue);
 
+/**
+ * Set a single register value without waiting for the response.
+ *
+ * The commands are sent one after another without waiting for the round trip, up to 16 of them
+ * wait for the response at the same time. If the limit is reached, the function waits for
+ * the response to any of the previous commands. The result is returned by
+ * 'trackHat_GetTransactionResult()' and is kept until the transaction ID is used again
+ * (256 commands later).
+ *
+ * \param[in]  device            pointer to trackHat_Device_t.
+ * \param[in]  newRegisterValue  Register to set.
+ * \param[out] transactionID     ID of the command for 'trackHat_GetTransactionResult()'.
+ *
+ * \return     TH_SUCCESS if the command was sent or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SetRegisterValueAsync(trackHat_Device_t* device, trackHat_SetRegister_t* newRegisterValue, uint8_t* transactionID);
+
+/**
+ * Set a group of register values without waiting for the response, see 'trackHat_SetRegisterValueAsync()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SetRegisterGroupValueAsync(trackHat_Device_t* device, trackHat_SetRegisterGroup_t* newRegisterGroupValue, uint8_t* transactionID);
+
+/**
+ * Set any number of registers, e.g. a complete sensor configuration.
+ *
+ * The registers are split into groups of 'MAX_NUMBER_OF_REGISTERS' sent as in
+ * 'trackHat_SetRegisterGroupValueAsync()', so the next groups are sent before the previous
+ * ones are acknowledged. The function returns when all groups are answered.
+ *
+ * \param[in]  device         pointer to trackHat_Device_t.
+ * \param[in]  registers      Registers to set, in the order of sending.
+ * \param[in]  count          Number of registers.
+ * \param[out] chunkResults   Result of each group (optional, can be nullptr). The size of the
+ *                            array is 'count' divided by 'MAX_NUMBER_OF_REGISTERS' rounded up,
+ *                            the result 'k' is of the registers from 'k * MAX_NUMBER_OF_REGISTERS'.
+ *                            With 'trackHat_EnableRegisterCache()' only the changed registers of
+ *                            each group are sent, a group without them succeeds without sending.
+ *
+ * \return     TH_SUCCESS if all groups were accepted or the first error.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SetRegisters(trackHat_Device_t* device, const trackHat_SetRegister_t* registers, uint32_t count,
+                                   TH_ErrorCode* chunkResults);
+
+/**
+ * Set all LEDs status without waiting for the response, see 'trackHat_SetRegisterValueAsync()'.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_SetLedsAsync(trackHat_Device_t* device, trackHat_SetLeds_t* newLedState, uint8_t* transactionID);
+
+/**
+ * Get the result of a command sent by one of the '...Async()' functions.
+ *
+ * The result is taken only once. A command without the response for 100 ms since sending
+ * fails with TH_ERROR_DEVICE_COMMUNICATION_TIMEOUT.
+ *
+ * \param[in]  device          pointer to trackHat_Device_t.
+ * \param[in]  transactionID   ID returned when the command was sent.
+ * \param[in]  timeoutMs       Maximum waiting time, '0' only checks the result.
+ *
+ * \return     TH_SUCCESS if the command was accepted (ACK), TH_FAILED_TO_SET_REGISTER if
+ *             rejected (NACK), TH_TRANSACTION_PENDING if the response may still arrive or
+ *             error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_GetTransactionResult(trackHat_Device_t* device, uint8_t transactionID, uint32_t timeoutMs);
+
 /**
  * Enable bootloader for firmware upgrade
  */
 EXPORT_API
 TH_ErrorCode trackHat_EnableBootloader(trackHat_Device_t* device, TH_BootloaderMode bootloaderMode);
 
+/**
+ * Set the function receiving the debug messages.
+ *
+ * The messages are formatted and passed to the handler on a separate thread every 10 ms, so
+ * the logging threads are not delayed by the handler. Each thread keeps up to 256 messages
+ * waiting, the messages over that limit are dropped and reported with an extra message.
+ */
 EXPORT_API
 void trackHat_SetDebugHandler(TH_LogHandler_t fn);
 
-void setRegisterGroupValue(uint8_t registerBank, uint8_t registerAdress, uint8_t registerValue, trackHat_SetRegisterGroup_t& setRegisterGroup);
+/**
+ * Start writing all data received from the device to the capture file.
+ *
+ * The recording can be started before or after connection. It can be replayed with
+ * 'trackHat_DetectReplayDevice()'.
+ *
+ * \param[in]  device     pointer to trackHat_Device_t.
+ * \param[in]  fileName   Name of the capture file, an existing file is replaced.
+ *
+ * \return     TH_SUCCESS or error code.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_StartRecording(trackHat_Device_t* device, const char* fileName);
+
+/**
+ * Stop writing the received data to the capture file and close it.
+ */
+EXPORT_API
+TH_ErrorCode trackHat_StopRecording(trackHat_Device_t* device);
+
+/**
+ * Get current time of the monotonic clock used for 'm_timestampUs' of the points.
+ *
+ * The timestamp of the points is taken right after the last byte of the frame is read from
+ * the USB port. Comparing it with this function gives the age of the frame.
+ *
+ * \return    Time in microseconds since an unspecified starting point.
+ */
+EXPORT_API
+uint64_t trackHat_GetTimestampUs(void);
+
+/**
+ * Add a register to the group for 'trackHat_SetRegisterGroupValue()'.
+ *
+ * \return     TH_SUCCESS or TH_ERROR_WRONG_PARAMETER if the group already has
+ *             'MAX_NUMBER_OF_REGISTERS' registers.
+ */
+TH_ErrorCode setRegisterGroupValue(uint8_t registerBank, uint8_t registerAdress, uint8_t registerValue, trackHat_SetRegisterGroup_t& setRegisterGroup);
 
 #ifdef __cplusplus
   } // extern "C"
@@ -8,15 +8,40 @@
 
 #include "track_hat_types_internal.h"
 
+#include "track_hat_parser.h"
 #include "usb_serial.h"
 
+#include <time.h>
+
 
 /* Function that runs on a separate thread for data received from the camera */
-DWORD WINAPI trackHat_ReceiverThreadFunction(LPVOID lpParameter);
+void trackHat_ReceiverThreadFunction(trackHat_Internal_t* pInternal);
 
 
 /* Function that runs on a separate thread for callback system */
-DWORD WINAPI trackHat_CallbackThreadFunction(LPVOID lpParameter);
+void trackHat_CallbackThreadFunction(trackHat_Internal_t* pInternal);
+
+
+/* Function that runs on a separate thread for each subscription */
+void trackHat_SubscriptionThreadFunction(trackHat_Internal_t* pInternal, trackHat_Subscription_t* subscription);
+
+/* Stop the delivery thread of the subscription, which becomes free */
+void trackHat_StopSubscription(trackHat_Subscription_t& subscription);
+
+
+/* Record and parse 'readSize' bytes received at 'dataBuffer.writePointer()' */
+void trackHat_HandleReceivedData(trackHat_Internal_t* pInternal, Parser::RxBuffer& dataBuffer, size_t readSize, uint64_t timestampUs);
+
+
+/* Install the callbacks called by the parser if 'm_useInlineCallbacks' is set, before receiving starts */
+void trackHat_SetupInlineCallbacks(trackHat_Internal_t* pInternal);
+
+/* Wait for the new points of the current frame type for the callback */
+bool trackHat_WaitForNewPoints(trackHat_Internal_t* pInternal, uint32_t timeoutMs);
+
+
+/* Run the callback of the current frame type with the new points or with the error (at most every 2 seconds) */
+void trackHat_RunCallbacks(trackHat_Internal_t* pInternal, bool isNewPoints, time_t& lastErrorTimeSec);
 
 
 /* Run callback function with provided parameters */
@@ -29,9 +54,19 @@ void trackHat_CallbackFunction(trackHat_ExtendedPointsCallback_t callbackFunctio
                                TH_ErrorCode errorCode,
                                const trackHat_ExtendedPoints_t* const points);
 
+/* Run callback function with provided parameters */
+void trackHat_CallbackFunction(trackHat_CompactPointsCallback_t callbackFunction,
+                               TH_ErrorCode errorCode,
+                               const trackHat_CompactPoints_t* const points);
+
+/* Run callback function with provided parameters */
+void trackHat_CallbackFunction(trackHat_CompactExtendedPointsCallback_t callbackFunction,
+                               TH_ErrorCode errorCode,
+                               const trackHat_CompactExtendedPoints_t* const points);
+
 
 /* Handle the new message event */
-TH_ErrorCode trackHat_WaitForNewMessageEvent(HANDLE event, const char* eventName = nullptr);
+TH_ErrorCode trackHat_WaitForNewMessageEvent(Sync::Event& event, const char* eventName = nullptr);
 
 
 /* Update internal Status message */
@@ -6,9 +6,11 @@
 #ifndef _TRACK_HAT_MESSAGES_H_
 #define _TRACK_HAT_MESSAGES_H_
 
+#include "track_hat_sync.h"
 #include "track_hat_types.h"
 
-#include <windows.h>
+#include <cstring>
+#include <mutex>
 
 enum MessageID : uint8_t
 {
@@ -54,19 +56,12 @@ struct MessageProtect
 {
 protected:
     MessageProtect() :
-        m_newMessageEvent(CreateEvent(NULL, true, 0, NULL)),
-        m_mutex(CreateMutex(NULL, false, NULL))
+        m_newMessageEvent(true)
     { }
 
-    ~MessageProtect()
-    { 
-        CloseHandle(m_newMessageEvent);
-        CloseHandle(m_mutex);
-    }
-
 public:
-    HANDLE m_newMessageEvent;
-    HANDLE m_mutex;
+    Sync::Event m_newMessageEvent;
+    std::mutex  m_mutex;
 };
 
 /* Thread safe protection for Messages */
@@ -95,49 +90,66 @@ struct MessageDeviceInfo : public MessageBase, public MessageProtect
     uint32_t m_serialNumber= 0;
 };
 
-struct MessageCoordinates : public MessageProtect
+/* Payload of the latest coordinates frame, decoded on demand by 'Decode' */
+template<size_t PayloadSize>
+struct RawPoints
+{
+    uint8_t  m_payload[PayloadSize];
+    uint64_t m_timestampUs;
+    uint32_t m_frameNumber;
+};
+
+/* Latest coordinates, written by the receiver without blocking (see 'Sync::SeqLock') */
+struct MessageCoordinates
 {
     MessageCoordinates() :
-        m_points(),
-        m_newCallbackEvent(CreateEvent(NULL, false, 0, NULL))
-    {
-        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
-        {
-            ::memset(&m_points.m_point[i], 0, sizeof(m_points.m_point[i]));
-        }
-    }
-
-    ~MessageCoordinates()
-    {
-        CloseHandle(m_newCallbackEvent);
-    }
+        m_newMessageEvent(true),
+        m_newCallbackEvent(false)
+    { }
 
     static const size_t FrameSize = 83;
 
-    trackHat_Points_t m_points;
-    HANDLE m_newCallbackEvent;
+    Sync::SeqLock<trackHat_Points_t> m_points;
+    Sync::SeqLock<RawPoints<FrameSize - 3>> m_rawPoints;   // Same frame without the ID and CRC
+    Sync::SpscQueue<trackHat_Points_t> m_queue;   // Every frame, if enabled
+    Sync::BroadcastRing<trackHat_Points_t, TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH> m_subscriptionRing;   // Every frame for the subscribers
+    uint32_t m_frameNumber = 0;   // Used only by the receiver
+    Sync::Event m_newMessageEvent;
+    Sync::Event m_newCallbackEvent;
+
+    // Called by the receiver instead of setting 'm_newCallbackEvent', set before the receiving starts
+    void (*m_inlineCallback)(void* context, const trackHat_Points_t* points) = nullptr;
+    void* m_inlineCallbackContext = nullptr;
 };
 
-struct MessageExtendedCoordinates : public MessageProtect
+/* Latest extended coordinates, written by the receiver without blocking (see 'Sync::SeqLock') */
+struct MessageExtendedCoordinates
 {
     MessageExtendedCoordinates():
-        m_points(),
-        m_newCallbackEvent(CreateEvent(NULL, false, 0, NULL))
-    { 
-        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
-        {
-            ::memset(&m_points.m_point[i], 0, sizeof(m_points.m_point[i]));
-        }
-    }
-
-    ~MessageExtendedCoordinates()
-    {
-        CloseHandle(m_newCallbackEvent);
-    }
+        m_newMessageEvent(true),
+        m_newCallbackEvent(false)
+    { }
+
     static const size_t FrameSize = 259;
 
-    trackHat_ExtendedPoints_t m_points;
-    HANDLE m_newCallbackEvent;
+    Sync::SeqLock<RawPoints<FrameSize - 3>> m_rawPoints;   // Same frame without the ID and CRC, decoded by the readers
+    Sync::SpscQueue<trackHat_ExtendedPoints_t> m_queue;   // Every frame, if enabled
+    Sync::BroadcastRing<trackHat_ExtendedPoints_t, TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH> m_subscriptionRing;   // Every frame for the subscribers
+    uint32_t m_frameNumber = 0;   // Used only by the receiver
+    Sync::Event m_newMessageEvent;
+    Sync::Event m_newCallbackEvent;
+
+    // Called by the receiver instead of setting 'm_newCallbackEvent', set before the receiving starts
+    void (*m_inlineCallback)(void* context, const trackHat_ExtendedPoints_t* points) = nullptr;
+    void* m_inlineCallbackContext = nullptr;
+};
+
+/* Result of the command in 'trackHat_Messages_t::m_transactions' */
+enum TransactionResult : uint16_t
+{
+    TRANSACTION_ACK     = 0x0000,
+    TRANSACTION_NACK    = 0x0100,   // ORed with 'NACKReason'
+    TRANSACTION_TIMEOUT = 0x0200,   // Set by the driver after 'RESPONSE_TIMEOUT_MS'
 };
 
 struct MessageACK : public MessageBase
@@ -6,53 +6,51 @@
 #include "track_hat_parser.h"
 #include "crc.h"
 #include "logger.h"
+#include "track_hat_decode.h"
 #include "track_hat_types_internal.h"
 
-#include <atomic>
+#include <cstring>
 #include <iostream>
-
-/* Transaction ID counter is one for all library */
-static std::atomic<uint8_t> transactionID(255);
+#include <mutex>
 
 namespace Parser
 {
 
-    size_t createMessageGetStatus(uint8_t* message)
+    size_t createMessageGetStatus(uint8_t* message, uint8_t transactionID)
     {
         size_t i = 0;
         message[i++] = MessageID::ID_GET_STATUS;
-        message[i++] = transactionID++;
+        message[i++] = transactionID;
         appednCRC(message, i);
         return i;
     }
 
-    size_t createMessageGetDeviceInfo(uint8_t* message)
+    size_t createMessageGetDeviceInfo(uint8_t* message, uint8_t transactionID)
     {
         size_t i = 0;
         message[i++] = MessageID::ID_GET_DEVICE_INFO;
-        message[i++] = transactionID++;
+        message[i++] = transactionID;
         appednCRC(message, i);
         return i;
     }
 
-    size_t createMessageSetMode(uint8_t* message, bool coordinates, TH_FrameType frameType)
+    size_t createMessageSetMode(uint8_t* message, uint8_t transactionID, bool coordinates, TH_FrameType frameType)
     {
         size_t i = 0;
         message[i++] = MessageID::ID_SET_MODE;
-        message[i++] = transactionID++;
+        message[i++] = transactionID;
         message[i++] = static_cast<uint8_t>(coordinates);
         message[i++] = static_cast<uint8_t>(frameType);
         appednCRC(message, i);
         return i;
     }
 
-    size_t createMessageSetRegister(uint8_t* message, uint16_t bufferSize, trackHat_SetRegister_t* setRegister, uint8_t* messageTransactionID)
+    size_t createMessageSetRegister(uint8_t* message, uint16_t bufferSize, uint8_t transactionID, trackHat_SetRegister_t* setRegister)
     {
         if (bufferSize < 7)
             return 0;
-        *messageTransactionID = transactionID;
         message[0] = MessageID::ID_SET_REGISTER_VALUE;
-        message[1] = transactionID++;
+        message[1] = transactionID;
         message[2] = static_cast<uint8_t>(setRegister->m_registerBank);
         message[3] = static_cast<uint8_t>(setRegister->m_registerAddress);
         message[4] = static_cast<uint8_t>(setRegister->m_registerValue);
@@ -60,14 +58,15 @@ namespace Parser
         appednCRC(message, messageLength);
         return messageLength;
     }
-    size_t createMessageSetRegisterGroup(uint8_t* message, uint16_t bufferSize, trackHat_SetRegisterGroup_t* setRegisterGroup,
-                                         uint8_t* messageTransactionID)
+    size_t createMessageSetRegisterGroup(uint8_t* message, uint16_t bufferSize, uint8_t transactionID,
+                                         trackHat_SetRegisterGroup_t* setRegisterGroup)
     {
-        if (bufferSize < 8)
+        // Header, 3 bytes of each register and CRC
+        if ((setRegisterGroup->numberOfRegisters > MAX_NUMBER_OF_REGISTERS) ||
+            (bufferSize < 3 + 3*setRegisterGroup->numberOfRegisters + 2))
             return 0;
-        *messageTransactionID = transactionID;
         message[0] = MessageID::ID_SET_REGISTER_GROUP;
-        message[1] = transactionID++;
+        message[1] = transactionID;
         message[2] = static_cast<uint8_t>(setRegisterGroup->numberOfRegisters);
         for(uint8_t i = 0; i < setRegisterGroup->numberOfRegisters; i++)
         {
@@ -81,11 +80,10 @@ namespace Parser
         return messageLength;
     }
 
-    size_t createMessageSetLeds(uint8_t* message, trackHat_SetLeds_t* setLeds, uint8_t* messageTransactionID)
+    size_t createMessageSetLeds(uint8_t* message, uint8_t transactionID, trackHat_SetLeds_t* setLeds)
     {
-        *messageTransactionID = transactionID;
         message[0] = MessageID::ID_SET_LEDS;
-        message[1] = transactionID++;
+        message[1] = transactionID;
         message[2] = static_cast<uint8_t>(setLeds->ledRedState);
         message[3] = static_cast<uint8_t>(setLeds->ledGreenState);
         message[4] = static_cast<uint8_t>(setLeds->ledBlueState);
@@ -94,111 +92,141 @@ namespace Parser
         return messageLength;
     }
 
-    size_t createMessageEnableBootloader(uint8_t* message, uint16_t bufferSize, TH_BootloaderMode bootloaderMode, uint8_t* messageTransactionID)
+    size_t createMessageEnableBootloader(uint8_t* message, uint16_t bufferSize, uint8_t transactionID, TH_BootloaderMode bootloaderMode)
     {
         if (bufferSize < 5)
             return 0;
-        *messageTransactionID = transactionID;
         message[0] = MessageID::ID_RESET_DEVICE;
-        message[1] = transactionID++;
+        message[1] = transactionID;
         message[2] = static_cast<uint8_t>(bootloaderMode);
         size_t messageLength = 5;
         appednCRC(message, messageLength);
         return messageLength;
     }
 
-    void parseMessageStatus(std::vector<uint8_t>& input, MessageStatus& status)
+    void parseMessageStatus(const uint8_t* input, MessageStatus& status)
     {
-        WaitForSingleObject(status.m_mutex, INFINITE);
-
-        status.m_transactionID = input[1];
-        status.m_camStatus = static_cast<CameraStatus>(input[2]);
-        status.m_camMode = static_cast<CameraMode>(input[3]);
-        status.m_uptimeInSec = static_cast<uint32_t>(input[4]) << 24 |
-                               static_cast<uint32_t>(input[5]) << 16 |
-                               static_cast<uint32_t>(input[6]) << 8 |
-                               static_cast<uint32_t>(input[7]);
-
-        ReleaseMutex(status.m_mutex);
-        SetEvent(status.m_newMessageEvent);
+        {
+            std::lock_guard<std::mutex> lock(status.m_mutex);
+
+            status.m_transactionID = input[1];
+            status.m_camStatus = static_cast<CameraStatus>(input[2]);
+            status.m_camMode = static_cast<CameraMode>(input[3]);
+            status.m_uptimeInSec = static_cast<uint32_t>(input[4]) << 24 |
+                                   static_cast<uint32_t>(input[5]) << 16 |
+                                   static_cast<uint32_t>(input[6]) << 8 |
+                                   static_cast<uint32_t>(input[7]);
+        }
+        status.m_newMessageEvent.set();
     }
 
-    void parseMessageDeviceInfo(std::vector<uint8_t>& input, MessageDeviceInfo& deviceInfo)
+    void parseMessageDeviceInfo(const uint8_t* input, MessageDeviceInfo& deviceInfo)
     {
-        WaitForSingleObject(deviceInfo.m_mutex, INFINITE);
-
-        deviceInfo.m_transactionID = input[1];
-        deviceInfo.m_hardwareVersion = input[2];
-        deviceInfo.m_softwareVersionMajor = input[3];
-        deviceInfo.m_softwareVersionMinor = input[4];
-        deviceInfo.m_serialNumber = static_cast<uint32_t>(input[5]) << 24 |
-                                    static_cast<uint32_t>(input[6]) << 16 |
-                                    static_cast<uint32_t>(input[7]) << 8 |
-                                    static_cast<uint32_t>(input[8]);
-
-        ReleaseMutex(deviceInfo.m_mutex);
-        SetEvent(deviceInfo.m_newMessageEvent);
+        {
+            std::lock_guard<std::mutex> lock(deviceInfo.m_mutex);
+
+            deviceInfo.m_transactionID = input[1];
+            deviceInfo.m_hardwareVersion = input[2];
+            deviceInfo.m_softwareVersionMajor = input[3];
+            deviceInfo.m_softwareVersionMinor = input[4];
+            deviceInfo.m_serialNumber = static_cast<uint32_t>(input[5]) << 24 |
+                                        static_cast<uint32_t>(input[6]) << 16 |
+                                        static_cast<uint32_t>(input[7]) << 8 |
+                                        static_cast<uint32_t>(input[8]);
+        }
+        deviceInfo.m_newMessageEvent.set();
     }
 
-    void parseMessageCoordinates(const std::vector<uint8_t>& input, MessageCoordinates& coordinates)
+    static_assert(MessageCoordinates::FrameSize - 3 == Decode::PointsPayloadSize, "Wrong size of the points payload");
+    static_assert(MessageExtendedCoordinates::FrameSize - 3 == Decode::ExtendedPointsPayloadSize, "Wrong size of the extended points payload");
+
+    /* Keep the payload of the frame for the decoders of the getters and the callbacks */
+    template<typename Message, typename Points>
+    static void storeRawPoints(const uint8_t* input, Message& message, const Points& points)
     {
-        trackHat_Point_t* points = coordinates.m_points.m_point;
-        uint16_t value = 0;
-        size_t byte = 1;
+        RawPoints<Message::FrameSize - 3> rawPoints;
+        memcpy(rawPoints.m_payload, input + 1, sizeof(rawPoints.m_payload));
+        rawPoints.m_timestampUs = points.m_timestampUs;
+        rawPoints.m_frameNumber = points.m_frameNumber;
+        message.m_rawPoints.store(rawPoints);
+    }
 
-        ::WaitForSingleObject(coordinates.m_mutex, INFINITE);
+    void parseMessageCoordinates(const uint8_t* input, MessageCoordinates& coordinates, uint64_t timestampUs)
+    {
+        trackHat_Points_t newPoints = {};
+        Decode::decodePoints(input + 1, newPoints.m_point);
+
+        newPoints.m_timestampUs = timestampUs;
+        newPoints.m_frameNumber = coordinates.m_frameNumber++;
+        coordinates.m_points.store(newPoints);
+        storeRawPoints(input, coordinates, newPoints);
+        coordinates.m_queue.push(newPoints);
+        coordinates.m_subscriptionRing.publish(newPoints);
+        coordinates.m_newMessageEvent.set();
+
+        if (coordinates.m_inlineCallback != nullptr)
+            coordinates.m_inlineCallback(coordinates.m_inlineCallbackContext, &newPoints);
+        else
+            coordinates.m_newCallbackEvent.set();
+    }
 
-        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+    void parseMessageExtendedCoordinates(const uint8_t* input, MessageExtendedCoordinates& extendedCoordinates, uint64_t timestampUs)
+    {
+        trackHat_ExtendedPoints_t newPoints;
+        newPoints.m_timestampUs = timestampUs;
+        newPoints.m_frameNumber = extendedCoordinates.m_frameNumber++;
+        storeRawPoints(input, extendedCoordinates, newPoints);
+
+        // The latest points are decoded from the raw payload by their readers. Only the queue,
+        // the subscribers and the inline callback need every frame decoded by the receiver.
+        const bool isDecodingNeeded = (extendedCoordinates.m_queue.capacity() > 0) ||
+                                      extendedCoordinates.m_subscriptionRing.isAllocated() ||
+                                      (extendedCoordinates.m_inlineCallback != nullptr);
+        if (isDecodingNeeded)
         {
-            value = static_cast<uint16_t>(input[byte++] << 8);
-            value = value | input[byte++];
-            points[i].m_x = value;
-
-            value = static_cast<uint16_t>(input[byte++] << 8);
-            value = value | input[byte++];
-            points[i].m_y = value;
-
-            points[i].m_brightness = input[byte++];
+            Decode::decodeExtendedPoints(input + 1, newPoints);
+            extendedCoordinates.m_queue.push(newPoints);
+            extendedCoordinates.m_subscriptionRing.publish(newPoints);
         }
+        extendedCoordinates.m_newMessageEvent.set();
 
-        ::ReleaseMutex(coordinates.m_mutex);
-        ::SetEvent(coordinates.m_newMessageEvent);
-        ::SetEvent(coordinates.m_newCallbackEvent);
+        if (extendedCoordinates.m_inlineCallback != nullptr)
+            extendedCoordinates.m_inlineCallback(extendedCoordinates.m_inlineCallbackContext, &newPoints);
+        else
+            extendedCoordinates.m_newCallbackEvent.set();
     }
 
-    void parseMessageExtendedCoordinates(std::vector<uint8_t>& input, MessageExtendedCoordinates& extendedCoordinates)
+    void parseMessageACK(const uint8_t* input, trackHat_Messages_t& messages, uint64_t timestampUs)
     {
-        trackHat_ExtendedPointRaw_t rawPoints[TRACK_HAT_NUMBER_OF_POINTS];
+        // The waiting command is woken up at once
+        if (messages.m_transactions.complete(input[1], TRANSACTION_ACK))
+            messages.m_statistics.commandAnswered(input[1], timestampUs);
+        else
+            LOG_INFO("Unexpected ACK of transaction " << static_cast<int>(input[1]) << ".");
+    }
 
-        bool result = checkCRC(input, MessageExtendedCoordinates::FrameSize);
-        if (result)
+    void parseMessageNACK(const uint8_t* input, trackHat_Messages_t& messages, uint64_t timestampUs)
+    {
+        switch (static_cast<NACKReason>(input[2]))
         {
-            memcpy(&rawPoints, input.data()+1, MessageExtendedCoordinates::FrameSize-3);
-            for (size_t i=0; i<TRACK_HAT_NUMBER_OF_POINTS; i++)
-            {
-                parseRawExtendedPointToHumanRedable(rawPoints[i], extendedCoordinates.m_points.m_point[i]);
-            }
-            ReleaseMutex(extendedCoordinates.m_mutex);
-            SetEvent(extendedCoordinates.m_newMessageEvent);
-            SetEvent(extendedCoordinates.m_newCallbackEvent);
+            case NACKReason::NACK_BUSY:            messages.m_statistics.m_nackBusy.add();           break;
+            case NACKReason::NACK_INVALID_REQUEST: messages.m_statistics.m_nackInvalidRequest.add(); break;
+            default:                               messages.m_statistics.m_nackOther.add();          break;
         }
-        input.erase(input.begin(), input.begin()+MessageExtendedCoordinates::FrameSize);
-    }
 
-    void parseMessageACK(const std::vector<uint8_t>& input, trackHat_Messages_t& messages)
-    {
-        messages.m_lastACKTransactionId = input[1];
+        const uint16_t result = TRANSACTION_NACK | input[2];
+        if (messages.m_transactions.complete(input[1], result))
+            messages.m_statistics.commandAnswered(input[1], timestampUs);
+        else
+            LOG_INFO("Unexpected NACK of transaction " << static_cast<int>(input[1]) << ".");
     }
 
-    void parseMessageNACK(const std::vector<uint8_t>& input, MessageNACK& nack)
+    size_t parseInputData(const uint8_t* input, size_t size, trackHat_Messages_t& messages, uint64_t timestampUs)
     {
-        nack.m_transactionID = input[1];
-        nack.m_reason = static_cast<NACKReason>(input[2]);
-    }
+        Statistics::DeviceStatistics& statistics = messages.m_statistics;
+        size_t index = 0;   // First byte of the current frame
 
-    void parseInputData(std::vector<uint8_t>& input, trackHat_Messages_t& messages)
-    {
-        while (input.size() > 0)
+        while (index < size)
         {
             // Validation of the frame :
             // 1) ID ok, CRC ok = > parse rest of the frame
@@ -209,151 +237,231 @@ namespace Parser
             //    that not all data has been read or ID is wrong
             // 4) ID err = > leave the first byte; frames may be shifted
 
-            switch (input[0])
+            const uint8_t* frame = input + index;
+            const size_t available = size - index;
+
+            switch (frame[0])
             {
                 case MessageID::ID_COORDINATE:
                 {
-                    if (input.size() >= MessageCoordinates::FrameSize)
+                    if (available >= MessageCoordinates::FrameSize)
                     {
-                        if (checkCRC(input, MessageCoordinates::FrameSize))
+                        if (checkCRC(frame, MessageCoordinates::FrameSize))
                         {
                             //LOG_INFO("New Coordinates message.");
-                            parseMessageCoordinates(input, messages.m_coordinates);
-                            input.erase(input.begin(), input.begin() + MessageCoordinates::FrameSize);
+                            parseMessageCoordinates(frame, messages.m_coordinates, timestampUs);
+                            statistics.m_coordinatesFrames.add();
+                            index += MessageCoordinates::FrameSize;
                         }
                         else
                         {
                             LOG_ERROR("New Coordinates message - wrong CRC.");
-                            input.erase(input.begin());
+                            statistics.m_crcErrors.add();
+                            statistics.m_discardedBytes.add();
+                            index++;
                         }
                     }
                     else
                     {
                         // Not enough data. Finish parsing
-                        return;
+                        return index;
                     }
                     break;
                 }
 
                 case MessageID::ID_STATUS:
                 {
-                    if (input.size() >= MessageStatus::FrameSize)
+                    if (available >= MessageStatus::FrameSize)
                     {
-                        if (checkCRC(input, MessageStatus::FrameSize))
+                        if (checkCRC(frame, MessageStatus::FrameSize))
                         {
                             LOG_INFO("New Status message.");
-                            parseMessageStatus(input, messages.m_status);
-                            input.erase(input.begin(), input.begin() + MessageStatus::FrameSize);
+                            parseMessageStatus(frame, messages.m_status);
+                            statistics.m_statusFrames.add();
+                            index += MessageStatus::FrameSize;
                         }
                         else
                         {
                             LOG_ERROR("New Status message - wrong CRC.");
-                            input.erase(input.begin());
+                            statistics.m_crcErrors.add();
+                            statistics.m_discardedBytes.add();
+                            index++;
                         }
                     }
                     else
                     {
                         // Not enough data. Finish parsing
-                        return;
+                        return index;
                     }
                     break;
                 }
 
                 case MessageID::ID_DEVICE_INFO:
                 {
-                    if (input.size() >= MessageDeviceInfo::FrameSize)
+                    if (available >= MessageDeviceInfo::FrameSize)
                     {
-                        if (checkCRC(input, MessageDeviceInfo::FrameSize))
+                        if (checkCRC(frame, MessageDeviceInfo::FrameSize))
                         {
                             LOG_INFO("New Device Info message.");
-                            parseMessageDeviceInfo(input, messages.m_deviceInfo);
-                            input.erase(input.begin(), input.begin() + MessageDeviceInfo::FrameSize);
+                            parseMessageDeviceInfo(frame, messages.m_deviceInfo);
+                            statistics.m_deviceInfoFrames.add();
+                            index += MessageDeviceInfo::FrameSize;
                         }
                         else
                         {
                             LOG_ERROR("New Device Info message - wrong CRC.");
-                            input.erase(input.begin());
+                            statistics.m_crcErrors.add();
+                            statistics.m_discardedBytes.add();
+                            index++;
                         }
                     }
                     else
                     {
                         // Not enough data. Finish parsing
-                        return;
+                        return index;
                     }
                     break;
                 }
 
                 case MessageID::ID_ACK:
                 {
-                    if (input.size() >= MessageACK::FrameSize)
+                    if (available >= MessageACK::FrameSize)
                     {
-                        if (checkCRC(input, MessageACK::FrameSize))
+                        if (checkCRC(frame, MessageACK::FrameSize))
                         {
                             LOG_INFO("ACK");
-                            parseMessageACK(input, messages);
-                            input.erase(input.begin(), input.begin() + MessageACK::FrameSize);
+                            parseMessageACK(frame, messages, timestampUs);
+                            statistics.m_ackFrames.add();
+                            index += MessageACK::FrameSize;
                         }
                         else
                         {
                             LOG_ERROR("ACK - wrong CRC.");
-                            input.erase(input.begin());
+                            statistics.m_crcErrors.add();
+                            statistics.m_discardedBytes.add();
+                            index++;
                         }
                     }
                     else
                     {
                         // Not enough data. Finish parsing
-                        return;
+                        return index;
                     }
                     break;
                 }
 
                 case MessageID::ID_NACK:
                 {
-                    if (input.size() >= MessageNACK::FrameSize)
+                    if (available >= MessageNACK::FrameSize)
                     {
-                        if (checkCRC(input, MessageNACK::FrameSize))
+                        if (checkCRC(frame, MessageNACK::FrameSize))
                         {
                             LOG_ERROR("NACK");
-                            parseMessageNACK(input, messages.m_nack);
-                            input.erase(input.begin(), input.begin() + MessageNACK::FrameSize);
+                            parseMessageNACK(frame, messages, timestampUs);
+                            statistics.m_nackFrames.add();
+                            index += MessageNACK::FrameSize;
                         }
                         else
                         {
                             LOG_ERROR("NACK - wrong CRC.");
-                            input.erase(input.begin());
+                            statistics.m_crcErrors.add();
+                            statistics.m_discardedBytes.add();
+                            index++;
                         }
                     }
                     else
                     {
                         // Not enough data. Finish parsing
-                        return;
+                        return index;
                     }
                     break;
                 }
 
-            case MessageID::ID_EXTENDED_COORDINATES:
-            {
-
-                if (input.size() >= MessageExtendedCoordinates::FrameSize)
-                {
-                    parseMessageExtendedCoordinates(input, messages.m_extendedCoordinates);
-                }
-                else
+                case MessageID::ID_EXTENDED_COORDINATES:
                 {
-                    return;
+                    if (available >= MessageExtendedCoordinates::FrameSize)
+                    {
+                        if (checkCRC(frame, MessageExtendedCoordinates::FrameSize))
+                        {
+                            parseMessageExtendedCoordinates(frame, messages.m_extendedCoordinates, timestampUs);
+                            statistics.m_extendedCoordinatesFrames.add();
+                            index += MessageExtendedCoordinates::FrameSize;
+                        }
+                        else
+                        {
+                            LOG_ERROR("New Extended Coordinates message - wrong CRC.");
+                            statistics.m_crcErrors.add();
+                            statistics.m_discardedBytes.add();
+                            index++;
+                        }
+                    }
+                    else
+                    {
+                        // Not enough data. Finish parsing
+                        return index;
+                    }
+                    break;
                 }
-                break;
-            }
+
                 default:
                 {
-                    char byte[8];
-                    sprintf(byte, "0x%02x", input[0]);
-                    LOG_ERROR("Unknown frame Id " << byte << ".");
-                    input.erase(input.begin());
+                    LOG_ERROR("Unknown frame Id " << Logger::Hex(frame[0]) << ".");
+                    statistics.m_unknownFrameIds.add();
+                    statistics.m_discardedBytes.add();
+                    index++;
                     break;
                 }
             }
         }
+
+        return index;
+    }
+
+    void parseInputData(RxBuffer& input, trackHat_Messages_t& messages, uint64_t timestampUs)
+    {
+        // The contiguous part may end in the mirrored area before all data is parsed,
+        // continue from the beginning of the ring in such case
+        while (input.size() > 0)
+        {
+            size_t parsedSize = parseInputData(input.readPointer(), input.readSize(), messages, timestampUs);
+            if (parsedSize == 0)
+                break;
+
+            input.consume(parsedSize);
+        }
+    }
+
+
+    size_t RxBuffer::writeSpace() const
+    {
+        const size_t freeSpace = Capacity - m_size;
+        const size_t spaceToEnd = Capacity - m_writeIndex;
+        return (freeSpace < spaceToEnd) ? freeSpace : spaceToEnd;
+    }
+
+    void RxBuffer::commit(size_t size)
+    {
+        // Mirror the beginning of the ring after its end
+        if (m_writeIndex < MaxFrameSize)
+        {
+            const size_t mirrorSize = (size < MaxFrameSize - m_writeIndex) ? size : (MaxFrameSize - m_writeIndex);
+            memcpy(m_data + Capacity + m_writeIndex, m_data + m_writeIndex, mirrorSize);
+        }
+
+        m_writeIndex = (m_writeIndex + size) % Capacity;
+        m_size += size;
+    }
+
+    size_t RxBuffer::readSize() const
+    {
+        const size_t contiguousSize = Capacity + MaxFrameSize - m_readIndex;
+        return (m_size < contiguousSize) ? m_size : contiguousSize;
+    }
+
+    void RxBuffer::consume(size_t size)
+    {
+        m_readIndex = (m_readIndex + size) % Capacity;
+        m_size -= size;
     }
 
 
@@ -364,7 +472,7 @@ namespace Parser
         message[index++] = crc & 0xff;
     }
 
-    bool checkCRC(const std::vector<uint8_t>& buffer, size_t size)
+    bool checkCRC(const uint8_t* buffer, size_t size)
     {
         // Get CRC from the last two bytes
         auto crc1 = static_cast<uint16_t>(
@@ -376,20 +484,8 @@ namespace Parser
 
     void parseRawExtendedPointToHumanRedable(const trackHat_ExtendedPointRaw_t& rawPoint, trackHat_ExtendedPoint_t& extendedPointsParsed)
     {
-        extendedPointsParsed.m_area = static_cast<uint16_t>(static_cast<unsigned>(rawPoint.m_areaHigh << 8) | static_cast<unsigned>(rawPoint.m_areaLow));
-        extendedPointsParsed.m_coordinateX = static_cast<uint16_t>(static_cast<unsigned>(rawPoint.m_coordinateXHigh << 8) | static_cast<unsigned>(rawPoint.m_coordinateXLow)) & 0x3fff;
-        extendedPointsParsed.m_coordinateY = static_cast<uint16_t>(static_cast<unsigned>(rawPoint.m_coordinateYHigh << 8) | static_cast<unsigned>(rawPoint.m_coordinateYLow)) & 0x3fff;
-        extendedPointsParsed.m_averageBrightness = rawPoint.m_averageBrightness;
-        extendedPointsParsed.m_maximumBrightness = rawPoint.m_maximumBrightness;
-        extendedPointsParsed.m_range = rawPoint.m_range;
-        extendedPointsParsed.m_radius = rawPoint.m_radius;
-        extendedPointsParsed.m_boundryLeft = rawPoint.m_boundryLeft;
-        extendedPointsParsed.m_boundryRigth = rawPoint.m_boundryRigth;
-        extendedPointsParsed.m_boundryUp = rawPoint.m_boundryUp;
-        extendedPointsParsed.m_boundryDown = rawPoint.m_boundryDown;
-        extendedPointsParsed.m_aspectRatio = rawPoint.m_aspectRatio;
-        extendedPointsParsed.m_vx = rawPoint.m_vx;
-        extendedPointsParsed.m_vy = rawPoint.m_vy;
+        // Read by the wire offsets, the order of the range and radius bitfields depends on the compiler
+        Decode::ExtendedPointView(reinterpret_cast<const uint8_t*>(&rawPoint)).decode(extendedPointsParsed);
     }
 
     void printExtendedPoint(trackHat_ExtendedPoint_t extendedPoint, int i)
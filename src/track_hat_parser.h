@@ -9,89 +9,156 @@
 #include <track_hat_types_internal.h>
 
 #include <stdint.h>
-#include <vector>
 
 namespace Parser
 {
 
+    /**
+     * Fixed-size ring buffer for the data received from the camera.
+     *
+     * The first 'MaxFrameSize' bytes of the ring are mirrored after its end, so each frame
+     * starting in the ring is contiguous in memory and is parsed in place. Consumed data is
+     * never moved and the buffer does not allocate.
+     */
+    class RxBuffer
+    {
+    public:
+        static const size_t Capacity = MESSAGE_RX_BUFFER_SIZE;
+        static const size_t MaxFrameSize = MessageExtendedCoordinates::FrameSize;
+
+        RxBuffer(const RxBuffer&) = delete;
+        RxBuffer& operator=(const RxBuffer&) = delete;
+        RxBuffer() = default;
+
+        /* Place for the next received data */
+        uint8_t* writePointer() { return m_data + m_writeIndex; }
+
+        /* Size of the contiguous free space at 'writePointer()' */
+        size_t writeSpace() const;
+
+        /* Add 'size' bytes stored at 'writePointer()' */
+        void commit(size_t size);
+
+        /* First byte waiting for parsing */
+        const uint8_t* readPointer() const { return m_data + m_readIndex; }
+
+        /* Number of bytes contiguous in memory at 'readPointer()' */
+        size_t readSize() const;
+
+        /* Remove 'size' parsed bytes */
+        void consume(size_t size);
+
+        /* Number of bytes waiting for parsing */
+        size_t size() const { return m_size; }
+
+    private:
+        uint8_t m_data[Capacity + MaxFrameSize];
+        size_t  m_readIndex = 0;
+        size_t  m_writeIndex = 0;
+        size_t  m_size = 0;
+    };
+
     /**
      * Create binary frame for GET_STATUS message.
      *
      * \param[in/out]  message       Buffer to set the frame.
+     * \param[in]      transactionID Number of the transaction, returned in ACK/NACK.
      *
      * \return                       Size of the output message.
      */
-    size_t createMessageGetStatus(uint8_t* message);
+    size_t createMessageGetStatus(uint8_t* message, uint8_t transactionID);
 
 
     /**
      * Create binary frame for GET_DEVICE_INFO message.
      *
      * \param[in/out]  message       Buffer to set the frame.
+     * \param[in]      transactionID Number of the transaction, returned in ACK/NACK.
      *
      * \return                       Size of the output message.
      */
-    size_t createMessageGetDeviceInfo(uint8_t* message);
+    size_t createMessageGetDeviceInfo(uint8_t* message, uint8_t transactionID);
 
 
     /**
      * Create binary frame for SET_MODE message.
      *
      * \param[in/out]  message       Buffer to set the frame.
+     * \param[in]      transactionID Number of the transaction, returned in ACK/NACK.
      * \param[in]      coordinates   0 - Idle Mode, 1 = Coordinates Mode
      *
      * \return                       Size of the output message.
      */
-    size_t createMessageSetMode(uint8_t* message, bool coordinates, TH_FrameType frameType);
+    size_t createMessageSetMode(uint8_t* message, uint8_t transactionID, bool coordinates, TH_FrameType frameType);
 
     /**
      * Create binary frame for SET_REGISTER message.
      *
      * \param[in/out]  message       Buffer to set the frame.
+     * \param[in]      transactionID Number of the transaction, returned in ACK/NACK.
      * \param[in]      setRegistr    Information about register to set
      *
      * \return                       Size of the output message.
      */
-    size_t createMessageSetRegister(uint8_t* message, uint16_t bufferSize, trackHat_SetRegister_t* setRegister, uint8_t* messageTransactionID);
+    size_t createMessageSetRegister(uint8_t* message, uint16_t bufferSize, uint8_t transactionID, trackHat_SetRegister_t* setRegister);
 
     /**
      * Create binary frame for SET_REGISTER_GROUP message.
      *
      * \param[in/out]  message       Buffer to set the frame.
+     * \param[in]      transactionID Number of the transaction, returned in ACK/NACK.
      * \param[in]      setRegistr    Information about register to set
      *
-     * \return                       Size of the output message.
+     * \return                       Size of the output message, '0' if the group does not fit the buffer.
      */
 
-    size_t createMessageSetRegisterGroup(uint8_t* message, uint16_t bufferSize, trackHat_SetRegisterGroup_t* setRegisterGroup, uint8_t* messageTransactionID);
+    size_t createMessageSetRegisterGroup(uint8_t* message, uint16_t bufferSize, uint8_t transactionID, trackHat_SetRegisterGroup_t* setRegisterGroup);
  /**
      * Create binary frame for SET_LEDS message.
      *
      * \param[in/out]  message       Buffer to set the frame.
+     * \param[in]      transactionID Number of the transaction, returned in ACK/NACK.
      * \param[in]      ledState      Information about leds to set
      *
      * \return                       Size of the output message.
      */
-    size_t createMessageSetLeds(uint8_t* message, trackHat_SetLeds_t* setLeds, uint8_t *messageTransactionID);
+    size_t createMessageSetLeds(uint8_t* message, uint8_t transactionID, trackHat_SetLeds_t* setLeds);
 
    /**
-     * Parse binary data na conver it to TrackHat messages.
+     * Create binary frame for RESET_DEVICE message.
      *
-     * \param[in/out] input        Vector of the data to parse. The parsed bytes are deleted.
-     * \param[in/out] messages     Structure of 'trackHat_Messages_t' where parsed data wil be stored.
+     * \param[in/out]  message          Buffer to set the frame.
+     * \param[in]      transactionID    Number of the transaction, returned in ACK/NACK.
+     * \param[in]      bootloaderMode   Start bootloader after reset or not
      *
+     * \return                          Size of the output message.
      */
-    size_t createMessageEnableBootloader(uint8_t* message, uint16_t bufferSize, TH_BootloaderMode bootloaderMode, uint8_t* messageTransactionID);
+    size_t createMessageEnableBootloader(uint8_t* message, uint16_t bufferSize, uint8_t transactionID, TH_BootloaderMode bootloaderMode);
 
 
     /**
      * Parse binary data na conver it to TrackHat messages.
      *
-     * \param[in/out] input        Vector of the data to parse. The parsed bytes are deleted.
+     * Frames are parsed in place. Parsing stops at the first incomplete frame.
+     *
+     * \param[in]     input        Data to parse.
+     * \param[in]     size         Size of the data.
+     * \param[in/out] messages     Structure of 'trackHat_Messages_t' where parsed data wil be stored.
+     * \param[in]     timestampUs  Time when the data was received, stored in the coordinates.
+     *
+     * \return        Number of parsed bytes, the rest should be passed again with new data.
+     */
+    size_t parseInputData(const uint8_t* input, size_t size, trackHat_Messages_t& messages, uint64_t timestampUs);
+
+    /**
+     * Parse all frames waiting in the receive buffer.
+     *
+     * \param[in/out] input        Buffer of the data to parse. The parsed bytes are consumed.
      * \param[in/out] messages     Structure of 'trackHat_Messages_t' where parsed data wil be stored.
+     * \param[in]     timestampUs  Time when the last data was received, stored in the coordinates.
      *
      */
-    void parseInputData(std::vector<uint8_t>& input, trackHat_Messages_t& messages);
+    void parseInputData(RxBuffer& input, trackHat_Messages_t& messages, uint64_t timestampUs);
 
     /**
     * Add CRC at the end of frame.
@@ -112,7 +179,7 @@ namespace Parser
      * \return         true or false depending if CRC is correct or not.
      *
      */
-    bool checkCRC(const std::vector<uint8_t>& buffer, size_t size);
+    bool checkCRC(const uint8_t* buffer, size_t size);
 
     void parseRawExtendedPointToHumanRedable(const trackHat_ExtendedPointRaw_t& rawPoint, trackHat_ExtendedPoint_t& extendedPointsParsed);
 
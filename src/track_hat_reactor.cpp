@@ -0,0 +1,285 @@
+// File:   track_hat_reactor.cpp
+// Brief:  Single thread receiving the data of many TrackHat cameras
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_reactor.h"
+
+#include "logger.h"
+#include "track_hat_driver.h"
+#include "track_hat_driver_internal.h"
+#include "track_hat_parser.h"
+#include "usb_serial.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/* Maximum number of reads handled after a single wait */
+#define REACTOR_MAX_COMPLETIONS 16
+
+namespace Reactor
+{
+
+    /* Device served by the reactor thread */
+    struct Device
+    {
+        trackHat_Internal_t* m_pInternal = nullptr;
+        Parser::RxBuffer     m_dataBuffer;              // data to parse, received directly into the buffer
+        bool                 m_isReceiving = true;      // false after the device was unplugged
+        time_t               m_lastErrorTimeSec = 0;    // last error reported to the callback
+        std::chrono::steady_clock::time_point m_lastPointsTime;
+    };
+
+    /* Call of 'attach()' or 'detach()' handled by the reactor thread */
+    struct Request
+    {
+        trackHat_Internal_t* m_pInternal;
+        bool                 m_isAttach;
+        bool                 m_isDone;
+        TH_ErrorCode         m_result;
+    };
+
+
+    class SharedReactor
+    {
+    public:
+        static SharedReactor& instance()
+        {
+            static SharedReactor reactor;
+            return reactor;
+        }
+
+        ~SharedReactor();
+
+        /* Pass the request to the reactor thread and wait until it is handled */
+        TH_ErrorCode request(trackHat_Internal_t* pInternal, bool isAttach);
+
+    private:
+        SharedReactor() = default;
+
+        /* Function of the reactor thread */
+        void run();
+
+        /* Attach and detach the devices, called with 'm_mutex' locked */
+        void handleRequests();
+
+        /* Parse the received data or handle the unplugged device */
+        void handleCompletion(const UsbSerial::PollerCompletion& completion, uint64_t timestampUs);
+
+        /* Call the callbacks of all devices with new points or errors */
+        void runCallbacks();
+
+        /* Receive the next data of the device into its buffer */
+        void startRead(Device& device);
+
+        UsbSerial::Poller       m_poller;
+        std::mutex              m_mutex;
+        std::condition_variable m_condition;
+        std::vector<Request*>   m_requests;     // waiting for the reactor thread
+        std::thread             m_thread;
+        bool                    m_isRunning = false;
+        bool                    m_isStopping = false;
+        std::vector<std::unique_ptr<Device>> m_devices;   // used only by the reactor thread
+    };
+
+
+    SharedReactor::~SharedReactor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isStopping = true;
+        }
+
+        m_poller.wakeup();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    TH_ErrorCode SharedReactor::request(trackHat_Internal_t* pInternal, bool isAttach)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (m_thread.joinable() && (m_thread.get_id() == std::this_thread::get_id()))
+        {
+            LOG_ERROR("Device cannot be connected or disconnected in the callback function.");
+            return TH_ERROR_WRONG_PARAMETER;
+        }
+
+        if (!m_isRunning)
+        {
+            if (!isAttach)
+                return TH_SUCCESS;
+
+            // The thread finishes by itself after the last device is detached
+            if (m_thread.joinable())
+                m_thread.join();
+
+            if (!m_poller.isValid())
+                return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+
+            m_isRunning = true;
+            try
+            {
+                m_thread = std::thread(&SharedReactor::run, this);
+            }
+            catch (const std::system_error& error)
+            {
+                LOG_ERROR("Cannot start shared receiving. Error " << error.what() << ".");
+                m_isRunning = false;
+                return TH_ERROR_WRONG_PARAMETER;
+            }
+        }
+
+        Request request = { pInternal, isAttach, false, TH_SUCCESS };
+        m_requests.push_back(&request);
+        m_poller.wakeup();
+
+        m_condition.wait(lock, [&request] { return request.m_isDone; });
+        return request.m_result;
+    }
+
+    void SharedReactor::run()
+    {
+        UsbSerial::PollerCompletion completions[REACTOR_MAX_COMPLETIONS];
+
+        LOG_INFO("Shared receiving started.");
+
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                handleRequests();
+
+                if (m_devices.empty() || m_isStopping)
+                {
+                    m_isRunning = false;
+                    break;
+                }
+            }
+
+            // Wake up every 100 ms to report the devices without points to the callbacks
+            size_t count = m_poller.wait(completions, REACTOR_MAX_COMPLETIONS, CALLBACK_WAIT_TIMEOUT_MS);
+            const uint64_t timestampUs = trackHat_GetTimestampUs();
+
+            for (size_t i = 0; i < count; i++)
+                handleCompletion(completions[i], timestampUs);
+
+            runCallbacks();
+        }
+
+        LOG_INFO("Shared receiving finished.");
+    }
+
+    void SharedReactor::handleRequests()
+    {
+        if (m_requests.empty())
+            return;
+
+        for (Request* request : m_requests)
+        {
+            usbSerial_t& serial = request->m_pInternal->m_serial;
+
+            if (request->m_isAttach)
+            {
+                std::unique_ptr<Device> device(new (std::nothrow) Device);
+                if (!device)
+                {
+                    request->m_result = TH_MEMORY_ALLOCATION_FAILED;
+                }
+                else
+                {
+                    device->m_pInternal = request->m_pInternal;
+                    device->m_lastPointsTime = std::chrono::steady_clock::now();
+
+                    request->m_result = m_poller.add(serial, device.get());
+                    if (request->m_result == TH_SUCCESS)
+                    {
+                        startRead(*device);
+                        m_devices.push_back(std::move(device));
+                    }
+                }
+            }
+            else
+            {
+                for (auto it = m_devices.begin(); it != m_devices.end(); ++it)
+                {
+                    if ((*it)->m_pInternal != request->m_pInternal)
+                        continue;
+
+                    if ((*it)->m_isReceiving)
+                        m_poller.remove(serial);
+                    m_devices.erase(it);
+                    break;
+                }
+            }
+
+            request->m_isDone = true;
+        }
+
+        m_requests.clear();
+        m_condition.notify_all();
+    }
+
+    void SharedReactor::handleCompletion(const UsbSerial::PollerCompletion& completion, uint64_t timestampUs)
+    {
+        Device& device = *static_cast<Device*>(completion.m_context);
+        trackHat_Internal_t* pInternal = device.m_pInternal;
+
+        if (completion.m_result == TH_SUCCESS)
+        {
+            if (completion.m_readSize > 0)
+                trackHat_HandleReceivedData(pInternal, device.m_dataBuffer, completion.m_readSize, timestampUs);
+
+            startRead(device);
+        }
+        else
+        {
+            LOG_ERROR("Device unplugged.");
+            pInternal->m_isUnplugged = true;
+            device.m_isReceiving = false;
+            m_poller.remove(pInternal->m_serial);
+        }
+    }
+
+    void SharedReactor::runCallbacks()
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        for (const std::unique_ptr<Device>& device : m_devices)
+        {
+            if (trackHat_WaitForNewPoints(device->m_pInternal, 0))
+            {
+                device->m_lastPointsTime = now;
+                trackHat_RunCallbacks(device->m_pInternal, true, device->m_lastErrorTimeSec);
+            }
+            else if (now - device->m_lastPointsTime >= std::chrono::milliseconds(CALLBACK_WAIT_TIMEOUT_MS))
+            {
+                // The same condition as the timeout of the callback thread
+                trackHat_RunCallbacks(device->m_pInternal, false, device->m_lastErrorTimeSec);
+            }
+        }
+    }
+
+    void SharedReactor::startRead(Device& device)
+    {
+        m_poller.startRead(device.m_pInternal->m_serial, device.m_dataBuffer.writePointer(), device.m_dataBuffer.writeSpace());
+    }
+
+
+    TH_ErrorCode attach(trackHat_Internal_t* pInternal)
+    {
+        return SharedReactor::instance().request(pInternal, true);
+    }
+
+    void detach(trackHat_Internal_t* pInternal)
+    {
+        SharedReactor::instance().request(pInternal, false);
+    }
+
+} // namespace Reactor
@@ -0,0 +1,38 @@
+// File:   track_hat_reactor.h
+// Brief:  Single thread receiving the data of many TrackHat cameras
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _TRACK_HAT_REACTOR_H_
+#define _TRACK_HAT_REACTOR_H_
+
+#include "track_hat_types_internal.h"
+
+namespace Reactor
+{
+
+    /*
+     * The reactor is a single thread shared by all devices connected with
+     * 'trackHat_EnableSharedReceiver()'. It replaces both threads of the device: the data of
+     * all ports is waited for with 'UsbSerial::Poller', parsed and the callbacks are called
+     * directly on the reactor thread, so a blocking callback stops receiving of all devices.
+     * The thread is started with the first device and finished when the last one is detached.
+     */
+
+    /**
+     * Start receiving the data of the device on the reactor thread.
+     *
+     * Note: The port must be open and must not be a simulated device.
+     *
+     * \param[in]  pInternal   Device to receive the data for.
+     *
+     * \return     TH_SUCCESS or error code.
+     */
+    TH_ErrorCode attach(trackHat_Internal_t* pInternal);
+
+    /* Stop receiving the data of the device, the reactor does not use it after return */
+    void detach(trackHat_Internal_t* pInternal);
+
+} // namespace Reactor
+
+#endif //_TRACK_HAT_REACTOR_H_
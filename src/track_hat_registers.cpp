@@ -0,0 +1,118 @@
+// File:   track_hat_registers.cpp
+// Brief:  Values of the camera registers known to the driver
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_registers.h"
+
+#include <new>
+
+namespace Registers
+{
+
+    void Shadow::enable(bool enable)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!enable)
+            m_state.reset();
+        else if (!m_state)
+            m_state.reset(new (std::nothrow) State);
+    }
+
+    bool Shadow::isEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return static_cast<bool>(m_state);
+    }
+
+    void Shadow::invalidate()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_state)
+            return;
+
+        for (std::unique_ptr<uint32_t[]>& bank : m_state->m_banks)
+            bank.reset();
+        for (Transaction& transaction : m_state->m_transactions)
+            transaction.m_count = 0;
+    }
+
+    size_t Shadow::removeClean(trackHat_SetRegister_t* registers, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_state)
+            return count;
+
+        size_t dirtyCount = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t* entry = findEntry(registers[i]);
+            const bool isClean = (entry != nullptr) && (*entry & EntryValid) && ((*entry & 0xff) == registers[i].m_registerValue);
+
+            if (!isClean)
+                registers[dirtyCount++] = registers[i];
+        }
+
+        return dirtyCount;
+    }
+
+    void Shadow::send(uint8_t transactionID, const trackHat_SetRegister_t* registers, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_state || (count > MAX_NUMBER_OF_REGISTERS))
+            return;
+
+        Transaction& transaction = m_state->m_transactions[transactionID];
+        transaction.m_count = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            std::unique_ptr<uint32_t[]>& bank = m_state->m_banks[registers[i].m_registerBank];
+            if (!bank)
+            {
+                bank.reset(new (std::nothrow) uint32_t[BankSize]());
+                if (!bank)
+                    continue;   // the register stays unknown
+            }
+
+            bank[registers[i].m_registerAddress] = EntryPending | (static_cast<uint32_t>(transactionID) << 8) | registers[i].m_registerValue;
+            transaction.m_registers[transaction.m_count++] = registers[i];
+        }
+    }
+
+    void Shadow::complete(uint8_t transactionID, bool isAccepted)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_state)
+            return;
+
+        Transaction& transaction = m_state->m_transactions[transactionID];
+        const uint32_t pendingEntryBits = EntryPending | (static_cast<uint32_t>(transactionID) << 8);
+
+        // From the end, the last write of a register repeated in the transaction is its value
+        for (size_t i = transaction.m_count; i-- > 0; )
+        {
+            uint32_t* entry = findEntry(transaction.m_registers[i]);
+
+            // A later transaction writing the same register decides its value
+            if ((entry == nullptr) || ((*entry & (EntryPending | 0xff00)) != pendingEntryBits))
+                continue;
+
+            *entry = isAccepted ? (EntryValid | transaction.m_registers[i].m_registerValue) : 0;
+        }
+
+        transaction.m_count = 0;
+    }
+
+    uint32_t* Shadow::findEntry(const trackHat_SetRegister_t& reg) const
+    {
+        const std::unique_ptr<uint32_t[]>& bank = m_state->m_banks[reg.m_registerBank];
+        return bank ? &bank[reg.m_registerAddress] : nullptr;
+    }
+
+} // namespace Registers
@@ -0,0 +1,87 @@
+// File:   track_hat_registers.h
+// Brief:  Values of the camera registers known to the driver
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _TRACK_HAT_REGISTERS_H_
+#define _TRACK_HAT_REGISTERS_H_
+
+#include "track_hat_types.h"
+
+#include <memory>
+#include <mutex>
+
+namespace Registers
+{
+
+    /**
+     * Copy of the register values acknowledged by the camera.
+     *
+     * A register is known after the ACK of the transaction that wrote it, as long as no later
+     * transaction wrote it again. Registers sent but not acknowledged yet, rejected or timed
+     * out are unknown, so they are always written. The memory is allocated when the shadow is
+     * enabled and for each register bank when it is used for the first time.
+     */
+    class Shadow
+    {
+    public:
+        Shadow() = default;
+
+        Shadow(const Shadow&) = delete;
+        Shadow& operator=(const Shadow&) = delete;
+
+        /* Enable or disable (and forget) the shadow */
+        void enable(bool enable);
+
+        bool isEnabled() const;
+
+        /* Forget all values, e.g. after the camera was reset */
+        void invalidate();
+
+        /**
+         * Remove the registers that already have the given value.
+         *
+         * \param[in/out]  registers   Registers to write, the order of the rest is kept.
+         * \param[in]      count       Number of registers.
+         *
+         * \return     Number of registers left.
+         */
+        size_t removeClean(trackHat_SetRegister_t* registers, size_t count);
+
+        /* Registers were sent in the transaction, their values are unknown until 'complete()' */
+        void send(uint8_t transactionID, const trackHat_SetRegister_t* registers, size_t count);
+
+        /* Result of the transaction is known, the values are stored if it was accepted */
+        void complete(uint8_t transactionID, bool isAccepted);
+
+    private:
+        static const size_t BankSize = 256;
+        static const size_t TransactionCount = 256;
+
+        // Entry of a register: value, ID of the last transaction writing it and the flags
+        static const uint32_t EntryValid = 0x10000;
+        static const uint32_t EntryPending = 0x20000;
+
+        /* Registers sent in a transaction */
+        struct Transaction
+        {
+            trackHat_SetRegister_t m_registers[MAX_NUMBER_OF_REGISTERS];
+            size_t                 m_count = 0;
+        };
+
+        struct State
+        {
+            std::unique_ptr<uint32_t[]> m_banks[BankSize];
+            Transaction                 m_transactions[TransactionCount];
+        };
+
+        /* Entry of the register, nullptr if its bank was never used */
+        uint32_t* findEntry(const trackHat_SetRegister_t& reg) const;
+
+        mutable std::mutex     m_mutex;
+        std::unique_ptr<State> m_state;    // nullptr when disabled
+    };
+
+} // namespace Registers
+
+#endif //_TRACK_HAT_REGISTERS_H_
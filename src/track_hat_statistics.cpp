@@ -0,0 +1,70 @@
+// File:   track_hat_statistics.cpp
+// Brief:  Counters of the data received from the TrackHat camera
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_statistics.h"
+
+namespace Statistics
+{
+
+    void Histogram::load(trackHat_Histogram_t& histogram) const
+    {
+        for (size_t i = 0; i < TRACK_HAT_HISTOGRAM_BINS; i++)
+            histogram.m_bins[i] = m_bins[i].load();
+        histogram.m_count = m_count.load();
+        histogram.m_sum = m_sum.load();
+    }
+
+    void Histogram::reset()
+    {
+        for (Counter& bin : m_bins)
+            bin.reset();
+        m_count.reset();
+        m_sum.reset();
+    }
+
+    void DeviceStatistics::load(trackHat_Statistics_t& statistics) const
+    {
+        // The counters are read one by one, so they may differ by the frames received meanwhile
+        statistics.m_receivedBytes = m_receivedBytes.load();
+        statistics.m_coordinatesFrames = m_coordinatesFrames.load();
+        statistics.m_extendedCoordinatesFrames = m_extendedCoordinatesFrames.load();
+        statistics.m_statusFrames = m_statusFrames.load();
+        statistics.m_deviceInfoFrames = m_deviceInfoFrames.load();
+        statistics.m_ackFrames = m_ackFrames.load();
+        statistics.m_nackFrames = m_nackFrames.load();
+        statistics.m_crcErrors = m_crcErrors.load();
+        statistics.m_unknownFrameIds = m_unknownFrameIds.load();
+        statistics.m_discardedBytes = m_discardedBytes.load();
+        statistics.m_nackBusy = m_nackBusy.load();
+        statistics.m_nackInvalidRequest = m_nackInvalidRequest.load();
+        statistics.m_nackOther = m_nackOther.load();
+        statistics.m_commandTimeouts = m_commandTimeouts.load();
+        m_readSize.load(statistics.m_readSize);
+        m_callbackLatencyUs.load(statistics.m_callbackLatencyUs);
+        m_commandRoundTripUs.load(statistics.m_commandRoundTripUs);
+    }
+
+    void DeviceStatistics::reset()
+    {
+        m_receivedBytes.reset();
+        m_coordinatesFrames.reset();
+        m_extendedCoordinatesFrames.reset();
+        m_statusFrames.reset();
+        m_deviceInfoFrames.reset();
+        m_ackFrames.reset();
+        m_nackFrames.reset();
+        m_crcErrors.reset();
+        m_unknownFrameIds.reset();
+        m_discardedBytes.reset();
+        m_nackBusy.reset();
+        m_nackInvalidRequest.reset();
+        m_nackOther.reset();
+        m_commandTimeouts.reset();
+        m_readSize.reset();
+        m_callbackLatencyUs.reset();
+        m_commandRoundTripUs.reset();
+    }
+
+} // namespace Statistics
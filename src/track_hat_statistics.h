@@ -0,0 +1,124 @@
+// File:   track_hat_statistics.h
+// Brief:  Counters of the data received from the TrackHat camera
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _TRACK_HAT_STATISTICS_H_
+#define _TRACK_HAT_STATISTICS_H_
+
+#include "track_hat_types.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Statistics
+{
+
+    /**
+     * Counter read from any thread. Most counters are updated only by the thread receiving the
+     * data of the device, so 'add()' does not need the atomic read-modify-write and costs as
+     * much as a plain addition. Counters updated by many threads use 'addConcurrent()'.
+     */
+    class Counter
+    {
+    public:
+        void add(uint64_t value = 1) { m_value.store(m_value.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); }
+
+        void addConcurrent(uint64_t value = 1) { m_value.fetch_add(value, std::memory_order_relaxed); }
+
+        uint64_t load() const { return m_value.load(std::memory_order_relaxed); }
+
+        void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value{0};
+    };
+
+    /* Values counted in power of two bins, see 'trackHat_Histogram_t' */
+    class Histogram
+    {
+    public:
+        void add(uint64_t value)
+        {
+            m_bins[binOf(value)].add();
+            m_count.add();
+            m_sum.add(value);
+        }
+
+        /* Add the value from one of many threads updating the histogram */
+        void addConcurrent(uint64_t value)
+        {
+            m_bins[binOf(value)].addConcurrent();
+            m_count.addConcurrent();
+            m_sum.addConcurrent(value);
+        }
+
+        void load(trackHat_Histogram_t& histogram) const;
+
+        void reset();
+
+    private:
+        /* Number of significant bits of the value, limited to the last bin */
+        static size_t binOf(uint64_t value)
+        {
+            size_t bin = 0;
+            while ((value != 0) && (bin < TRACK_HAT_HISTOGRAM_BINS - 1))
+            {
+                value >>= 1;
+                bin++;
+            }
+            return bin;
+        }
+
+        Counter m_bins[TRACK_HAT_HISTOGRAM_BINS];
+        Counter m_count;
+        Counter m_sum;
+    };
+
+    /* All counters of the device, see 'trackHat_Statistics_t' */
+    class DeviceStatistics
+    {
+    public:
+        Counter m_receivedBytes;
+        Counter m_coordinatesFrames;
+        Counter m_extendedCoordinatesFrames;
+        Counter m_statusFrames;
+        Counter m_deviceInfoFrames;
+        Counter m_ackFrames;
+        Counter m_nackFrames;
+        Counter m_crcErrors;
+        Counter m_unknownFrameIds;
+        Counter m_discardedBytes;
+        Counter m_nackBusy;
+        Counter m_nackInvalidRequest;
+        Counter m_nackOther;
+        Counter m_commandTimeouts;      // updated by the threads sending the commands
+        Histogram m_readSize;
+        Histogram m_callbackLatencyUs;  // updated by the callback and the subscriber threads
+        Histogram m_commandRoundTripUs;
+
+        /* Remember the time of sending for the round trip of the transaction */
+        void commandSent(uint8_t transactionID, uint64_t timestampUs)
+        {
+            m_commandSentUs[transactionID].store(timestampUs, std::memory_order_relaxed);
+        }
+
+        /* ACK or NACK of the transaction was received */
+        void commandAnswered(uint8_t transactionID, uint64_t timestampUs)
+        {
+            const uint64_t sentUs = m_commandSentUs[transactionID].load(std::memory_order_relaxed);
+            m_commandRoundTripUs.add((timestampUs > sentUs) ? (timestampUs - sentUs) : 0);
+        }
+
+        void load(trackHat_Statistics_t& statistics) const;
+
+        void reset();
+
+    private:
+        std::atomic<uint64_t> m_commandSentUs[256] = {};
+    };
+
+} // namespace Statistics
+
+#endif //_TRACK_HAT_STATISTICS_H_
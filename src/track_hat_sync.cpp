@@ -0,0 +1,145 @@
+// File:   track_hat_sync.cpp
+// Brief:  Portable thread synchronization primitives
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_sync.h"
+
+#include <chrono>
+
+namespace Sync
+{
+
+    Event::Event(bool manualReset) :
+        m_isManualReset(manualReset)
+    { }
+
+    void Event::set()
+    {
+        m_isSignalled.store(true);
+
+        if (m_waitingThreads.load() > 0)
+        {
+            // A waiter may have checked the flag but not be asleep yet. It holds the
+            // mutex until it sleeps, so taking the mutex here prevents a lost wake-up.
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+
+            if (m_isManualReset)
+                m_condition.notify_all();
+            else
+                m_condition.notify_one();
+        }
+    }
+
+    void Event::reset()
+    {
+        m_isSignalled.store(false);
+    }
+
+    bool Event::wait(uint32_t timeoutMs)
+    {
+        if (tryConsume())
+            return true;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_waitingThreads++;
+        bool result = m_condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return tryConsume(); });
+        m_waitingThreads--;
+
+        return result;
+    }
+
+    bool Event::tryConsume()
+    {
+        if (m_isManualReset)
+            return m_isSignalled.load();
+
+        bool expected = true;
+        return m_isSignalled.compare_exchange_strong(expected, false);
+    }
+
+
+    CompletionTable::CompletionTable()
+    {
+        for (std::atomic<uint32_t>& slot : m_slots)
+            slot.store(Idle, std::memory_order_relaxed);
+    }
+
+    void CompletionTable::start(uint8_t id)
+    {
+        if (m_slots[id].exchange(Pending) != Pending)
+            m_pendingCount++;
+    }
+
+    void CompletionTable::cancel(uint8_t id)
+    {
+        if (m_slots[id].exchange(Idle) == Pending)
+            m_pendingCount--;
+    }
+
+    bool CompletionTable::complete(uint8_t id, uint16_t result)
+    {
+        uint32_t expected = Pending;
+        if (!m_slots[id].compare_exchange_strong(expected, result))
+            return false;
+
+        m_pendingCount--;
+
+        if (m_waitingThreads.load() > 0)
+        {
+            // The same protection against a lost wake-up as in 'Event::set()'
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+
+            // Waiters of other IDs and of the pending count check them and sleep again
+            m_condition.notify_all();
+        }
+        return true;
+    }
+
+    bool CompletionTable::poll(uint8_t id, uint16_t& result)
+    {
+        const uint32_t state = m_slots[id].load();
+        if ((state == Idle) || (state == Pending))
+            return false;
+
+        m_slots[id].store(Idle);
+        result = static_cast<uint16_t>(state);
+        return true;
+    }
+
+    bool CompletionTable::wait(uint8_t id, uint32_t timeoutMs, uint16_t& result)
+    {
+        if (poll(id, result))
+            return true;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_waitingThreads++;
+            m_condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, id] { return m_slots[id].load() != Pending; });
+            m_waitingThreads--;
+        }
+
+        return poll(id, result);
+    }
+
+    bool CompletionTable::waitForPendingBelow(size_t limit, uint32_t timeoutMs)
+    {
+        if (m_pendingCount.load() < limit)
+            return true;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_waitingThreads++;
+        bool result = m_condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, limit] { return m_pendingCount.load() < limit; });
+        m_waitingThreads--;
+
+        return result;
+    }
+
+} // namespace Sync
@@ -0,0 +1,430 @@
+// File:   track_hat_sync.h
+// Brief:  Portable thread synchronization primitives
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _TRACK_HAT_SYNC_H_
+#define _TRACK_HAT_SYNC_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace Sync
+{
+
+    /**
+     * Event object with the semantic of the Win32 events.
+     *
+     * Manual-reset event stays signalled until 'reset()' is called. Auto-reset event
+     * releases a single waiter and returns to the non-signalled state.
+     *
+     * The state is an atomic flag, so 'set()' and 'reset()' do not lock anything when
+     * no thread is waiting. The mutex and the condition variable are used only to put
+     * the waiting threads to sleep.
+     */
+    class Event
+    {
+    public:
+        explicit Event(bool manualReset);
+
+        Event(const Event&) = delete;
+        Event& operator=(const Event&) = delete;
+
+        /* Signal the event */
+        void set();
+
+        /* Return the event to the non-signalled state */
+        void reset();
+
+        /**
+         * Wait for the event.
+         *
+         * \param[in]  timeoutMs   Maximum waiting time in ms.
+         *
+         * \return     true if the event was signalled or false after timeout.
+         */
+        bool wait(uint32_t timeoutMs);
+
+    private:
+        /* Check the state and clear it for the auto-reset event */
+        bool tryConsume();
+
+        std::mutex              m_mutex;
+        std::condition_variable m_condition;
+        std::atomic<uint32_t>   m_waitingThreads{0};
+        std::atomic<bool>       m_isSignalled{false};
+        const bool              m_isManualReset;
+    };
+
+
+    /**
+     * Snapshot of a value with a single writer protected by a sequence lock.
+     *
+     * The writer never blocks. Readers copy the value and retry if the writer modified it
+     * in the meantime, so they always get a consistent copy without any lock or system call.
+     * The value is kept as relaxed atomic words to make the concurrent copy well defined.
+     */
+    template<typename T>
+    class SeqLock
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires trivially copyable type");
+
+    public:
+        SeqLock()
+        {
+            for (size_t i = 0; i < WordCount; i++)
+                m_data[i].store(0, std::memory_order_relaxed);
+        }
+
+        SeqLock(const SeqLock&) = delete;
+        SeqLock& operator=(const SeqLock&) = delete;
+
+        /* Publish a new value (only one thread may write) */
+        void store(const T& value)
+        {
+            uint64_t words[WordCount] = {};
+            ::memcpy(words, &value, sizeof(T));
+
+            const uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t i = 0; i < WordCount; i++)
+                m_data[i].store(words[i], std::memory_order_relaxed);
+
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        /* Copy the last published value */
+        void load(T& value) const
+        {
+            uint64_t words[WordCount];
+            uint32_t sequenceBefore;
+            uint32_t sequenceAfter;
+
+            do
+            {
+                sequenceBefore = m_sequence.load(std::memory_order_acquire);
+
+                for (size_t i = 0; i < WordCount; i++)
+                    words[i] = m_data[i].load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                sequenceAfter = m_sequence.load(std::memory_order_relaxed);
+            } while ((sequenceBefore & 1) || (sequenceBefore != sequenceAfter));
+
+            ::memcpy(&value, words, sizeof(T));
+        }
+
+    private:
+        static const size_t WordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t> m_sequence{0};
+        std::atomic<uint64_t> m_data[WordCount];
+    };
+
+
+    /**
+     * Bounded lock-free queue with a single producer and a single consumer.
+     *
+     * The queue is empty and disabled until 'resize()' is called. When the queue is full the
+     * producer drops the new value and counts it, so the consumer always gets the oldest
+     * values in order and sees the drops in 'overflowCount()'.
+     */
+    template<typename T>
+    class SpscQueue
+    {
+    public:
+        SpscQueue() = default;
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * Allocate place for 'capacity' values (rounded up to a power of two) and clear the queue.
+         *
+         * Note: Must not be called while the producer or the consumer is running.
+         *
+         * \param[in]  capacity   Number of values, '0' disables the queue.
+         */
+        void resize(size_t capacity)
+        {
+            size_t size = 0;
+            if (capacity > 0)
+            {
+                size = 1;
+                while (size < capacity)
+                    size <<= 1;
+            }
+
+            m_buffer.reset(size > 0 ? new T[size] : nullptr);
+            m_capacity = size;
+            clear();
+        }
+
+        /* Drop all values and reset the overflow counter (the producer must not be running) */
+        void clear()
+        {
+            m_tail.store(m_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            m_overflowCount.store(0, std::memory_order_relaxed);
+        }
+
+        /* Add a value (producer only), returns false if the queue is full or disabled */
+        bool push(const T& value)
+        {
+            if (m_capacity == 0)
+                return false;
+
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) >= m_capacity)
+            {
+                m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            m_buffer[head & (m_capacity - 1)] = value;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /* Move up to 'maxCount' oldest values to 'output' (consumer only), returns their number */
+        size_t pop(T* output, size_t maxCount)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t count = m_head.load(std::memory_order_acquire) - tail;
+            if (count > maxCount)
+                count = maxCount;
+
+            for (size_t i = 0; i < count; i++)
+                output[i] = m_buffer[(tail + i) & (m_capacity - 1)];
+
+            m_tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        /* Number of values waiting in the queue */
+        size_t size() const
+        {
+            return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const { return m_capacity; }
+
+        /* Number of values dropped because the queue was full */
+        uint64_t overflowCount() const { return m_overflowCount.load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<T[]> m_buffer;
+        size_t               m_capacity = 0;
+
+        // Indexes grow without wrapping to the capacity, each one on its own cache line. The
+        // padding keeps the default alignment, 'alignas' would need the aligned 'new' of C++17
+        static const size_t CacheLineSize = 64;
+
+        char                  m_headPadding[CacheLineSize];
+        std::atomic<size_t>   m_head{0};
+        char                  m_tailPadding[CacheLineSize - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t>   m_tail{0};
+        char                  m_overflowPadding[CacheLineSize - sizeof(std::atomic<size_t>)];
+        std::atomic<uint64_t> m_overflowCount{0};
+        char                  m_endPadding[CacheLineSize - sizeof(std::atomic<uint64_t>)];
+    };
+
+
+    /**
+     * Values of a single writer delivered to many readers, each one at its own pace.
+     *
+     * The writer stores every value once in a ring of 'Capacity' slots protected by sequence
+     * locks and numbers the values with a growing index. Readers keep their own index and copy
+     * the values without any lock, so a slow reader delays neither the writer nor the other
+     * readers. A reader more than 'Capacity' values behind loses the oldest ones. The writer
+     * wakes up the waiting readers as 'Event' does, nothing is locked when nobody waits.
+     *
+     * The slots are allocated by 'allocate()', before that only the index grows.
+     */
+    template<typename T, size_t Capacity>
+    class BroadcastRing
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "BroadcastRing capacity must be a power of two");
+
+    public:
+        BroadcastRing() = default;
+        ~BroadcastRing() { delete[] m_slots.load(std::memory_order_relaxed); }
+
+        BroadcastRing(const BroadcastRing&) = delete;
+        BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+        /* Allocate the slots once, safe while the writer runs (only one thread may call it) */
+        bool allocate()
+        {
+            if (m_slots.load(std::memory_order_acquire) != nullptr)
+                return true;
+
+            SeqLock<T>* slots = new (std::nothrow) SeqLock<T>[Capacity];
+            m_slots.store(slots, std::memory_order_release);
+            return slots != nullptr;
+        }
+
+        /* Store the next value and wake up the readers (only one thread may write) */
+        void publish(const T& value)
+        {
+            const uint64_t index = m_writeIndex.load(std::memory_order_relaxed);
+
+            SeqLock<T>* slots = m_slots.load(std::memory_order_acquire);
+            if (slots != nullptr)
+            {
+                // A reader which copied any part of the new value sees the slot as reused
+                m_claimIndex.store(index + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                slots[index & (Capacity - 1)].store(value);
+            }
+
+            m_writeIndex.store(index + 1);
+
+            if (m_waitingReaders.load() > 0)
+            {
+                { std::lock_guard<std::mutex> lock(m_mutex); }
+                m_condition.notify_all();
+            }
+        }
+
+        /* Check if the slots are allocated, i.e. if the values may have readers */
+        bool isAllocated() const { return m_slots.load(std::memory_order_acquire) != nullptr; }
+
+        /* Index of the next value, i.e. the number of published values */
+        uint64_t writeIndex() const { return m_writeIndex.load(); }
+
+        /**
+         * Copy the value with the given index.
+         *
+         * \return     false if the value is not published yet or its slot was already reused.
+         */
+        bool read(uint64_t index, T& value) const
+        {
+            const uint64_t writeIndex = m_writeIndex.load();
+            if ((index >= writeIndex) || (writeIndex - index > Capacity))
+                return false;
+
+            const SeqLock<T>* slots = m_slots.load(std::memory_order_acquire);
+            if (slots == nullptr)
+                return false;
+
+            slots[index & (Capacity - 1)].load(value);
+            return m_claimIndex.load(std::memory_order_relaxed) - index <= Capacity;
+        }
+
+        /**
+         * Wait until the value with the given index is published.
+         *
+         * \return     true if it was published or false after timeout.
+         */
+        bool wait(uint64_t index, uint32_t timeoutMs)
+        {
+            if (m_writeIndex.load() > index)
+                return true;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_waitingReaders++;
+            const bool isPublished = m_condition.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                                          [&]() { return m_writeIndex.load() > index; });
+            m_waitingReaders--;
+            return isPublished;
+        }
+
+    private:
+        std::atomic<SeqLock<T>*> m_slots{nullptr};
+        std::atomic<uint64_t>    m_claimIndex{0};    // index + 1 of the value being written
+        std::atomic<uint64_t>    m_writeIndex{0};
+        std::atomic<uint32_t>    m_waitingReaders{0};
+        std::mutex               m_mutex;
+        std::condition_variable  m_condition;
+    };
+
+
+    /**
+     * Results of the operations identified by an 8-bit ID, e.g. the transaction ID of a command.
+     *
+     * The requesting thread calls 'start()' before the operation is sent and 'wait()' for its
+     * result. Another thread stores the result with 'complete()', which wakes up the waiter
+     * at once. As in 'Event' nothing is locked when no thread is waiting.
+     */
+    class CompletionTable
+    {
+    public:
+        static const size_t Size = 256;
+
+        CompletionTable();
+
+        CompletionTable(const CompletionTable&) = delete;
+        CompletionTable& operator=(const CompletionTable&) = delete;
+
+        /* Wait for the result of the operation, the previous result of the ID is dropped */
+        void start(uint8_t id);
+
+        /* Drop the operation, e.g. when it could not be sent */
+        void cancel(uint8_t id);
+
+        /**
+         * Store the result of the started operation and wake up its waiter.
+         *
+         * \return     false if the operation was not started (unexpected or late result).
+         */
+        bool complete(uint8_t id, uint16_t result);
+
+        /**
+         * Get the result without waiting. The slot is released if the result is available.
+         *
+         * \return     true if the result was stored.
+         */
+        bool poll(uint8_t id, uint16_t& result);
+
+        /**
+         * Wait for the result of the started operation. The slot is released if the result
+         * is available, after the timeout the operation is still pending.
+         *
+         * \param[in]  id          ID given to 'start()'.
+         * \param[in]  timeoutMs   Maximum waiting time in ms.
+         * \param[out] result      Value given to 'complete()'.
+         *
+         * \return     true if the result was stored or false after timeout.
+         */
+        bool wait(uint8_t id, uint32_t timeoutMs, uint16_t& result);
+
+        /**
+         * Wait until less than 'limit' operations are pending.
+         *
+         * \return     false after timeout.
+         */
+        bool waitForPendingBelow(size_t limit, uint32_t timeoutMs);
+
+        /* Operation was started and its result is not stored yet */
+        bool isPending(uint8_t id) const { return m_slots[id].load() == Pending; }
+
+        /* Operation was not started or its result was already taken */
+        bool isIdle(uint8_t id) const { return m_slots[id].load() == Idle; }
+
+        /* Number of started operations without the result */
+        size_t pendingCount() const { return m_pendingCount.load(); }
+
+    private:
+        // Slot states besides the 16-bit results
+        static const uint32_t Idle = 0x10000;
+        static const uint32_t Pending = 0x20000;
+
+        std::atomic<uint32_t>   m_slots[Size];
+        std::mutex              m_mutex;
+        std::condition_variable m_condition;
+        std::atomic<uint32_t>   m_waitingThreads{0};
+        std::atomic<size_t>     m_pendingCount{0};
+    };
+
+} // namespace Sync
+
+#endif //_TRACK_HAT_SYNC_H_
@@ -12,6 +12,7 @@
   {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 const size_t MAX_NUMBER_OF_REGISTERS = 19;
@@ -31,7 +32,8 @@ enum TH_ErrorCode
     TH_ERROR_CAMERA_SELF_TEST_FAILED = -9,
     TH_ERROR_WRONG_PARAMETER = -10,
     TH_MEMORY_ALLOCATION_FAILED = -11,
-    TH_FAILED_TO_SET_REGISTER = -12
+    TH_FAILED_TO_SET_REGISTER = -12,
+    TH_TRANSACTION_PENDING = -13          /* Response to the command has not arrived yet */
 };
 
 enum TH_FrameType
@@ -58,6 +60,10 @@ enum TH_LedState
 /* Maximum number of points detected by TrackHat camera. */
 #define TRACK_HAT_NUMBER_OF_POINTS 16
 
+/* Maximum length of the port name and the USB serial number, with the terminating null. */
+#define TRACK_HAT_PORT_NAME_SIZE 64
+#define TRACK_HAT_USB_SERIAL_NUMBER_SIZE 64
+
 /* TrackHat device instance. */
 typedef struct
 {
@@ -70,6 +76,13 @@ typedef struct
     TH_FrameType m_frameType;
 } trackHat_Device_t;
 
+/* TrackHat found by 'trackHat_EnumerateDevices()'. */
+typedef struct
+{
+    char m_portName[TRACK_HAT_PORT_NAME_SIZE];                 /* e.g. "/dev/ttyACM0" or "\\.\COM3" */
+    char m_usbSerialNumber[TRACK_HAT_USB_SERIAL_NUMBER_SIZE];  /* USB descriptor string, empty if not available */
+} trackHat_DetectedDevice_t;
+
 /* TrackHat single point. */
 typedef struct
 {
@@ -82,11 +95,14 @@ typedef struct
 typedef struct
 {
     trackHat_Point_t m_point[TRACK_HAT_NUMBER_OF_POINTS];
+    uint64_t m_timestampUs;   /* Arrival time of the frame, see 'trackHat_GetTimestampUs()' */
+    uint32_t m_frameNumber;   /* Number of the frame received since connection */
 } trackHat_Points_t;
 
 
-/* TrackHat single extended point. */
-#pragma pack()
+/* TrackHat single extended point as sent by the camera, 16 bytes with little-endian values.
+ * The order of 'm_range' and 'm_radius' in the byte depends on the compiler, on the wire
+ * the range is the low nibble. */
 typedef struct trackHat_ExtendedPointRaw_t
 {
     uint8_t m_areaLow;
@@ -129,17 +145,220 @@ typedef struct trackHat_ExtendedPoint_t
 } trackHat_ExtendedPoint_t;
 
 /* TrackHat set of points. */
-#pragma pack()
 typedef struct
 {
     trackHat_ExtendedPoint_t m_point[TRACK_HAT_NUMBER_OF_POINTS];
+    uint64_t m_timestampUs;   /* Arrival time of the frame, see 'trackHat_GetTimestampUs()' */
+    uint32_t m_frameNumber;   /* Number of the frame received since connection */
 } trackHat_ExtendedPoints_t;
 
+/* TrackHat set of extended points as received, read with 'trackHat_RawPoint*()' without decoding. */
+typedef struct
+{
+    trackHat_ExtendedPointRaw_t m_point[TRACK_HAT_NUMBER_OF_POINTS];   /* Empty slots have all bytes zero */
+    uint64_t m_timestampUs;   /* Arrival time of the frame, see 'trackHat_GetTimestampUs()' */
+    uint32_t m_frameNumber;   /* Number of the frame received since connection */
+} trackHat_ExtendedPointsRaw_t;
+
+/* Coordinates of the extended points have 14 bits */
+#define TRACK_HAT_EXTENDED_COORDINATE_MASK 0x3fff
+
+/* Offset of the byte with the range (low nibble) and the radius (high nibble) in the raw point */
+#define TRACK_HAT_RAW_RANGE_RADIUS_OFFSET 8
+
+/* Fields of the raw extended point with the values of 'trackHat_ExtendedPoint_t', each one
+ * decoded only when read. The other fields are single bytes and are read directly. */
+static inline uint16_t trackHat_RawPointArea(const trackHat_ExtendedPointRaw_t* point)
+{
+    return (uint16_t)(point->m_areaLow | (point->m_areaHigh << 8));
+}
+
+static inline uint16_t trackHat_RawPointX(const trackHat_ExtendedPointRaw_t* point)
+{
+    return (uint16_t)((point->m_coordinateXLow | (point->m_coordinateXHigh << 8)) & TRACK_HAT_EXTENDED_COORDINATE_MASK);
+}
+
+static inline uint16_t trackHat_RawPointY(const trackHat_ExtendedPointRaw_t* point)
+{
+    return (uint16_t)((point->m_coordinateYLow | (point->m_coordinateYHigh << 8)) & TRACK_HAT_EXTENDED_COORDINATE_MASK);
+}
+
+/* 'm_range' and 'm_radius' are bitfields of the compiler's order, the wire byte is read instead */
+static inline uint8_t trackHat_RawPointRange(const trackHat_ExtendedPointRaw_t* point)
+{
+    return (uint8_t)(((const uint8_t*)point)[TRACK_HAT_RAW_RANGE_RADIUS_OFFSET] & 0x0f);
+}
+
+static inline uint8_t trackHat_RawPointRadius(const trackHat_ExtendedPointRaw_t* point)
+{
+    return (uint8_t)(((const uint8_t*)point)[TRACK_HAT_RAW_RANGE_RADIUS_OFFSET] >> 4);
+}
+
+/* Check if the point is detected, the empty slots have all bytes zero */
+static inline int trackHat_RawPointIsDetected(const trackHat_ExtendedPointRaw_t* point)
+{
+    const uint8_t* bytes = (const uint8_t*)point;
+    uint8_t any = 0;
+    for (size_t i = 0; i < sizeof(trackHat_ExtendedPointRaw_t); i++)
+        any |= bytes[i];
+    return any != 0;
+}
+
+/* TrackHat set of points as separate arrays, e.g. for vectorized processing. */
+typedef struct
+{
+    uint16_t m_x[TRACK_HAT_NUMBER_OF_POINTS];
+    uint16_t m_y[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_brightness[TRACK_HAT_NUMBER_OF_POINTS];
+    uint64_t m_timestampUs;   /* Arrival time of the frame, see 'trackHat_GetTimestampUs()' */
+    uint32_t m_frameNumber;   /* Number of the frame received since connection */
+} trackHat_PointsSoA_t;
+
+/* TrackHat set of extended points as separate arrays, the fields as in 'trackHat_ExtendedPoint_t'. */
+typedef struct
+{
+    uint16_t m_area[TRACK_HAT_NUMBER_OF_POINTS];
+    uint16_t m_coordinateX[TRACK_HAT_NUMBER_OF_POINTS];
+    uint16_t m_coordinateY[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_averageBrightness[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_maximumBrightness[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_range[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_radius[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_boundryLeft[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_boundryRigth[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_boundryUp[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_boundryDown[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_aspectRatio[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_vx[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t  m_vy[TRACK_HAT_NUMBER_OF_POINTS];
+    uint64_t m_timestampUs;
+    uint32_t m_frameNumber;
+} trackHat_ExtendedPointsSoA_t;
+
+/* Point of 'trackHat_CompactPoints_t' with its slot in the frame. */
+typedef struct
+{
+    trackHat_Point_t m_point;
+    uint8_t  m_index;         /* Slot of the point in 'trackHat_Points_t', 0 to TRACK_HAT_NUMBER_OF_POINTS - 1 */
+} trackHat_CompactPoint_t;
+
+/* TrackHat set of points without the empty slots (all fields zero). */
+typedef struct
+{
+    trackHat_CompactPoint_t m_point[TRACK_HAT_NUMBER_OF_POINTS];   /* Only the first 'm_count' are valid */
+    uint32_t m_count;         /* Number of the detected points */
+    uint64_t m_timestampUs;   /* Arrival time of the frame, see 'trackHat_GetTimestampUs()' */
+    uint32_t m_frameNumber;   /* Number of the frame received since connection */
+} trackHat_CompactPoints_t;
+
+/* Extended point of 'trackHat_CompactExtendedPoints_t' with its slot in the frame. */
+typedef struct
+{
+    trackHat_ExtendedPoint_t m_point;
+    uint8_t  m_index;         /* Slot of the point in 'trackHat_ExtendedPoints_t' */
+} trackHat_CompactExtendedPoint_t;
+
+/* TrackHat set of extended points without the empty slots (all fields zero). */
+typedef struct
+{
+    trackHat_CompactExtendedPoint_t m_point[TRACK_HAT_NUMBER_OF_POINTS];   /* Only the first 'm_count' are valid */
+    uint32_t m_count;
+    uint64_t m_timestampUs;
+    uint32_t m_frameNumber;
+} trackHat_CompactExtendedPoints_t;
+
+/* State of the frame queues, see 'trackHat_EnableFrameQueue()'. */
+typedef struct
+{
+    uint32_t m_depth;                    /* Capacity of each queue, 0 if disabled */
+    uint32_t m_pendingPoints;            /* Basic frames waiting in the queue */
+    uint32_t m_pendingExtendedPoints;    /* Extended frames waiting in the queue */
+    uint64_t m_droppedPoints;            /* Basic frames dropped since connection, queue was full */
+    uint64_t m_droppedExtendedPoints;    /* Extended frames dropped since connection, queue was full */
+} trackHat_FrameQueueStatus_t;
+
+/* Maximum number of subscriptions of a device, see 'trackHat_Subscribe()' */
+#define TRACK_HAT_MAX_SUBSCRIPTIONS 8
+
+/* Maximum number of sets of points waiting for a subscriber */
+#define TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH 64
+
+/* Which sets of points are passed to a subscriber. */
+enum TH_DeliveryPolicy
+{
+    TH_DELIVER_LATEST = 0,        /* Only the newest set of points, the older ones are skipped */
+    TH_DELIVER_EVERY_FRAME = 1,   /* Every set of points in order, the oldest are dropped when the queue is full */
+    TH_DELIVER_DECIMATED = 2,     /* Every 'm_decimation'-th set of points, as TH_DELIVER_EVERY_FRAME */
+};
+
+/* Configuration of a subscription, see 'trackHat_Subscribe()'. */
+typedef struct
+{
+    TH_DeliveryPolicy m_policy;
+    uint32_t m_queueDepth;        /* Sets of points kept for the subscriber, 1 to TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH */
+    uint32_t m_decimation;        /* For TH_DELIVER_DECIMATED, at least 1 */
+} trackHat_SubscriptionConfig_t;
+
+/* Number of bins of 'trackHat_Histogram_t' */
+#define TRACK_HAT_HISTOGRAM_BINS 24
+
+/**
+ * Distribution of values in power of two ranges: bin 0 counts the value 0, bin 'i' the values
+ * from 2^(i-1) to 2^i - 1 and the last bin all greater values.
+ */
+typedef struct
+{
+    uint64_t m_bins[TRACK_HAT_HISTOGRAM_BINS];
+    uint64_t m_count;                    /* Number of values */
+    uint64_t m_sum;                      /* Sum of the values, for the mean */
+} trackHat_Histogram_t;
+
+/* Counters of the device since 'trackHat_Initialize()' or 'trackHat_ResetStatistics()'. */
+typedef struct
+{
+    uint64_t m_receivedBytes;            /* Bytes read from the port */
+    uint64_t m_coordinatesFrames;        /* Valid frames of each type */
+    uint64_t m_extendedCoordinatesFrames;
+    uint64_t m_statusFrames;
+    uint64_t m_deviceInfoFrames;
+    uint64_t m_ackFrames;
+    uint64_t m_nackFrames;
+    uint64_t m_crcErrors;                /* Frames with a known ID and wrong CRC */
+    uint64_t m_unknownFrameIds;          /* Bytes which are not the ID of any frame */
+    uint64_t m_discardedBytes;           /* Bytes skipped to find the next frame, after both errors */
+    uint64_t m_nackBusy;                 /* NACK frames by the reason */
+    uint64_t m_nackInvalidRequest;
+    uint64_t m_nackOther;
+    uint64_t m_commandTimeouts;          /* Commands without ACK or NACK in time */
+    trackHat_Histogram_t m_readSize;             /* Bytes returned by each read of the port */
+    trackHat_Histogram_t m_callbackLatencyUs;    /* From receiving the points to calling the callback or a subscriber */
+    trackHat_Histogram_t m_commandRoundTripUs;   /* From sending the command to receiving ACK or NACK */
+} trackHat_Statistics_t;
+
+/* Configuration of the simulated device, see 'trackHat_DetectMockDevice()'. */
+typedef struct
+{
+    uint32_t m_frameRateHz;              /* Sets of points per second, 0 to send them as fast as they are read */
+    uint32_t m_jitterUs;                 /* Maximum random delay of every set of points */
+    uint32_t m_corruptedFramesPerMille;  /* Sets of points with a damaged bit, in 1/1000 */
+    uint32_t m_nackPerMille;             /* Commands rejected with NACK, in 1/1000 */
+    uint32_t m_seed;                     /* Seed of the random generator, the same seed gives the same data */
+    uint32_t m_serialNumber;             /* Serial number reported by the device */
+} trackHat_MockConfig_t;
+
 /**
  * Declaration type of callback to call after receiving new points from the TrackHat device.
  */
 typedef void (*trackHat_PointsCallback_t)(TH_ErrorCode error, const trackHat_Points_t* const points);
 typedef void (*trackHat_ExtendedPointsCallback_t)(TH_ErrorCode error, const trackHat_ExtendedPoints_t* const points);
+typedef void (*trackHat_CompactPointsCallback_t)(TH_ErrorCode error, const trackHat_CompactPoints_t* const points);
+typedef void (*trackHat_CompactExtendedPointsCallback_t)(TH_ErrorCode error, const trackHat_CompactExtendedPoints_t* const points);
+
+/**
+ * Declaration type of subscriber called with the 'context' given to 'trackHat_Subscribe()'.
+ */
+typedef void (*trackHat_PointsSubscriber_t)(void* context, TH_ErrorCode error, const trackHat_Points_t* const points);
+typedef void (*trackHat_ExtendedPointsSubscriber_t)(void* context, TH_ErrorCode error, const trackHat_ExtendedPoints_t* const points);
 
 typedef struct trackHat_SetRegister_t
 {
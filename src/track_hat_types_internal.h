@@ -6,9 +6,16 @@
 #ifndef _TRACK_HAT_TYPES_INTERNAL_H_
 #define _TRACK_HAT_TYPES_INTERNAL_H_
 
+#include "track_hat_capture.h"
 #include "track_hat_messages.h"
+#include "track_hat_registers.h"
+#include "track_hat_statistics.h"
 #include "usb_serial.h"
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 /* TrackHat camera USB IDs */
 #define TRACK_HAT_USB_VENDOR_ID      0x0483
 #define TRACK_HAT_USB_PRODUCT_ID     0x5740
@@ -16,11 +23,20 @@
 /* Maximum time for new message events in ms */
 #define MESSAGE_EVENT_TIMEOUT_MS  2000
 
+/* Maximum time for ACK or NACK of a command in ms */
+#define RESPONSE_TIMEOUT_MS  100
+
+/* Maximum number of commands waiting for ACK or NACK at the same time */
+#define MAX_TRANSACTIONS_IN_FLIGHT  16
+
+/* Time without new points in ms after which the callbacks are checked for errors */
+#define CALLBACK_WAIT_TIMEOUT_MS  100
+
 /* Size of the buffer for messages to transmit */
 #define MESSAGE_TX_BUFFER_SIZE  64
 
 /* Size of the buffer for messages to receive */
-#define MESSAGE_RX_BUFFER_SIZE  256
+#define MESSAGE_RX_BUFFER_SIZE  1024
 
 
 /* Structure for the last messages received from the TrackHat camera. */
@@ -29,18 +45,17 @@ typedef struct trackHat_Messages_t
     MessageStatus              m_status;
     MessageDeviceInfo          m_deviceInfo;
     MessageCoordinates         m_coordinates;
-    MessageNACK                m_nack;
     MessageExtendedCoordinates m_extendedCoordinates;
-    uint8_t                    m_lastACKTransactionId = 0;
+    Sync::CompletionTable      m_transactions;   // ACK or NACK of the commands, see 'TransactionResult'
+    Statistics::DeviceStatistics m_statistics;   // counted while parsing, see 'trackHat_GetStatistics()'
 } trackHat_Messages_t;
 
 
 /* Structure for the data receiving thread. */
 typedef struct trackHat_Thread_t
 {
-    HANDLE  m_threadHandler = NULL;
-    DWORD   m_threadID = 0;
-    bool    m_isRunning = false;
+    std::thread       m_threadHandler;
+    std::atomic<bool> m_isRunning{false};
 } trackHat_Thread_t;
 
 
@@ -50,20 +65,44 @@ typedef struct trackHat_Callback_t
     trackHat_Thread_t m_thread;
     trackHat_PointsCallback_t m_simplePointsCallbackFunction = nullptr;
     trackHat_ExtendedPointsCallback_t m_extendedPointsCallbackFunction = nullptr;
-    HANDLE m_mutex = nullptr;
+    trackHat_CompactPointsCallback_t m_compactPointsCallbackFunction = nullptr;
+    trackHat_CompactExtendedPointsCallback_t m_compactExtendedPointsCallbackFunction = nullptr;
+    std::mutex m_mutex;
+    std::atomic<bool> m_isInlinePointsReceived{false};   /* Points passed to the callback by the receiver */
 } trackHat_Callback_t;
 
 
+/* Subscriber of the points with its own delivery thread, see 'trackHat_Subscribe()'. */
+typedef struct trackHat_Subscription_t
+{
+    trackHat_Thread_t m_thread;                  /* Not joinable when the subscription is free */
+    trackHat_SubscriptionConfig_t m_config = {};
+    trackHat_PointsSubscriber_t m_pointsFunction = nullptr;                   /* One of the functions is set */
+    trackHat_ExtendedPointsSubscriber_t m_extendedPointsFunction = nullptr;
+    void* m_context = nullptr;
+} trackHat_Subscription_t;
+
+
 /* TrackHat device internal instance. */
 typedef struct trackHat_Internal_t
 {
     usbSerial_t         m_serial;
     trackHat_Thread_t   m_receiver;
     trackHat_Callback_t m_callback;
+    trackHat_Subscription_t m_subscriptions[TRACK_HAT_MAX_SUBSCRIPTIONS];
+    std::mutex m_subscriptionMutex;              /* Subscribing and unsubscribing */
     trackHat_Messages_t m_messages;
-    bool m_isOpen = false;
-    bool m_isUnplugged = false;  /* Was connected, is disconnected */
-    TH_FrameType m_frameType;
+    Capture::Recorder   m_recorder;
+    std::atomic<bool> m_isOpen{false};
+    std::atomic<bool> m_isUnplugged{false};  /* Was connected, is disconnected */
+    std::atomic<TH_FrameType> m_frameType{TH_FRAME_BASIC};
+    std::atomic<uint8_t> m_transactionID{255};  /* Next transaction ID of the device */
+    std::mutex m_commandMutex;                   /* Sending of the commands waiting for ACK or NACK */
+    std::atomic<uint64_t> m_transactionDeadlineUs[Sync::CompletionTable::Size] = {};  /* Timeout of each transaction ID */
+    Registers::Shadow m_registerShadow;          /* Acknowledged register values, see 'trackHat_EnableRegisterCache()' */
+    bool m_useSharedReceiver = false;            /* Receive on the reactor thread, see 'trackHat_EnableSharedReceiver()' */
+    bool m_isAttachedToReactor = false;          /* Data is received by 'Reactor' instead of own threads */
+    bool m_useInlineCallbacks = false;           /* Call the callbacks on the receiver, see 'trackHat_EnableInlineCallbacks()' */
 } trackHat_Internal_t;
 
 
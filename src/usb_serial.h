@@ -8,37 +8,113 @@
 
 #include "track_hat_types.h"
 
+#include <memory>
 #include <stdint.h>
-#include <windows.h>
+#include <vector>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <termios.h>
+#endif
+
+
+/* Maximum length of the serial port file name */
+#define USB_SERIAL_FILE_NAME_SIZE TRACK_HAT_PORT_NAME_SIZE
+
+/* Maximum length of the USB serial number string */
+#define USB_SERIAL_NUMBER_SIZE TRACK_HAT_USB_SERIAL_NUMBER_SIZE
+
+
+namespace UsbSerial {
+
+    /**
+     * Source of the data used instead of the serial port, e.g. the mock device.
+     *
+     * The methods have the same meaning as the 'UsbSerial' functions with the same names,
+     * which call them when 'usbSerial_t::m_transport' is set.
+     */
+    class Transport
+    {
+    public:
+        virtual ~Transport() = default;
+
+        virtual TH_ErrorCode open() = 0;
+        virtual TH_ErrorCode close() = 0;
+        virtual TH_ErrorCode write(const uint8_t* buffer, size_t size) = 0;
+        virtual TH_ErrorCode read(uint8_t* buffer, size_t maxSize, size_t& readSizeOutput) = 0;
+        virtual void wakeup() = 0;
+    };
+
+} // namespace UsbSerial
 
 
 /* Structure for serial port suppoer */
 typedef struct usbSerial_t
 {
+    char     m_comFileName[USB_SERIAL_FILE_NAME_SIZE] = {}; // Port file name, e.g. "\\.\COM3" or "/dev/ttyACM0"
+    bool     m_isDetected = false;  // Port was found by 'UsbSerial::detect()'
+    bool     m_isPortOpen = false;  // Port is open or close
+    std::unique_ptr<UsbSerial::Transport> m_transport; // Used instead of the port if set
+    void*    m_pollerContext = nullptr;  // Returned by 'Poller::wait()' for this port
+    uint8_t* m_pollerBuffer = nullptr;   // Buffer of the read started by 'Poller::startRead()'
+    size_t   m_pollerBufferSize = 0;
+#if defined(_WIN32)
     uint16_t m_comNumber = 0;       // Number of COM port
-    char     m_comFileName[20];     // Contain Windows friendly name
-    HANDLE   m_comHandler = 0;          // Handle to the serial port
+    HANDLE   m_comHandler = 0;      // Handle to the serial port (overlapped I/O)
+    HANDLE   m_readEvent = NULL;    // Completion of the pending read
+    HANDLE   m_writeEvent = NULL;   // Completion of the pending write
+    HANDLE   m_wakeupEvent = NULL;  // Interrupts the pending read
     COMMTIMEOUTS m_timeouts;        // Initializing timeouts structure
-    bool     m_isPortOpen = false;  // Port is open or close
+    OVERLAPPED m_pollerOverlapped = {};    // Read started by 'Poller::startRead()'
+    bool     m_isPollerReadPending = false;
+    bool     m_isPollerReadFailed = false; // ReadFile failed, reported by the next 'Poller::wait()'
+#else
+    int      m_comHandler = -1;     // File descriptor of the tty device
+    int      m_wakeupHandler[2] = { -1, -1 }; // Pipe interrupting the pending read
+    struct termios m_previousSettings; // Settings restored when the port is closed
+#endif
 } usbSerial_t;
 
+/* Serial port found by 'UsbSerial::enumerate()' */
+typedef struct usbSerialPort_t
+{
+    char m_comFileName[USB_SERIAL_FILE_NAME_SIZE] = {};   // Port file name, as in 'usbSerial_t'
+    char m_serialNumber[USB_SERIAL_NUMBER_SIZE] = {};     // USB iSerialNumber string, empty if not available
+} usbSerialPort_t;
+
 namespace UsbSerial {
 
     /**
-     * Get COM port number witf specyfic vendor ID and product ID.
+     * Find serial ports of all USB devices with specyfic vendor ID and product ID.
      *
-     * Note: This function returns only one COM port but is able to detect all COM ports
-     * with specyfic vendor ID and product ID (for future expansion possibilities).
+     * On Windows the ports are searched with SetupAPI, on Linux the CDC-ACM ttys are matched
+     * with the USB IDs published in sysfs. The ports are sorted by their number, so the
+     * order is the same as long as the devices are not replugged.
      *
      * \param[in]  vendorId   USB vendor ID.
      * \param[in]  productId  USB product ID.
      *
-     * \return     Number of COM or '0' if not found
+     * \return     Detected ports, empty if none.
+     */
+    std::vector<usbSerialPort_t> enumerate(uint16_t vendorId, uint16_t productId);
+
+    /**
+     * Find serial port of the USB device with specyfic vendor ID and product ID and store
+     * its name in 'serial'.
+     *
+     * \param[in/out]  serial       Structure of 'usbSerial_t'.
+     * \param[in]      vendorId     USB vendor ID.
+     * \param[in]      productId    USB product ID.
+     * \param[in]      comFileName  Port to use, as returned by 'enumerate()', or nullptr
+     *                              to use the first detected port.
+     *
+     * \return     TH_SUCCESS or TH_ERROR_DEVICE_NOT_DETECTED.
      */
-    uint16_t getComPort(uint16_t vendorId, uint16_t productId);
+    TH_ErrorCode detect(usbSerial_t& serial, uint16_t vendorId, uint16_t productId, const char* comFileName = nullptr);
 
     /**
-     * Open serial port based on 'm_serialCom' and start reading thread.
+     * Open serial port based on 'm_comFileName' and start reading thread.
      *
      * \param[in]  serial   Structure of 'usbSerial_t.
      *
@@ -47,7 +123,7 @@ namespace UsbSerial {
     TH_ErrorCode open(usbSerial_t& serial);
 
     /**
-     * Close serial port based on 'm_serialCom' and stop reading thread.
+     * Close serial port based on 'm_comFileName' and stop reading thread.
      *
      * \param[in]  serial   Structure of 'usbSerial_t.
      *
@@ -71,8 +147,10 @@ namespace UsbSerial {
     /**
      * Receive data from serial port.
      *
+     * The function waits for an event from the port and returns as soon as any data is
+     * received. It also returns with 'readSizeOutput' as 0 when 'wakeup()' is called.
+     *
      * Note: Serial port must be opened befor call this function.
-     * Note: If there is no data the function returns after 50 ms with 'readSizeOutput' as 0.
      *
      * \param[in]  serial          Structure of 'usbSerial_t'.
      * \param[in]  buffer          Buffer for imput data.
@@ -83,6 +161,77 @@ namespace UsbSerial {
      */
     TH_ErrorCode read(usbSerial_t& serial, uint8_t* buffer, const size_t maxSize, size_t& readSizeOutput);
 
+    /**
+     * Interrupt the pending (or the next) 'read()'.
+     *
+     * \param[in]  serial   Structure of 'usbSerial_t'.
+     */
+    void wakeup(usbSerial_t& serial);
+
+
+    /* Read completed by 'Poller::wait()' */
+    struct PollerCompletion
+    {
+        void*        m_context;     // 'context' given to 'Poller::add()'
+        TH_ErrorCode m_result;      // TH_ERROR_DEVICE_COMMUNICATION_FAILED if the port is unplugged
+        size_t       m_readSize;    // Data stored in the buffer given to 'Poller::startRead()'
+    };
+
+    /**
+     * Receiving data from many serial ports on a single thread.
+     *
+     * A read of every port is started with 'startRead()' and 'wait()' reports the ports that
+     * received any data into the given buffer. After that the next read must be started.
+     * On Linux the ports are waited for with epoll, on Windows with the overlapped reads.
+     *
+     * The ports must be open and must not use 'read()' at the same time. All methods except
+     * 'wakeup()' must be called from the thread calling 'wait()'.
+     */
+    class Poller
+    {
+    public:
+        Poller();
+        ~Poller();
+
+        Poller(const Poller&) = delete;
+        Poller& operator=(const Poller&) = delete;
+
+        /* Poller was created successfully */
+        bool isValid() const;
+
+        /* Start waiting for the data from the port */
+        TH_ErrorCode add(usbSerial_t& serial, void* context);
+
+        /* Stop waiting for the data from the port, the pending read is cancelled */
+        void remove(usbSerial_t& serial);
+
+        /* Receive the next data of the port into 'buffer' */
+        TH_ErrorCode startRead(usbSerial_t& serial, uint8_t* buffer, size_t maxSize);
+
+        /**
+         * Wait for the data from any of the ports.
+         *
+         * \param[out] completions  Completed reads.
+         * \param[in]  maxCount     Size of 'completions'.
+         * \param[in]  timeoutMs    Maximum waiting time in ms.
+         *
+         * \return     Number of completed reads, '0' after the timeout or 'wakeup()'.
+         */
+        size_t wait(PollerCompletion* completions, size_t maxCount, uint32_t timeoutMs);
+
+        /* Interrupt the pending (or the next) 'wait()' */
+        void wakeup();
+
+    private:
+#if defined(_WIN32)
+        HANDLE m_wakeupEvent = NULL;
+        std::vector<usbSerial_t*> m_ports;
+#else
+        int m_epollHandler = -1;
+        int m_wakeupHandler[2] = { -1, -1 };
+#endif
+    };
+
 
 } // namespace UsbSerial
 
@@ -0,0 +1,397 @@
+// File:   usb_serial_mock.cpp
+// Brief:  Simulated TrackHat device used instead of the serial port
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "usb_serial_mock.h"
+
+#include "crc.h"
+#include "track_hat_decode.h"
+#include "track_hat_messages.h"
+#include "track_hat_parser.h"
+
+#include <cmath>
+#include <cstring>
+
+/* Values reported in the DEVICE_INFO message */
+#define MOCK_HARDWARE_VERSION         1
+#define MOCK_SOFTWARE_VERSION_MAJOR   1
+#define MOCK_SOFTWARE_VERSION_MINOR   0
+
+/* Number of points moving around the middle of the image, the rest is not detected */
+#define MOCK_NUMBER_OF_VISIBLE_POINTS 4
+
+/* Number of frames of one revolution of the points */
+#define MOCK_FRAMES_PER_REVOLUTION    360
+
+namespace UsbSerial
+{
+
+    MockTransport::MockTransport(const trackHat_MockConfig_t& config) :
+        m_config(config)
+    { }
+
+    trackHat_MockConfig_t MockTransport::defaultConfig()
+    {
+        trackHat_MockConfig_t config = {};
+        config.m_frameRateHz = 100;
+        config.m_jitterUs = 500;
+        config.m_corruptedFramesPerMille = 0;
+        config.m_nackPerMille = 0;
+        config.m_seed = 1;
+        config.m_serialNumber = 0x4d4f434b;  // "MOCK"
+        return config;
+    }
+
+    TH_ErrorCode MockTransport::open()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_isOpen = true;
+        m_isWakeup = false;
+        m_isSendingCoordinates = false;
+        m_isStreamFinished = false;
+        m_isStreamPending = false;
+        m_input.clear();
+        m_output.clear();
+        m_outputIndex = 0;
+        m_openTime = Clock::now();
+
+        // Xorshift generator must not start from 0
+        m_randomState = (m_config.m_seed != 0) ? m_config.m_seed : 1;
+        return TH_SUCCESS;
+    }
+
+    TH_ErrorCode MockTransport::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isOpen = false;
+            m_isSendingCoordinates = false;
+        }
+        m_condition.notify_all();
+        return TH_SUCCESS;
+    }
+
+    TH_ErrorCode MockTransport::write(const uint8_t* buffer, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_isOpen)
+                return TH_ERROR_DEVICE_NOT_OPEN;
+
+            m_input.insert(m_input.end(), buffer, buffer + size);
+            processCommands();
+        }
+        m_condition.notify_all();
+        return TH_SUCCESS;
+    }
+
+    TH_ErrorCode MockTransport::read(uint8_t* buffer, size_t maxSize, size_t& readSizeOutput)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        readSizeOutput = 0;
+
+        while (true)
+        {
+            if (m_isWakeup)
+            {
+                m_isWakeup = false;
+                return TH_SUCCESS;
+            }
+
+            if (!m_isOpen)
+                return TH_ERROR_DEVICE_NOT_OPEN;
+
+            if (m_outputIndex == m_output.size() && m_isStreamFinished)
+                return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+
+            if (m_outputIndex < m_output.size())
+            {
+                const size_t waitingSize = m_output.size() - m_outputIndex;
+                const size_t readSize = (waitingSize < maxSize) ? waitingSize : maxSize;
+
+                ::memcpy(buffer, m_output.data() + m_outputIndex, readSize);
+                m_outputIndex += readSize;
+                if (m_outputIndex == m_output.size())
+                {
+                    m_output.clear();
+                    m_outputIndex = 0;
+                }
+
+                readSizeOutput = readSize;
+                return TH_SUCCESS;
+            }
+
+            if (!m_isSendingCoordinates || m_isStreamPending)
+                m_condition.wait(lock);
+            else if (Clock::now() < m_nextFrameTime)
+                m_condition.wait_until(lock, m_nextFrameTime);
+            else
+            {
+                readSizeOutput = readCoordinates(buffer, maxSize);
+                if (readSizeOutput > 0)
+                    return TH_SUCCESS;
+            }
+        }
+    }
+
+    void MockTransport::wakeup()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isWakeup = true;
+        }
+        m_condition.notify_all();
+    }
+
+    void MockTransport::processCommands()
+    {
+        size_t index = 0;   // First byte of the current command
+
+        while (index < m_input.size())
+        {
+            const uint8_t* command = m_input.data() + index;
+            const size_t available = m_input.size() - index;
+            size_t commandSize = 0;
+
+            // Sizes of the frames created by 'Parser::createMessage*()'
+            switch (command[0])
+            {
+                case MessageID::ID_GET_STATUS:
+                case MessageID::ID_GET_DEVICE_INFO:
+                    commandSize = 4;
+                    break;
+
+                case MessageID::ID_SET_MODE:
+                    commandSize = 6;
+                    break;
+
+                case MessageID::ID_SET_REGISTER_VALUE:
+                case MessageID::ID_SET_LEDS:
+                case MessageID::ID_RESET_DEVICE:
+                    commandSize = 7;
+                    break;
+
+                case MessageID::ID_SET_REGISTER_GROUP:
+                    if (available >= 3)
+                        commandSize = 3 + 3 * static_cast<size_t>(command[2]) + 2;
+                    break;
+
+                default:
+                    // Unknown command, look for the next one
+                    index++;
+                    continue;
+            }
+
+            if ((commandSize == 0) || (available < commandSize))
+                break;
+
+            if (Parser::checkCRC(command, commandSize))
+            {
+                respond(command);
+                index += commandSize;
+            }
+            else
+            {
+                index++;
+            }
+        }
+
+        m_input.erase(m_input.begin(), m_input.begin() + static_cast<std::ptrdiff_t>(index));
+    }
+
+    void MockTransport::respond(const uint8_t* command)
+    {
+        const uint8_t transactionID = command[1];
+        uint8_t frame[MessageDeviceInfo::FrameSize];
+        size_t i = 0;
+
+        switch (command[0])
+        {
+            case MessageID::ID_GET_STATUS:
+            {
+                const uint32_t uptime = static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - m_openTime).count());
+
+                if (m_isStreamPending)
+                {
+                    m_isStreamPending = false;
+                    startStream();
+                }
+
+                frame[i++] = MessageID::ID_STATUS;
+                frame[i++] = transactionID;
+                frame[i++] = static_cast<uint8_t>(CameraStatus::CAM_READY_TO_USE);
+                frame[i++] = static_cast<uint8_t>(m_isSendingCoordinates ? CameraMode::CAM_COORDINATE : CameraMode::CAM_IDLE);
+                frame[i++] = static_cast<uint8_t>(uptime >> 24);
+                frame[i++] = static_cast<uint8_t>(uptime >> 16);
+                frame[i++] = static_cast<uint8_t>(uptime >> 8);
+                frame[i++] = static_cast<uint8_t>(uptime);
+                sendFrame(frame, i, false);
+                return;
+            }
+
+            case MessageID::ID_GET_DEVICE_INFO:
+            {
+                frame[i++] = MessageID::ID_DEVICE_INFO;
+                frame[i++] = transactionID;
+                frame[i++] = MOCK_HARDWARE_VERSION;
+                frame[i++] = MOCK_SOFTWARE_VERSION_MAJOR;
+                frame[i++] = MOCK_SOFTWARE_VERSION_MINOR;
+                frame[i++] = static_cast<uint8_t>(m_config.m_serialNumber >> 24);
+                frame[i++] = static_cast<uint8_t>(m_config.m_serialNumber >> 16);
+                frame[i++] = static_cast<uint8_t>(m_config.m_serialNumber >> 8);
+                frame[i++] = static_cast<uint8_t>(m_config.m_serialNumber);
+                sendFrame(frame, i, false);
+                return;
+            }
+
+            case MessageID::ID_SET_MODE:
+            {
+                m_isSendingCoordinates = (command[2] != 0);
+                m_frameType = static_cast<TH_FrameType>(command[3]);
+                m_isStreamPending = m_isSendingCoordinates && m_startsAfterStatus;
+                if (m_isSendingCoordinates && !m_isStreamPending)
+                    startStream();
+                break;
+            }
+
+            case MessageID::ID_RESET_DEVICE:
+            {
+                // The camera restarts, the coordinates are not sent any more
+                m_isSendingCoordinates = false;
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if ((m_config.m_nackPerMille > 0) && (command[0] != MessageID::ID_SET_MODE) &&
+            (random() % 1000 < m_config.m_nackPerMille))
+        {
+            frame[i++] = MessageID::ID_NACK;
+            frame[i++] = transactionID;
+            frame[i++] = static_cast<uint8_t>(NACKReason::NACK_BUSY);
+        }
+        else
+        {
+            frame[i++] = MessageID::ID_ACK;
+            frame[i++] = transactionID;
+        }
+        sendFrame(frame, i, false);
+    }
+
+    void MockTransport::sendFrame(uint8_t* frame, size_t size, bool canBeCorrupted)
+    {
+        const uint16_t crc = calculateCCITTCRC16(frame, size);
+        frame[size++] = static_cast<uint8_t>(crc >> 8);
+        frame[size++] = static_cast<uint8_t>(crc & 0xff);
+
+        if (canBeCorrupted && (m_config.m_corruptedFramesPerMille > 0) &&
+            (random() % 1000 < m_config.m_corruptedFramesPerMille))
+        {
+            // Single bit error, may also hit the ID and shift the following frames
+            const size_t byte = random() % size;
+            frame[byte] ^= static_cast<uint8_t>(1u << (random() % 8));
+        }
+
+        m_output.insert(m_output.end(), frame, frame + size);
+    }
+
+    void MockTransport::startStream()
+    {
+        m_streamStartTime = Clock::now();
+        m_nextFrameTime = m_streamStartTime;
+        m_frameCount = 0;
+    }
+
+    size_t MockTransport::readCoordinates(uint8_t* /*buffer*/, size_t /*maxSize*/)
+    {
+        const double PI = 3.14159265358979323846;
+        const double angle = 2 * PI * static_cast<double>(m_frameCount % MOCK_FRAMES_PER_REVOLUTION) / MOCK_FRAMES_PER_REVOLUTION;
+
+        uint8_t frame[MessageExtendedCoordinates::FrameSize] = {};
+        size_t i = 0;
+
+        if (m_frameType == TH_FRAME_EXTENDED)
+        {
+            frame[i++] = MessageID::ID_EXTENDED_COORDINATES;
+            for (size_t point = 0; point < MOCK_NUMBER_OF_VISIBLE_POINTS; point++)
+            {
+                const double pointAngle = angle + point * PI / 2;
+                const uint16_t x = static_cast<uint16_t>(2048 + 600 * std::cos(pointAngle));
+                const uint16_t y = static_cast<uint16_t>(2048 + 600 * std::sin(pointAngle));
+                const uint16_t area = static_cast<uint16_t>(100 + 10 * point);
+
+                typedef Decode::ExtendedPointView View;
+                uint8_t* raw = frame + i + point * Decode::ExtendedPointSize;
+                raw[View::AreaOffset] = static_cast<uint8_t>(area);
+                raw[View::AreaOffset + 1] = static_cast<uint8_t>(area >> 8);
+                raw[View::CoordinateXOffset] = static_cast<uint8_t>(x);
+                raw[View::CoordinateXOffset + 1] = static_cast<uint8_t>(x >> 8);
+                raw[View::CoordinateYOffset] = static_cast<uint8_t>(y);
+                raw[View::CoordinateYOffset + 1] = static_cast<uint8_t>(y >> 8);
+                raw[View::AverageBrightnessOffset] = 200;
+                raw[View::MaximumBrightnessOffset] = 255;
+                raw[View::RangeRadiusOffset] = 5 | (6 << 4);     // range 5, radius 6
+                raw[View::BoundryLeftOffset] = static_cast<uint8_t>((x >> 4) - 3);
+                raw[View::BoundryRigthOffset] = static_cast<uint8_t>((x >> 4) + 3);
+                raw[View::BoundryUpOffset] = static_cast<uint8_t>((y >> 4) - 3);
+                raw[View::BoundryDownOffset] = static_cast<uint8_t>((y >> 4) + 3);
+                raw[View::AspectRatioOffset] = 10;
+            }
+
+            static_assert(Decode::ExtendedPointsPayloadSize == MessageExtendedCoordinates::FrameSize - 3, "Wrong size of the raw points");
+            i += Decode::ExtendedPointsPayloadSize;
+        }
+        else
+        {
+            frame[i++] = MessageID::ID_COORDINATE;
+            for (size_t point = 0; point < TRACK_HAT_NUMBER_OF_POINTS; point++)
+            {
+                uint16_t x = 0;
+                uint16_t y = 0;
+                uint8_t brightness = 0;
+
+                if (point < MOCK_NUMBER_OF_VISIBLE_POINTS)
+                {
+                    const double pointAngle = angle + point * PI / 2;
+                    x = static_cast<uint16_t>(2048 + 600 * std::cos(pointAngle));
+                    y = static_cast<uint16_t>(2048 + 600 * std::sin(pointAngle));
+                    brightness = 200;
+                }
+
+                frame[i++] = static_cast<uint8_t>(x >> 8);
+                frame[i++] = static_cast<uint8_t>(x);
+                frame[i++] = static_cast<uint8_t>(y >> 8);
+                frame[i++] = static_cast<uint8_t>(y);
+                frame[i++] = brightness;
+            }
+        }
+
+        sendFrame(frame, i, true);
+        m_frameCount++;
+
+        // Frames follow the nominal rate, the jitter does not accumulate
+        if (m_config.m_frameRateHz > 0)
+        {
+            const auto period = std::chrono::microseconds(1000000) / m_config.m_frameRateHz;
+            m_nextFrameTime = m_streamStartTime + period * m_frameCount;
+            if (m_config.m_jitterUs > 0)
+                m_nextFrameTime += std::chrono::microseconds(random() % (m_config.m_jitterUs + 1));
+        }
+
+        return 0;   // the frame is read from 'm_output'
+    }
+
+    uint32_t MockTransport::random()
+    {
+        m_randomState ^= m_randomState << 13;
+        m_randomState ^= m_randomState >> 17;
+        m_randomState ^= m_randomState << 5;
+        return m_randomState;
+    }
+
+} // namespace UsbSerial
@@ -0,0 +1,98 @@
+// File:   usb_serial_mock.h
+// Brief:  Simulated TrackHat device used instead of the serial port
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _USB_SERIAL_MOCK_H_
+#define _USB_SERIAL_MOCK_H_
+
+#include "track_hat_types.h"
+#include "usb_serial.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace UsbSerial
+{
+
+    /**
+     * Transport that behaves like the TrackHat camera.
+     *
+     * Responses to the commands and the coordinates are generated in 'read()', so no extra
+     * thread is needed. The frames are sent at the configured rate with a random delay and
+     * some of them are damaged. The random generator is seeded from the configuration,
+     * so the same configuration always produces the same data.
+     */
+    class MockTransport : public Transport
+    {
+    public:
+        explicit MockTransport(const trackHat_MockConfig_t& config);
+
+        TH_ErrorCode open() override;
+        TH_ErrorCode close() override;
+        TH_ErrorCode write(const uint8_t* buffer, size_t size) override;
+        TH_ErrorCode read(uint8_t* buffer, size_t maxSize, size_t& readSizeOutput) override;
+        void wakeup() override;
+
+        /* Configuration used when the application does not provide one */
+        static trackHat_MockConfig_t defaultConfig();
+
+    protected:
+        typedef std::chrono::steady_clock Clock;
+
+        /* Start sending the coordinates after 'SET_MODE' (or the status confirming it) */
+        virtual void startStream();
+
+        /**
+         * Provide the coordinates when 'm_nextFrameTime' has passed.
+         *
+         * The data is either queued with 'sendFrame()' or copied directly to 'buffer'.
+         * 'm_nextFrameTime' must be moved to the time of the next data.
+         *
+         * \return    Number of bytes copied to 'buffer'.
+         */
+        virtual size_t readCoordinates(uint8_t* buffer, size_t maxSize);
+
+        /* Add CRC to the frame, damage it if it is chosen to be corrupted and queue for 'read()' */
+        void sendFrame(uint8_t* frame, size_t size, bool canBeCorrupted);
+
+        trackHat_MockConfig_t m_config;
+
+        bool              m_isSendingCoordinates = false;
+        bool              m_isStreamFinished = false;    // 'read()' reports the device as unplugged
+        bool              m_startsAfterStatus = false;   // Stream waits for 'GET_STATUS' after 'SET_MODE'
+        Clock::time_point m_streamStartTime;             // Time of the first frame after 'SET_MODE'
+        Clock::time_point m_nextFrameTime;
+
+    private:
+        /* Respond to the complete commands in 'm_input' */
+        void processCommands();
+
+        /* Respond to a single command */
+        void respond(const uint8_t* command);
+
+        /* Next value of the pseudo random generator */
+        uint32_t random();
+
+        std::mutex              m_mutex;
+        std::condition_variable m_condition;
+
+        std::vector<uint8_t> m_input;       // Received part of the next command
+        std::vector<uint8_t> m_output;      // Frames waiting for 'read()'
+        size_t               m_outputIndex = 0;
+
+        bool         m_isOpen = false;
+        bool         m_isWakeup = false;
+        bool         m_isStreamPending = false;   // 'SET_MODE' received, waiting for 'GET_STATUS'
+        TH_FrameType m_frameType = TH_FRAME_BASIC;
+        uint32_t     m_randomState = 0;
+
+        Clock::time_point m_openTime;
+        uint64_t          m_frameCount = 0;
+    };
+
+} // namespace UsbSerial
+
+#endif //_USB_SERIAL_MOCK_H_
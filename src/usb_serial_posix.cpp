@@ -0,0 +1,524 @@
+// File:   usb_serial_posix.cpp
+// Brief:  Functions to control serial port over USB on POSIX systems
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "usb_serial.h"
+
+#include "logger.h"
+#include "track_hat_types.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Maximum time for the output queue to accept more data in 'write()' */
+#define USB_SERIAL_WRITE_TIMEOUT_MS 50
+
+namespace UsbSerial
+{
+
+    /* Read the hexadecimal USB ID stored in the sysfs attribute file */
+    static bool readSysfsId(const std::string& fileName, uint16_t& id)
+    {
+        FILE* file = ::fopen(fileName.c_str(), "r");
+        if (file == nullptr)
+            return false;
+
+        unsigned int value = 0;
+        bool result = (::fscanf(file, "%x", &value) == 1);
+        ::fclose(file);
+
+        id = static_cast<uint16_t>(value);
+        return result;
+    }
+
+    /* Create non-blocking pipe for 'wakeup()' */
+    static bool createWakeupPipe(int (&handlers)[2])
+    {
+        if (::pipe(handlers) != 0)
+            return false;
+
+        for (int handler : handlers)
+        {
+            ::fcntl(handler, F_SETFL, ::fcntl(handler, F_GETFL) | O_NONBLOCK);
+            ::fcntl(handler, F_SETFD, FD_CLOEXEC);
+        }
+        return true;
+    }
+
+    /* Close the serial port and the wakeup pipe */
+    static void closeHandlers(usbSerial_t& serial)
+    {
+        if (serial.m_comHandler >= 0)
+            ::close(serial.m_comHandler);
+
+        for (int& handler : serial.m_wakeupHandler)
+        {
+            if (handler >= 0)
+                ::close(handler);
+            handler = -1;
+        }
+        serial.m_comHandler = -1;
+    }
+
+    /* Read the string stored in the sysfs attribute file, without the new line */
+    static bool readSysfsString(const std::string& fileName, char* value, size_t size)
+    {
+        FILE* file = ::fopen(fileName.c_str(), "r");
+        if (file == nullptr)
+            return false;
+
+        bool result = (::fgets(value, static_cast<int>(size), file) != nullptr);
+        ::fclose(file);
+
+        if (result)
+            value[::strcspn(value, "\n")] = '\0';
+        return result;
+    }
+
+    std::vector<usbSerialPort_t> enumerate(uint16_t vendorId, uint16_t productId)
+    {
+        const std::string TTY_CLASS_DIR = "/sys/class/tty/";
+        std::vector<usbSerialPort_t> detectedPorts;
+
+        DIR* ttyDir = ::opendir(TTY_CLASS_DIR.c_str());
+        if (ttyDir == nullptr)
+        {
+            LOG_ERROR("Cannot open " << TTY_CLASS_DIR << ". Error " << ::strerror(errno) << ".");
+            return detectedPorts;
+        }
+
+        // The TrackHat is a CDC-ACM device, so only 'ttyACM*' nodes are checked
+        while (struct dirent* entry = ::readdir(ttyDir))
+        {
+            if (::strncmp(entry->d_name, "ttyACM", 6) != 0)
+                continue;
+
+            // 'device' links to the USB interface, the USB IDs are in its parent directory
+            char interfacePath[PATH_MAX];
+            std::string deviceLink = TTY_CLASS_DIR + entry->d_name + "/device";
+            if (::realpath(deviceLink.c_str(), interfacePath) == nullptr)
+                continue;
+
+            std::string usbDevicePath(interfacePath);
+            usbDevicePath.erase(usbDevicePath.find_last_of('/'));
+
+            uint16_t detectedVendorId = 0;
+            uint16_t detectedProductId = 0;
+            if (readSysfsId(usbDevicePath + "/idVendor", detectedVendorId) &&
+                readSysfsId(usbDevicePath + "/idProduct", detectedProductId) &&
+                (detectedVendorId == vendorId) && (detectedProductId == productId))
+            {
+                // A cut name would open another port
+                usbSerialPort_t port;
+                const int nameLength = ::snprintf(port.m_comFileName, sizeof(port.m_comFileName), "/dev/%s", entry->d_name);
+                if ((nameLength < 0) || (static_cast<size_t>(nameLength) >= sizeof(port.m_comFileName)))
+                    continue;
+
+                // The attribute does not exist if the device has no serial number
+                readSysfsString(usbDevicePath + "/serial", port.m_serialNumber, sizeof(port.m_serialNumber));
+                detectedPorts.push_back(port);
+            }
+        }
+        ::closedir(ttyDir);
+
+        // Directory order is not defined, "ttyACM10" must be after "ttyACM9"
+        std::sort(detectedPorts.begin(), detectedPorts.end(),
+                  [](const usbSerialPort_t& a, const usbSerialPort_t& b)
+                  {
+                      const size_t aLength = ::strlen(a.m_comFileName);
+                      const size_t bLength = ::strlen(b.m_comFileName);
+                      return (aLength != bLength) ? (aLength < bLength) : (::strcmp(a.m_comFileName, b.m_comFileName) < 0);
+                  });
+        return detectedPorts;
+    }
+
+    TH_ErrorCode detect(usbSerial_t& serial, uint16_t vendorId, uint16_t productId, const char* comFileName)
+    {
+        serial.m_isDetected = false;
+        serial.m_comFileName[0] = '\0';
+
+        for (const usbSerialPort_t& port : enumerate(vendorId, productId))
+        {
+            if ((comFileName == nullptr) || (::strcmp(port.m_comFileName, comFileName) == 0) ||
+                (::strcmp(port.m_comFileName + 5, comFileName) == 0))   // "ttyACM0" without "/dev/"
+            {
+                ::snprintf(serial.m_comFileName, sizeof(serial.m_comFileName), "%s", port.m_comFileName);
+                serial.m_isDetected = true;
+                return TH_SUCCESS;
+            }
+        }
+
+        return TH_ERROR_DEVICE_NOT_DETECTED;
+    }
+
+
+    TH_ErrorCode open(usbSerial_t& serial)
+    {
+        if (serial.m_isPortOpen)
+        {
+            LOG_ERROR("Cannot open a port that is already open.");
+            return TH_ERROR_DEVICE_ALREADY_OPEN;
+        }
+
+        if (!serial.m_isDetected)
+        {
+            LOG_ERROR("Camera must be detected before connection.");
+            return TH_ERROR_DEVICE_NOT_DETECTED;
+        }
+
+        if (serial.m_transport)
+        {
+            TH_ErrorCode result = serial.m_transport->open();
+            serial.m_isPortOpen = (result == TH_SUCCESS);
+            return result;
+        }
+
+        serial.m_comHandler = ::open(serial.m_comFileName, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (serial.m_comHandler < 0)
+        {
+            LOG_ERROR("Cannot connect to the TrackHat port " << serial.m_comFileName
+                      << ". Error " << ::strerror(errno) << ".");
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        if (!createWakeupPipe(serial.m_wakeupHandler))
+        {
+            LOG_ERROR("Cannot create wakeup pipe. Error " << ::strerror(errno) << ".");
+            closeHandlers(serial);
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        // No sharing, as on Windows the port cannot be used by another process
+        if (::ioctl(serial.m_comHandler, TIOCEXCL) != 0)
+        {
+            LOG_ERROR("Cannot get exclusive access to the TrackHat port.");
+            closeHandlers(serial);
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        if (::tcgetattr(serial.m_comHandler, &serial.m_previousSettings) != 0)
+        {
+            LOG_ERROR("Cannot read settings of the TrackHat port.");
+            closeHandlers(serial);
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        // Raw 8N1 mode without echo, line editing, signals and flow control
+        struct termios settings = serial.m_previousSettings;
+        ::cfmakeraw(&settings);
+        settings.c_cflag |= (CLOCAL | CREAD);
+        settings.c_cflag &= ~(CSTOPB | CRTSCTS);
+        settings.c_iflag &= ~(IXON | IXOFF | IXANY);
+        ::cfsetispeed(&settings, B115200);  // CDC-ACM ignores the baudrate
+        ::cfsetospeed(&settings, B115200);
+
+        // 'read()' waits for the data in poll(), so the termios timers are disabled. With
+        // VMIN set to the frame size the driver would hold a complete frame back until
+        // the VTIME inter-byte timer expires when the reads are not aligned to the frames.
+        settings.c_cc[VMIN] = 0;
+        settings.c_cc[VTIME] = 0;
+
+        if (::tcsetattr(serial.m_comHandler, TCSANOW, &settings) != 0)
+        {
+            LOG_ERROR("Cannot setup port for the TrackHat connection.");
+            closeHandlers(serial);
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        // Drop data left from the previous session
+        ::tcflush(serial.m_comHandler, TCIOFLUSH);
+
+        serial.m_isPortOpen = true;
+        return TH_SUCCESS;
+    }
+
+    TH_ErrorCode close(usbSerial_t& serial)
+    {
+        if (serial.m_transport)
+        {
+            if (serial.m_isPortOpen)
+                serial.m_transport->close();
+
+            serial.m_isPortOpen = false;
+            return TH_SUCCESS;
+        }
+
+        if (serial.m_isPortOpen)
+        {
+            ::tcsetattr(serial.m_comHandler, TCSANOW, &serial.m_previousSettings);
+            closeHandlers(serial);
+        }
+
+        serial.m_isPortOpen = false;
+        return TH_SUCCESS;
+    }
+
+    TH_ErrorCode write(usbSerial_t& serial, const uint8_t* const buffer, size_t size)
+    {
+        if (serial.m_isPortOpen == false)
+        {
+            LOG_ERROR("Connection is not open.");
+            return TH_ERROR_DEVICE_NOT_OPEN;
+        }
+
+        if (serial.m_transport)
+            return serial.m_transport->write(buffer, size);
+
+        size_t writtenSize = 0;     // No of bytes written to the port
+
+        while (writtenSize < size)
+        {
+            ssize_t status = ::write(serial.m_comHandler, buffer + writtenSize, size - writtenSize);
+            if (status > 0)
+            {
+                writtenSize += static_cast<size_t>(status);
+            }
+            else if ((status < 0) && (errno == EAGAIN))
+            {
+                // Output queue is full, wait until the driver accepts more data
+                struct pollfd descriptor = { serial.m_comHandler, POLLOUT, 0 };
+                if (::poll(&descriptor, 1, USB_SERIAL_WRITE_TIMEOUT_MS) <= 0)
+                {
+                    LOG_ERROR("Cannot transfer all data.");
+                    return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+                }
+            }
+            else if ((status < 0) && (errno == EINTR))
+            {
+                // do nothing
+            }
+            else
+            {
+                LOG_ERROR("Data cannot be transferred. Error " << ::strerror(errno) << ".");
+                return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+            }
+        }
+
+        return TH_SUCCESS;
+    }
+
+    TH_ErrorCode read(usbSerial_t& serial, uint8_t* buffer, const size_t maxSize, size_t& readSizeOutput)
+    {
+        if (serial.m_isPortOpen == false)
+        {
+            LOG_ERROR("Connection is not open.");
+            return TH_ERROR_DEVICE_NOT_OPEN;
+        }
+
+        if (serial.m_transport)
+            return serial.m_transport->read(buffer, maxSize, readSizeOutput);
+
+        readSizeOutput = 0;
+
+        // Wake up as soon as the first USB packet arrives or 'wakeup()' is called
+        struct pollfd descriptors[2] = {
+            { serial.m_comHandler, POLLIN, 0 },
+            { serial.m_wakeupHandler[0], POLLIN, 0 }
+        };
+        int status = ::poll(descriptors, 2, -1);
+        if (status < 0 && errno == EINTR)
+        {
+            return TH_SUCCESS;
+        }
+        if (status < 0 || (descriptors[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+        {
+            //LOG_ERROR("Cannot receive data.");
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+        if (descriptors[1].revents & POLLIN)
+        {
+            uint8_t wakeupData[16];
+            while (::read(serial.m_wakeupHandler[0], wakeupData, sizeof(wakeupData)) > 0)
+            {
+                // drain the pipe
+            }
+            return TH_SUCCESS;
+        }
+
+        ssize_t readSize = ::read(serial.m_comHandler, buffer, maxSize);
+        if (readSize < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return TH_SUCCESS;
+
+            //LOG_ERROR("Cannot receive data.");
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        // End of file after a poll() readiness means the tty was hung up
+        if (readSize == 0)
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+
+        readSizeOutput = static_cast<size_t>(readSize);
+        return TH_SUCCESS;
+    }
+
+    void wakeup(usbSerial_t& serial)
+    {
+        if (serial.m_transport)
+        {
+            serial.m_transport->wakeup();
+            return;
+        }
+
+        if (serial.m_wakeupHandler[1] >= 0)
+        {
+            const uint8_t wakeupData = 1;
+            ssize_t status = ::write(serial.m_wakeupHandler[1], &wakeupData, sizeof(wakeupData));
+            (void)status;   // a full pipe already wakes the reader
+        }
+    }
+
+
+    Poller::Poller()
+    {
+        m_epollHandler = ::epoll_create1(EPOLL_CLOEXEC);
+        if ((m_epollHandler < 0) || !createWakeupPipe(m_wakeupHandler))
+        {
+            LOG_ERROR("Cannot create poller. Error " << ::strerror(errno) << ".");
+            return;
+        }
+
+        // The wakeup pipe is the only descriptor without a port
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        ::epoll_ctl(m_epollHandler, EPOLL_CTL_ADD, m_wakeupHandler[0], &event);
+    }
+
+    Poller::~Poller()
+    {
+        if (m_epollHandler >= 0)
+            ::close(m_epollHandler);
+
+        for (int handler : m_wakeupHandler)
+        {
+            if (handler >= 0)
+                ::close(handler);
+        }
+    }
+
+    bool Poller::isValid() const
+    {
+        return (m_epollHandler >= 0) && (m_wakeupHandler[0] >= 0);
+    }
+
+    TH_ErrorCode Poller::add(usbSerial_t& serial, void* context)
+    {
+        if (!serial.m_isPortOpen || serial.m_transport)
+            return TH_ERROR_DEVICE_NOT_OPEN;
+
+        serial.m_pollerContext = context;
+        serial.m_pollerBuffer = nullptr;
+        serial.m_pollerBufferSize = 0;
+
+        // Level triggered, data left after the read is reported by the next 'wait()'
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &serial;
+        if (::epoll_ctl(m_epollHandler, EPOLL_CTL_ADD, serial.m_comHandler, &event) != 0)
+        {
+            LOG_ERROR("Cannot wait for the TrackHat port. Error " << ::strerror(errno) << ".");
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        return TH_SUCCESS;
+    }
+
+    void Poller::remove(usbSerial_t& serial)
+    {
+        ::epoll_ctl(m_epollHandler, EPOLL_CTL_DEL, serial.m_comHandler, nullptr);
+        serial.m_pollerContext = nullptr;
+        serial.m_pollerBuffer = nullptr;
+        serial.m_pollerBufferSize = 0;
+    }
+
+    TH_ErrorCode Poller::startRead(usbSerial_t& serial, uint8_t* buffer, size_t maxSize)
+    {
+        // The data is read by 'wait()' when the port is ready
+        serial.m_pollerBuffer = buffer;
+        serial.m_pollerBufferSize = maxSize;
+        return TH_SUCCESS;
+    }
+
+    size_t Poller::wait(PollerCompletion* completions, size_t maxCount, uint32_t timeoutMs)
+    {
+        const int MAX_EVENTS = 16;
+        struct epoll_event events[MAX_EVENTS];
+        const int maxEvents = (maxCount < MAX_EVENTS) ? static_cast<int>(maxCount) : MAX_EVENTS;
+
+        int eventCount = ::epoll_wait(m_epollHandler, events, maxEvents, static_cast<int>(timeoutMs));
+        if (eventCount <= 0)
+            return 0;   // timeout or EINTR
+
+        size_t completionCount = 0;
+
+        for (int i = 0; i < eventCount; i++)
+        {
+            usbSerial_t* serial = static_cast<usbSerial_t*>(events[i].data.ptr);
+            if (serial == nullptr)
+            {
+                uint8_t wakeupData[16];
+                while (::read(m_wakeupHandler[0], wakeupData, sizeof(wakeupData)) > 0)
+                {
+                    // drain the pipe
+                }
+                continue;
+            }
+
+            if (serial->m_pollerBuffer == nullptr)
+                continue;   // read not started, the port stays ready
+
+            PollerCompletion& completion = completions[completionCount];
+            completion.m_context = serial->m_pollerContext;
+            completion.m_result = TH_SUCCESS;
+            completion.m_readSize = 0;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                completion.m_result = TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+            }
+            else
+            {
+                ssize_t readSize = ::read(serial->m_comHandler, serial->m_pollerBuffer, serial->m_pollerBufferSize);
+                if ((readSize < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+                    continue;
+
+                // End of file after the readiness means the tty was hung up
+                if (readSize <= 0)
+                    completion.m_result = TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+                else
+                    completion.m_readSize = static_cast<size_t>(readSize);
+            }
+
+            serial->m_pollerBuffer = nullptr;
+            serial->m_pollerBufferSize = 0;
+            completionCount++;
+        }
+
+        return completionCount;
+    }
+
+    void Poller::wakeup()
+    {
+        const uint8_t wakeupData = 1;
+        ssize_t status = ::write(m_wakeupHandler[1], &wakeupData, sizeof(wakeupData));
+        (void)status;   // a full pipe already wakes the poller
+    }
+
+} // namespace UsbSerial
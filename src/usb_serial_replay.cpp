@@ -0,0 +1,221 @@
+// File:   usb_serial_replay.cpp
+// Brief:  TrackHat device simulated from a capture file
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "usb_serial_replay.h"
+
+#include "logger.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if !defined(_WIN32)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace UsbSerial
+{
+
+    /* Commands are always accepted, the data comes from the file */
+    static trackHat_MockConfig_t replayConfig()
+    {
+        trackHat_MockConfig_t config = MockTransport::defaultConfig();
+        config.m_jitterUs = 0;
+        config.m_corruptedFramesPerMille = 0;
+        config.m_nackPerMille = 0;
+        return config;
+    }
+
+    ReplayTransport::ReplayTransport(double speed) :
+        MockTransport(replayConfig()),
+        m_speed(speed)
+    {
+        // 'trackHat_EnableSendingCoordinates()' checks the mode after 'SET_MODE', the end
+        // of a short file replayed at full speed would make the check fail
+        m_startsAfterStatus = true;
+    }
+
+    ReplayTransport::~ReplayTransport()
+    {
+        unmap();
+    }
+
+    TH_ErrorCode ReplayTransport::load(const char* fileName)
+    {
+        unmap();
+
+#if defined(_WIN32)
+        m_fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                   FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (m_fileHandle == INVALID_HANDLE_VALUE)
+        {
+            LOG_ERROR("Cannot open capture file " << fileName << ". Error " << GetLastError() << ".");
+            return TH_ERROR_DEVICE_NOT_DETECTED;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(m_fileHandle, &fileSize) == FALSE)
+        {
+            LOG_ERROR("Cannot read size of capture file " << fileName << ".");
+            unmap();
+            return TH_ERROR_DEVICE_NOT_DETECTED;
+        }
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+
+        if (m_size > 0)
+        {
+            m_mappingHandle = CreateFileMapping(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+            const void* view = (m_mappingHandle != NULL) ? MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+            if (view == NULL)
+            {
+                LOG_ERROR("Cannot map capture file " << fileName << ". Error " << GetLastError() << ".");
+                unmap();
+                return TH_ERROR_DEVICE_NOT_DETECTED;
+            }
+            m_data = static_cast<const uint8_t*>(view);
+        }
+#else
+        int file = ::open(fileName, O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+        {
+            LOG_ERROR("Cannot open capture file " << fileName << ". Error " << ::strerror(errno) << ".");
+            return TH_ERROR_DEVICE_NOT_DETECTED;
+        }
+
+        struct stat fileStatus;
+        if (::fstat(file, &fileStatus) != 0)
+        {
+            LOG_ERROR("Cannot read size of capture file " << fileName << ". Error " << ::strerror(errno) << ".");
+            ::close(file);
+            return TH_ERROR_DEVICE_NOT_DETECTED;
+        }
+        m_size = static_cast<size_t>(fileStatus.st_size);
+
+        if (m_size > 0)
+        {
+            void* view = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (view == MAP_FAILED)
+            {
+                LOG_ERROR("Cannot map capture file " << fileName << ". Error " << ::strerror(errno) << ".");
+                ::close(file);
+                m_size = 0;
+                return TH_ERROR_DEVICE_NOT_DETECTED;
+            }
+            ::madvise(view, m_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const uint8_t*>(view);
+        }
+
+        // The mapping stays valid after the file is closed
+        ::close(file);
+#endif
+
+        const Capture::FileHeader* header = reinterpret_cast<const Capture::FileHeader*>(m_data);
+        if ((m_size < sizeof(Capture::FileHeader)) ||
+            (::memcmp(header->m_magic, Capture::FileMagic, sizeof(Capture::FileMagic)) != 0) ||
+            (header->m_version != Capture::FileVersion) ||
+            (header->m_headerSize < sizeof(Capture::FileHeader)) ||
+            (header->m_headerSize % Capture::ChunkAlignment != 0))
+        {
+            LOG_ERROR("File " << fileName << " is not a TrackHat capture file.");
+            unmap();
+            return TH_ERROR_WRONG_PARAMETER;
+        }
+
+        m_config.m_serialNumber = header->m_serialNumber;
+        m_firstChunkPosition = header->m_headerSize;
+        m_position = m_firstChunkPosition;
+        m_chunkOffset = 0;
+
+        const Capture::ChunkHeader* firstChunk = currentChunk();
+        m_firstTimestampUs = (firstChunk != nullptr) ? firstChunk->m_timestampUs : 0;
+
+        return TH_SUCCESS;
+    }
+
+    void ReplayTransport::startStream()
+    {
+        MockTransport::startStream();
+
+        // Every connection replays the file from the beginning
+        m_position = m_firstChunkPosition;
+        m_chunkOffset = 0;
+        scheduleChunk();
+    }
+
+    size_t ReplayTransport::readCoordinates(uint8_t* buffer, size_t maxSize)
+    {
+        const Capture::ChunkHeader* chunk = currentChunk();
+        if (chunk == nullptr)
+        {
+            LOG_INFO("End of the capture file.");
+            m_isSendingCoordinates = false;
+            m_isStreamFinished = true;
+            return 0;
+        }
+
+        const uint8_t* chunkData = reinterpret_cast<const uint8_t*>(chunk + 1);
+        const size_t waitingSize = chunk->m_size - m_chunkOffset;
+        const size_t readSize = (waitingSize < maxSize) ? waitingSize : maxSize;
+
+        ::memcpy(buffer, chunkData + m_chunkOffset, readSize);
+        m_chunkOffset += readSize;
+
+        if (m_chunkOffset == chunk->m_size)
+        {
+            m_position += sizeof(Capture::ChunkHeader) + Capture::alignedChunkSize(chunk->m_size);
+            m_chunkOffset = 0;
+            scheduleChunk();
+        }
+
+        return readSize;
+    }
+
+    const Capture::ChunkHeader* ReplayTransport::currentChunk() const
+    {
+        if ((m_data == nullptr) || (m_position + sizeof(Capture::ChunkHeader) > m_size))
+            return nullptr;
+
+        const Capture::ChunkHeader* chunk = reinterpret_cast<const Capture::ChunkHeader*>(m_data + m_position);
+        if (chunk->m_size > m_size - m_position - sizeof(Capture::ChunkHeader))
+            return nullptr;    // cut by the end of the file
+
+        return chunk;
+    }
+
+    void ReplayTransport::scheduleChunk()
+    {
+        const Capture::ChunkHeader* chunk = currentChunk();
+        if ((chunk == nullptr) || (m_speed <= 0) || (chunk->m_timestampUs < m_firstTimestampUs))
+        {
+            m_nextFrameTime = Clock::now();
+            return;
+        }
+
+        const double delayUs = static_cast<double>(chunk->m_timestampUs - m_firstTimestampUs) / m_speed;
+        m_nextFrameTime = m_streamStartTime + std::chrono::microseconds(static_cast<int64_t>(delayUs));
+    }
+
+    void ReplayTransport::unmap()
+    {
+#if defined(_WIN32)
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mappingHandle != NULL)
+            CloseHandle(m_mappingHandle);
+        if (m_fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(m_fileHandle);
+        m_mappingHandle = NULL;
+        m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (m_data != nullptr)
+            ::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+} // namespace UsbSerial
@@ -0,0 +1,69 @@
+// File:   usb_serial_replay.h
+// Brief:  TrackHat device simulated from a capture file
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#ifndef _USB_SERIAL_REPLAY_H_
+#define _USB_SERIAL_REPLAY_H_
+
+#include "track_hat_capture.h"
+#include "usb_serial_mock.h"
+
+#if defined(_WIN32)
+  #include <windows.h>
+#endif
+
+namespace UsbSerial
+{
+
+    /**
+     * Transport that sends the data of a capture file (see 'Capture::Recorder').
+     *
+     * The commands are handled by 'MockTransport'. After 'SET_MODE' and the status confirming
+     * it the recorded chunks are returned by 'read()' with the recorded intervals divided by
+     * the speed. The file is memory mapped and the chunks are copied directly to the receiving
+     * buffer. After the last chunk the device is reported as unplugged.
+     */
+    class ReplayTransport : public MockTransport
+    {
+    public:
+        /**
+         * \param[in]  speed   Multiplier of the recorded speed, '0' replays as fast as possible.
+         */
+        explicit ReplayTransport(double speed);
+        ~ReplayTransport() override;
+
+        /* Map the capture file and check its header */
+        TH_ErrorCode load(const char* fileName);
+
+    protected:
+        void startStream() override;
+        size_t readCoordinates(uint8_t* buffer, size_t maxSize) override;
+
+    private:
+        /* Complete chunk at 'm_position' or nullptr at the end of the file */
+        const Capture::ChunkHeader* currentChunk() const;
+
+        /* Set 'm_nextFrameTime' to the time of the current chunk */
+        void scheduleChunk();
+
+        /* Release the mapping */
+        void unmap();
+
+        const double   m_speed;
+        const uint8_t* m_data = nullptr;   // Mapped capture file
+        size_t         m_size = 0;
+        size_t         m_firstChunkPosition = 0;
+        uint64_t       m_firstTimestampUs = 0;
+        size_t         m_position = 0;     // Current chunk
+        size_t         m_chunkOffset = 0;  // Data of the current chunk already read
+
+#if defined(_WIN32)
+        HANDLE m_fileHandle = INVALID_HANDLE_VALUE;
+        HANDLE m_mappingHandle = NULL;
+#endif
+    };
+
+} // namespace UsbSerial
+
+#endif //_USB_SERIAL_REPLAY_H_
@@ -5,6 +5,7 @@
 
 // Link Setupapi.lib library
 #pragma comment (lib, "Setupapi.lib")
+#pragma comment (lib, "Cfgmgr32.lib")
 
 #include "usb_serial.h"
 
@@ -12,15 +13,44 @@
 #include "track_hat_types.h"
 #include "track_hat_types_internal.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <utility>
 #include <windows.h>
+#include <cfgmgr32.h>
 #include <Setupapi.h>
 
 namespace UsbSerial
 {
 
-    uint16_t getComPort(uint16_t vendorId, uint16_t productId)
+    /* Read the USB serial number from the device instance ID, e.g. "USB\VID_1209&PID_E4A0\<serial>" */
+    static void readSerialNumber(DEVINST deviceInstance, char* serialNumber, size_t size)
+    {
+        char instanceId[MAX_DEVICE_ID_LEN] = {};
+        serialNumber[0] = '\0';
+
+        if (CM_Get_Device_IDA(deviceInstance, instanceId, sizeof(instanceId), 0) != CR_SUCCESS)
+            return;
+
+        // The port of a composite device is an interface, the serial number belongs to its parent
+        if (strstr(instanceId, "&MI_") != NULL)
+        {
+            DEVINST parentInstance = 0;
+            if ((CM_Get_Parent(&parentInstance, deviceInstance, 0) != CR_SUCCESS) ||
+                (CM_Get_Device_IDA(parentInstance, instanceId, sizeof(instanceId), 0) != CR_SUCCESS))
+                return;
+        }
+
+        // Windows generates an ID with '&' for devices without the serial number
+        const char* lastPart = strrchr(instanceId, '\\');
+        if ((lastPart == NULL) || (strchr(lastPart, '&') != NULL))
+            return;
+
+        strncpy_s(serialNumber, size, lastPart + 1, _TRUNCATE);
+    }
+
+    std::vector<usbSerialPort_t> enumerate(uint16_t vendorId, uint16_t productId)
     {
         HDEVINFO deviceInfoSet;
         DWORD    deviceIndex = 0;
@@ -28,7 +58,7 @@ namespace UsbSerial
         PCSTR devEnum = "USB";
         DEVPROPTYPE ulPropertyType;
         DWORD dwSize = 0;
-        uint16_t detectedComPort = 0;
+        std::vector<std::pair<int32_t, usbSerialPort_t>> detectedPorts;
         char expectedDeviceIds[80];
         char szBuffer[1024] = { 0 };
 
@@ -42,7 +72,7 @@ namespace UsbSerial
                                             DIGCF_ALLCLASSES | DIGCF_PRESENT);
 
         if (deviceInfoSet == INVALID_HANDLE_VALUE)
-            return 0;
+            return std::vector<usbSerialPort_t>();
 
         //Fills a block of memory with zeros
         ZeroMemory(&deviceInfoData, sizeof(SP_DEVINFO_DATA));
@@ -76,7 +106,7 @@ namespace UsbSerial
                 {
                     //This behavior may be correct when looking at all possible devices
                     //LOG_ERROR("Cannot open Windows register. Error " << GetLastError() << ".");
-                    break;
+                    continue;
                 }
                 else
                 {
@@ -96,7 +126,11 @@ namespace UsbSerial
                                 int32_t comPortNo = ::atoi(serialPortName + 3);
                                 if (comPortNo != 0)
                                 {
-                                    detectedComPort = comPortNo;
+                                    usbSerialPort_t port;
+                                    // "\\\\.\\COM1" is Windows format
+                                    sprintf_s(port.m_comFileName, "\\\\.\\COM%d", comPortNo);
+                                    readSerialNumber(deviceInfoData.DevInst, port.m_serialNumber, sizeof(port.m_serialNumber));
+                                    detectedPorts.emplace_back(comPortNo, port);
                                 }
                             }
                         }
@@ -112,7 +146,50 @@ namespace UsbSerial
             SetupDiDestroyDeviceInfoList(deviceInfoSet);
         }
 
-        return detectedComPort;
+        // "COM10" must be after "COM9", so the ports are sorted by the number
+        std::sort(detectedPorts.begin(), detectedPorts.end(),
+                  [](const std::pair<int32_t, usbSerialPort_t>& a, const std::pair<int32_t, usbSerialPort_t>& b)
+                  { return a.first < b.first; });
+
+        std::vector<usbSerialPort_t> ports;
+        for (const auto& detectedPort : detectedPorts)
+            ports.push_back(detectedPort.second);
+        return ports;
+    }
+
+
+    /* Close the serial port and the events for the overlapped I/O */
+    static void closeHandlers(usbSerial_t& serial)
+    {
+        HANDLE* handlers[] = { &serial.m_comHandler, &serial.m_readEvent, &serial.m_writeEvent, &serial.m_wakeupEvent };
+
+        for (HANDLE* handler : handlers)
+        {
+            if ((*handler != NULL) && (*handler != INVALID_HANDLE_VALUE))
+                CloseHandle(*handler);
+            *handler = NULL;
+        }
+    }
+
+    TH_ErrorCode detect(usbSerial_t& serial, uint16_t vendorId, uint16_t productId, const char* comFileName)
+    {
+        serial.m_isDetected = false;
+        serial.m_comNumber = 0;
+        serial.m_comFileName[0] = '\0';
+
+        for (const usbSerialPort_t& port : enumerate(vendorId, productId))
+        {
+            if ((comFileName == nullptr) || (_stricmp(port.m_comFileName, comFileName) == 0) ||
+                (_stricmp(port.m_comFileName + 4, comFileName) == 0))   // "COM3" without the prefix
+            {
+                strncpy_s(serial.m_comFileName, port.m_comFileName, _TRUNCATE);
+                serial.m_comNumber = static_cast<uint16_t>(::atoi(port.m_comFileName + 7));
+                serial.m_isDetected = true;
+                return TH_SUCCESS;
+            }
+        }
+
+        return TH_ERROR_DEVICE_NOT_DETECTED;
     }
 
 
@@ -124,14 +201,18 @@ namespace UsbSerial
             return TH_ERROR_DEVICE_ALREADY_OPEN;
         }
 
-        if (serial.m_comNumber == 0)
+        if (!serial.m_isDetected)
         {
             LOG_ERROR("Camera must be detected before connection.");
             return TH_ERROR_DEVICE_NOT_DETECTED;
         }
 
-        // "\\\\.\\COM1" is Windows format
-        sprintf_s(serial.m_comFileName, "\\\\.\\COM%d", serial.m_comNumber);
+        if (serial.m_transport)
+        {
+            TH_ErrorCode result = serial.m_transport->open();
+            serial.m_isPortOpen = (result == TH_SUCCESS);
+            return result;
+        }
 
         //Open the serial COM port
         serial.m_comHandler = CreateFile(serial.m_comFileName,         // COM friendly name
@@ -139,7 +220,7 @@ namespace UsbSerial
                                          0,                            // No Sharing, ports cant be shared
                                          NULL,                         // No Security
                                          OPEN_EXISTING,                // Open existing port only
-                                         0,                            // Non Overlapped I/O
+                                         FILE_FLAG_OVERLAPPED,         // Overlapped I/O
                                          NULL);                        // Null for Comm Devices
         if (serial.m_comHandler == INVALID_HANDLE_VALUE)
         {
@@ -147,16 +228,29 @@ namespace UsbSerial
             return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
         }
 
+        serial.m_readEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        serial.m_writeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        serial.m_wakeupEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if ((serial.m_readEvent == NULL) || (serial.m_writeEvent == NULL) || (serial.m_wakeupEvent == NULL))
+        {
+            LOG_ERROR("Cannot create events for the TrackHat port. Error " << GetLastError() << ".");
+            closeHandlers(serial);
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
         //Setting Timeouts
-        serial.m_timeouts.ReadIntervalTimeout = 50;
-        serial.m_timeouts.ReadTotalTimeoutConstant = 50;
-        serial.m_timeouts.ReadTotalTimeoutMultiplier = 1;
+        // With MAXDWORD interval and multiplier ReadFile completes as soon as any byte
+        // is received. The constant only limits waiting when nothing arrives at all.
+        serial.m_timeouts.ReadIntervalTimeout = MAXDWORD;
+        serial.m_timeouts.ReadTotalTimeoutConstant = MAXDWORD - 1;
+        serial.m_timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
         serial.m_timeouts.WriteTotalTimeoutConstant = 50;
         serial.m_timeouts.WriteTotalTimeoutMultiplier = 1;
 
         if (SetCommTimeouts(serial.m_comHandler, &serial.m_timeouts) == FALSE)
         {
             LOG_ERROR("Windows cannot setup port for the TrackHat connection.");
+            closeHandlers(serial);
             return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
         }
 
@@ -166,8 +260,17 @@ namespace UsbSerial
 
     TH_ErrorCode close(usbSerial_t& serial)
     {
+        if (serial.m_transport)
+        {
+            if (serial.m_isPortOpen)
+                serial.m_transport->close();
+
+            serial.m_isPortOpen = false;
+            return TH_SUCCESS;
+        }
+
         if (serial.m_isPortOpen)
-            CloseHandle(serial.m_comHandler);
+            closeHandlers(serial);
 
         serial.m_isPortOpen = false;
         return TH_SUCCESS;
@@ -181,15 +284,25 @@ namespace UsbSerial
             return TH_ERROR_DEVICE_NOT_OPEN;
         }
 
+        if (serial.m_transport)
+            return serial.m_transport->write(buffer, size);
+
         DWORD writtenSize = 0;          // No of bytes written to the port
         BOOL status = FALSE;
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = serial.m_writeEvent;
 
         //Writing data to Serial Port
         status = WriteFile(serial.m_comHandler, // Handle to the Serialport
                            buffer,              // Data to be written to the port
                            static_cast<DWORD>(size),                // No of bytes to write into the port
                            &writtenSize,        // No of bytes written to the port
-                           NULL);
+                           &overlapped);
+        if ((status == FALSE) && (GetLastError() == ERROR_IO_PENDING))
+        {
+            status = GetOverlappedResult(serial.m_comHandler, &overlapped, &writtenSize, TRUE);
+        }
+
         if (status == FALSE)
         {
             LOG_ERROR("Data cannot be transferred.");
@@ -213,10 +326,47 @@ namespace UsbSerial
             return TH_ERROR_DEVICE_NOT_OPEN;
         }
 
+        if (serial.m_transport)
+            return serial.m_transport->read(buffer, maxSize, readSizeOutput);
+
         DWORD readSize = 0;     // No of bytes read from the port
         BOOL status = FALSE;
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = serial.m_readEvent;
+
+        readSizeOutput = 0;
+
+        status = ReadFile(serial.m_comHandler, buffer, static_cast<DWORD>(maxSize), &readSize, &overlapped);
+        if ((status == FALSE) && (GetLastError() == ERROR_IO_PENDING))
+        {
+            // Wait for the data or for 'wakeup()'
+            HANDLE events[2] = { serial.m_readEvent, serial.m_wakeupEvent };
+            DWORD waitResult = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+
+            if (waitResult == WAIT_OBJECT_0 + 1)
+            {
+                // Some data might have been received before the cancellation
+                CancelIo(serial.m_comHandler);
+                if ((GetOverlappedResult(serial.m_comHandler, &overlapped, &readSize, TRUE) == FALSE) &&
+                    (GetLastError() != ERROR_OPERATION_ABORTED))
+                {
+                    return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+                }
+                readSizeOutput = static_cast<uint32_t>(readSize);
+                return TH_SUCCESS;
+            }
+
+            if (waitResult != WAIT_OBJECT_0)
+            {
+                // The buffer must not be used by the driver after return
+                CancelIo(serial.m_comHandler);
+                GetOverlappedResult(serial.m_comHandler, &overlapped, &readSize, TRUE);
+                return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+            }
+
+            status = GetOverlappedResult(serial.m_comHandler, &overlapped, &readSize, FALSE);
+        }
 
-        status = ReadFile(serial.m_comHandler, buffer, static_cast<DWORD>(maxSize), &readSize, NULL);
         if (status == FALSE)
         {
             //LOG_ERROR("Cannot receive data.");
@@ -227,4 +377,161 @@ namespace UsbSerial
         return TH_SUCCESS;
     }
 
+    void wakeup(usbSerial_t& serial)
+    {
+        if (serial.m_transport)
+        {
+            serial.m_transport->wakeup();
+            return;
+        }
+
+        if (serial.m_wakeupEvent != NULL)
+            SetEvent(serial.m_wakeupEvent);
+    }
+
+
+    Poller::Poller()
+    {
+        m_wakeupEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (m_wakeupEvent == NULL)
+            LOG_ERROR("Cannot create poller. Error " << GetLastError() << ".");
+    }
+
+    Poller::~Poller()
+    {
+        if (m_wakeupEvent != NULL)
+            CloseHandle(m_wakeupEvent);
+    }
+
+    bool Poller::isValid() const
+    {
+        return (m_wakeupEvent != NULL);
+    }
+
+    TH_ErrorCode Poller::add(usbSerial_t& serial, void* context)
+    {
+        if (!serial.m_isPortOpen || serial.m_transport)
+            return TH_ERROR_DEVICE_NOT_OPEN;
+
+        // The read events of all ports and the wakeup event are waited for at once
+        if (m_ports.size() + 1 >= MAXIMUM_WAIT_OBJECTS)
+        {
+            LOG_ERROR("Too many ports to wait for.");
+            return TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+        }
+
+        serial.m_pollerContext = context;
+        serial.m_isPollerReadPending = false;
+        serial.m_isPollerReadFailed = false;
+        m_ports.push_back(&serial);
+        return TH_SUCCESS;
+    }
+
+    void Poller::remove(usbSerial_t& serial)
+    {
+        if (serial.m_isPollerReadPending)
+        {
+            // The buffer must not be used by the driver after return
+            DWORD readSize = 0;
+            CancelIoEx(serial.m_comHandler, &serial.m_pollerOverlapped);
+            GetOverlappedResult(serial.m_comHandler, &serial.m_pollerOverlapped, &readSize, TRUE);
+        }
+
+        m_ports.erase(std::remove(m_ports.begin(), m_ports.end(), &serial), m_ports.end());
+        serial.m_pollerContext = nullptr;
+        serial.m_pollerBuffer = nullptr;
+        serial.m_pollerBufferSize = 0;
+        serial.m_isPollerReadPending = false;
+        serial.m_isPollerReadFailed = false;
+    }
+
+    TH_ErrorCode Poller::startRead(usbSerial_t& serial, uint8_t* buffer, size_t maxSize)
+    {
+        serial.m_pollerBuffer = buffer;
+        serial.m_pollerBufferSize = maxSize;
+        serial.m_pollerOverlapped = {};
+        serial.m_pollerOverlapped.hEvent = serial.m_readEvent;
+        serial.m_isPollerReadPending = true;
+
+        // The event is signalled also when the read completes immediately
+        if ((ReadFile(serial.m_comHandler, buffer, static_cast<DWORD>(maxSize), NULL, &serial.m_pollerOverlapped) == FALSE) &&
+            (GetLastError() != ERROR_IO_PENDING))
+        {
+            // Reported by 'wait()' as the other results
+            serial.m_isPollerReadPending = false;
+            serial.m_isPollerReadFailed = true;
+            SetEvent(serial.m_readEvent);
+        }
+
+        return TH_SUCCESS;
+    }
+
+    size_t Poller::wait(PollerCompletion* completions, size_t maxCount, uint32_t timeoutMs)
+    {
+        HANDLE events[MAXIMUM_WAIT_OBJECTS];
+        DWORD eventCount = 0;
+
+        events[eventCount++] = m_wakeupEvent;
+        for (usbSerial_t* serial : m_ports)
+        {
+            if (serial->m_isPollerReadPending || serial->m_isPollerReadFailed)
+                events[eventCount++] = serial->m_readEvent;
+        }
+
+        DWORD waitResult = WaitForMultipleObjects(eventCount, events, FALSE, timeoutMs);
+        if ((waitResult == WAIT_TIMEOUT) || (waitResult == WAIT_OBJECT_0) || (waitResult >= WAIT_OBJECT_0 + eventCount))
+            return 0;
+
+        // 'WaitForMultipleObjects()' reports only the first signalled event, the other
+        // ports are checked too, so a busy port does not hide the others
+        size_t completionCount = 0;
+
+        for (usbSerial_t* serial : m_ports)
+        {
+            if (completionCount == maxCount)
+                break;
+
+            PollerCompletion& completion = completions[completionCount];
+            completion.m_context = serial->m_pollerContext;
+            completion.m_result = TH_SUCCESS;
+            completion.m_readSize = 0;
+
+            if (serial->m_isPollerReadFailed)
+            {
+                ResetEvent(serial->m_readEvent);
+                serial->m_isPollerReadFailed = false;
+                completion.m_result = TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+            }
+            else if (serial->m_isPollerReadPending)
+            {
+                DWORD readSize = 0;
+                if (GetOverlappedResult(serial->m_comHandler, &serial->m_pollerOverlapped, &readSize, FALSE) == FALSE)
+                {
+                    if (GetLastError() == ERROR_IO_INCOMPLETE)
+                        continue;
+
+                    completion.m_result = TH_ERROR_DEVICE_COMMUNICATION_FAILED;
+                }
+                completion.m_readSize = static_cast<size_t>(readSize);
+                serial->m_isPollerReadPending = false;
+            }
+            else
+            {
+                continue;
+            }
+
+            serial->m_pollerBuffer = nullptr;
+            serial->m_pollerBufferSize = 0;
+            completionCount++;
+        }
+
+        return completionCount;
+    }
+
+    void Poller::wakeup()
+    {
+        if (m_wakeupEvent != NULL)
+            SetEvent(m_wakeupEvent);
+    }
+
 } // namespace UsbSerial
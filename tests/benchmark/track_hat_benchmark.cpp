@@ -0,0 +1,492 @@
+// File:   track_hat_benchmark.cpp
+// Brief:  Benchmarks of the TrackHat driver internals and frame delivery
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "crc.h"
+#include "track_hat_decode.h"
+#include "track_hat_driver.h"
+#include "track_hat_messages.h"
+#include "track_hat_parser.h"
+#include "track_hat_types_internal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef TRACK_HAT_LIBRARY_VERSION
+  #define TRACK_HAT_LIBRARY_VERSION "unknown"
+#endif
+
+
+/* Prevent the compiler from removing the benchmarked computation */
+static volatile uint32_t benchmarkSink = 0;
+
+/* Single measured value */
+struct BenchmarkResult
+{
+    std::string m_name;
+    std::string m_case;
+    double      m_value;
+    std::string m_unit;
+};
+
+enum class OutputFormat
+{
+    TEXT,
+    CSV,
+    JSON,
+};
+
+static std::vector<BenchmarkResult> results;
+
+
+/* Store the result for the report */
+void report(const std::string& name, const std::string& benchmarkCase, double value, const std::string& unit)
+{
+    results.push_back({ name, benchmarkCase, value, unit });
+}
+
+/* Run 'function' 'iterations' times and return average time in ns */
+double measureNs(size_t iterations, const std::function<void()>& function)
+{
+    // Warm up caches and branch predictors
+    for (size_t i = 0; i < iterations / 10; i++)
+        function();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        function();
+    const auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+}
+
+/* Append a frame with a valid CRC and random payload */
+void appendFrame(std::vector<uint8_t>& stream, uint8_t id, size_t frameSize, std::mt19937& random)
+{
+    const size_t start = stream.size();
+    stream.push_back(id);
+    for (size_t i = 1; i < frameSize - 2; i++)
+        stream.push_back(static_cast<uint8_t>(random()));
+
+    const uint16_t crc = calculateCCITTCRC16(stream.data() + start, frameSize - 2);
+    stream.push_back(static_cast<uint8_t>(crc >> 8));
+    stream.push_back(static_cast<uint8_t>(crc & 0xff));
+}
+
+
+/* Compare CRC implementations on the payload of the coordinate frames */
+void benchmarkCrc()
+{
+    const size_t ITERATIONS = 1000000;
+    const size_t frameSizes[] = { MessageCoordinates::FrameSize, MessageExtendedCoordinates::FrameSize };
+
+    std::mt19937 random(0);
+    std::vector<uint8_t> frame(MessageExtendedCoordinates::FrameSize);
+    for (uint8_t& byte : frame)
+        byte = static_cast<uint8_t>(random());
+
+    for (size_t frameSize : frameSizes)
+    {
+        // CRC is calculated without the last two bytes of the frame
+        const size_t size = frameSize - 2;
+        const std::string benchmarkCase = std::to_string(frameSize) + "B";
+
+        report("crc16_bitwise", benchmarkCase, measureNs(ITERATIONS, [&] {
+            benchmarkSink += calculateCCITTCRC16Bitwise(frame.data(), size);
+        }), "ns");
+
+        report("crc16_slicing_by_" + std::to_string(CRC16_CCITT_SLICE_SIZE), benchmarkCase, measureNs(ITERATIONS, [&] {
+            benchmarkSink += calculateCCITTCRC16Table(frame.data(), size);
+        }), "ns");
+
+        if (isCCITTCRC16ClmulSupported())
+        {
+            report("crc16_clmul", benchmarkCase, measureNs(ITERATIONS, [&] {
+                benchmarkSink += calculateCCITTCRC16Clmul(frame.data(), size);
+            }), "ns");
+        }
+
+        report("crc16", benchmarkCase, measureNs(ITERATIONS, [&] {
+            benchmarkSink += calculateCCITTCRC16(frame.data(), size);
+        }), "ns");
+    }
+}
+
+/* Parse a stream of coordinate frames, clean, with damaged frames and without any frame */
+void benchmarkParser()
+{
+    const size_t FRAMES = 256;
+    const size_t ITERATIONS = 200;
+
+    std::unique_ptr<trackHat_Messages_t> messages(new trackHat_Messages_t());
+    std::mt19937 random(0);
+
+    struct StreamCase
+    {
+        const char*          m_name;
+        uint8_t              m_id;
+        size_t               m_frameSize;
+        size_t               m_damagedFrameInterval;   // 0 - no damaged frames
+    };
+    const StreamCase streamCases[] = {
+        { "basic_clean",       MessageID::ID_COORDINATE,          MessageCoordinates::FrameSize,         0 },
+        { "basic_1in10_bad",   MessageID::ID_COORDINATE,          MessageCoordinates::FrameSize,         10 },
+        { "extended_clean",    MessageID::ID_EXTENDED_COORDINATES, MessageExtendedCoordinates::FrameSize, 0 },
+        { "extended_1in10_bad", MessageID::ID_EXTENDED_COORDINATES, MessageExtendedCoordinates::FrameSize, 10 },
+    };
+
+    for (const StreamCase& streamCase : streamCases)
+    {
+        std::vector<uint8_t> stream;
+        for (size_t frame = 0; frame < FRAMES; frame++)
+        {
+            appendFrame(stream, streamCase.m_id, streamCase.m_frameSize, random);
+
+            // Damaged payload, the parser resynchronizes byte by byte
+            if ((streamCase.m_damagedFrameInterval > 0) && (frame % streamCase.m_damagedFrameInterval == 0))
+                stream[stream.size() - streamCase.m_frameSize / 2] ^= 0x01;
+        }
+
+        const double ns = measureNs(ITERATIONS, [&] {
+            benchmarkSink += static_cast<uint32_t>(Parser::parseInputData(stream.data(), stream.size(), *messages, 0));
+        });
+        report("parse_input_data", std::string(streamCase.m_name) + "_per_frame", ns / FRAMES, "ns");
+        report("parse_input_data", std::string(streamCase.m_name) + "_throughput", stream.size() * 1e3 / ns, "MB/s");
+    }
+
+    // Worst case, every byte is checked as a possible frame start
+    std::vector<uint8_t> noise(FRAMES * MessageCoordinates::FrameSize);
+    for (uint8_t& byte : noise)
+        byte = static_cast<uint8_t>(random());
+
+    const double noiseNs = measureNs(ITERATIONS, [&] {
+        benchmarkSink += static_cast<uint32_t>(Parser::parseInputData(noise.data(), noise.size(), *messages, 0));
+    });
+    report("parse_input_data", "noise_throughput", noise.size() * 1e3 / noiseNs, "MB/s");
+}
+
+/* Conversion of the raw extended points */
+void benchmarkExtendedPointConversion()
+{
+    const size_t ITERATIONS = 1000000;
+
+    std::mt19937 random(0);
+    trackHat_ExtendedPointRaw_t rawPoints[TRACK_HAT_NUMBER_OF_POINTS];
+    uint8_t* rawBytes = reinterpret_cast<uint8_t*>(rawPoints);
+    for (size_t i = 0; i < sizeof(rawPoints); i++)
+        rawBytes[i] = static_cast<uint8_t>(random());
+
+    trackHat_ExtendedPoints_t points = {};
+
+    const double ns = measureNs(ITERATIONS, [&] {
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+            Parser::parseRawExtendedPointToHumanRedable(rawPoints[i], points.m_point[i]);
+        benchmarkSink += points.m_point[benchmarkSink % TRACK_HAT_NUMBER_OF_POINTS].m_coordinateX;
+    });
+    report("parse_raw_extended_point", "per_frame", ns, "ns");
+    report("parse_raw_extended_point", "per_point", ns / TRACK_HAT_NUMBER_OF_POINTS, "ns");
+}
+/* Decoding of the frame payloads into points and into arrays with each implementation */
+void benchmarkPointsDecoding()
+{
+    const size_t ITERATIONS = 1000000;
+
+    std::mt19937 random(0);
+    uint8_t payload[Decode::ExtendedPointsPayloadSize];
+    for (uint8_t& byte : payload)
+        byte = static_cast<uint8_t>(random());
+
+    struct Decoder
+    {
+        const char* m_name;
+        bool        m_isSupported;
+        void (*m_decodePoints)(const uint8_t*, trackHat_PointsSoA_t&);
+        void (*m_decodeExtendedPoints)(const uint8_t*, trackHat_ExtendedPointsSoA_t&);
+    };
+    const Decoder decoders[] = {
+        { "soa_scalar", true,                                              Decode::decodePointsSoAScalar, Decode::decodeExtendedPointsSoAScalar },
+        { "soa_ssse3",  Decode::isSsse3Supported(),                        Decode::decodePointsSoASsse3,  Decode::decodeExtendedPointsSoASsse3 },
+        { "soa_avx2",   Decode::isAvx2Supported(),                         Decode::decodePointsSoAAvx2,   Decode::decodeExtendedPointsSoAAvx2 },
+        { "soa_neon",   strcmp(Decode::implementationName(), "neon") == 0, Decode::decodePointsSoANeon,   Decode::decodeExtendedPointsSoANeon },
+    };
+
+    // Current decoding of the receiver into 'trackHat_Points_t' and 'trackHat_ExtendedPoints_t'
+    trackHat_Points_t points = {};
+    report("decode_points", "aos_scalar", measureNs(ITERATIONS, [&] {
+        Decode::decodePoints(payload, points.m_point);
+        benchmarkSink += points.m_point[benchmarkSink % TRACK_HAT_NUMBER_OF_POINTS].m_x;
+    }), "ns");
+
+    trackHat_ExtendedPoints_t extendedPoints = {};
+    report("decode_extended_points", "aos_scalar", measureNs(ITERATIONS, [&] {
+        const Decode::ExtendedPointsView view(payload);
+        for (size_t i = 0; i < view.size(); i++)
+            view[i].decode(extendedPoints.m_point[i]);
+        benchmarkSink += extendedPoints.m_point[benchmarkSink % TRACK_HAT_NUMBER_OF_POINTS].m_coordinateX;
+    }), "ns");
+
+    // Only the fields read by the most consumers, from 'trackHat_GetDetectedPointsExtendedRaw()'
+    trackHat_ExtendedPointsRaw_t rawPoints = {};
+    report("decode_extended_points", "raw_xy_area", measureNs(ITERATIONS, [&] {
+        Decode::copyExtendedPointsRaw(payload, rawPoints);
+        uint32_t sum = 0;
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            const trackHat_ExtendedPointRaw_t* point = &rawPoints.m_point[i];
+            sum += trackHat_RawPointX(point) + trackHat_RawPointY(point) + trackHat_RawPointArea(point);
+        }
+        benchmarkSink += sum;
+    }), "ns");
+
+    trackHat_PointsSoA_t pointsSoA = {};
+    trackHat_ExtendedPointsSoA_t extendedPointsSoA = {};
+    for (const Decoder& decoder : decoders)
+    {
+        if (!decoder.m_isSupported)
+            continue;
+
+        report("decode_points", decoder.m_name, measureNs(ITERATIONS, [&] {
+            decoder.m_decodePoints(payload, pointsSoA);
+            benchmarkSink += pointsSoA.m_x[benchmarkSink % TRACK_HAT_NUMBER_OF_POINTS];
+        }), "ns");
+
+        report("decode_extended_points", decoder.m_name, measureNs(ITERATIONS, [&] {
+            decoder.m_decodeExtendedPoints(payload, extendedPointsSoA);
+            benchmarkSink += extendedPointsSoA.m_coordinateX[benchmarkSink % TRACK_HAT_NUMBER_OF_POINTS];
+        }), "ns");
+    }
+}
+
+
+
+/* Latency samples collected by the callback */
+static std::mutex latencyMutex;
+static std::vector<uint64_t> latencySamplesUs;
+
+void latencyCallback(TH_ErrorCode error, const trackHat_ExtendedPoints_t* const points)
+{
+    if ((error != TH_SUCCESS) || (points == nullptr))
+        return;
+
+    const uint64_t latencyUs = trackHat_GetTimestampUs() - points->m_timestampUs;
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    latencySamplesUs.push_back(latencyUs);
+}
+
+/* Value of the sorted samples at 'fraction' */
+double percentile(const std::vector<uint64_t>& sortedSamples, double fraction)
+{
+    if (sortedSamples.empty())
+        return 0;
+
+    const size_t index = static_cast<size_t>(fraction * (sortedSamples.size() - 1));
+    return static_cast<double>(sortedSamples[index]);
+}
+
+/* Full path from the transport through the receiver and the parser to the application */
+void benchmarkEndToEnd()
+{
+    // Receiver to callback latency at the real frame rate
+    {
+        trackHat_Device_t device;
+        trackHat_Initialize(&device);
+
+        trackHat_MockConfig_t config = {};
+        config.m_frameRateHz = 500;
+        config.m_seed = 1;
+        trackHat_DetectMockDevice(&device, &config);
+
+        if (trackHat_Connect(&device, TH_FRAME_EXTENDED) == TH_SUCCESS)
+        {
+            trackHat_SetExtendedPointsCallback(&device, latencyCallback);
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+            trackHat_SetExtendedPointsCallback(&device, nullptr);
+            trackHat_Disconnect(&device);
+
+            std::lock_guard<std::mutex> lock(latencyMutex);
+            std::sort(latencySamplesUs.begin(), latencySamplesUs.end());
+            report("receiver_to_callback_latency", "p50", percentile(latencySamplesUs, 0.5), "us");
+            report("receiver_to_callback_latency", "p99", percentile(latencySamplesUs, 0.99), "us");
+            report("receiver_to_callback_latency", "max", percentile(latencySamplesUs, 1.0), "us");
+            report("receiver_to_callback_latency", "samples", static_cast<double>(latencySamplesUs.size()), "frames");
+        }
+        else
+        {
+            fprintf(stderr, "Cannot connect to the mock device.\n");
+        }
+
+        trackHat_Deinitialize(&device);
+    }
+
+    // Receiver throughput with the frames sent as fast as they are read
+    {
+        trackHat_Device_t device;
+        trackHat_Initialize(&device);
+
+        trackHat_MockConfig_t config = {};
+        config.m_frameRateHz = 0;
+        config.m_seed = 1;
+        trackHat_DetectMockDevice(&device, &config);
+
+        if (trackHat_Connect(&device, TH_FRAME_EXTENDED) == TH_SUCCESS)
+        {
+            trackHat_ExtendedPoints_t first;
+            trackHat_ExtendedPoints_t last;
+            trackHat_GetDetectedPointsExtended(&device, &first);
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            trackHat_GetDetectedPointsExtended(&device, &last);
+            trackHat_Disconnect(&device);
+
+            const double seconds = (last.m_timestampUs - first.m_timestampUs) / 1e6;
+            report("receiver_throughput", "extended", (last.m_frameNumber - first.m_frameNumber) / seconds, "frames/s");
+        }
+        else
+        {
+            fprintf(stderr, "Cannot connect to the mock device.\n");
+        }
+
+        trackHat_Deinitialize(&device);
+    }
+
+    // Command round trip, from sending to the parsed ACK
+    {
+        trackHat_Device_t device;
+        trackHat_Initialize(&device);
+
+        trackHat_MockConfig_t config = {};
+        config.m_frameRateHz = 500;
+        config.m_seed = 1;
+        trackHat_DetectMockDevice(&device, &config);
+
+        if (trackHat_Connect(&device, TH_FRAME_EXTENDED) == TH_SUCCESS)
+        {
+            const size_t COMMANDS = 500;
+            trackHat_SetRegister_t setRegister = { 0, 0x0b, 0x01 };
+            std::vector<uint64_t> roundTripsUs;
+
+            for (size_t i = 0; i < COMMANDS; i++)
+            {
+                const uint64_t startUs = trackHat_GetTimestampUs();
+                if (trackHat_SetRegisterValue(&device, &setRegister) == TH_SUCCESS)
+                    roundTripsUs.push_back(trackHat_GetTimestampUs() - startUs);
+            }
+
+            // The same commands sent without waiting for each response
+            std::vector<uint8_t> transactionIDs(COMMANDS);
+            size_t failedCommands = 0;
+            const uint64_t pipelinedStartUs = trackHat_GetTimestampUs();
+            for (size_t i = 0; i < COMMANDS; i++)
+            {
+                if (trackHat_SetRegisterValueAsync(&device, &setRegister, &transactionIDs[i]) != TH_SUCCESS)
+                    failedCommands++;
+
+                // Results are kept until the transaction ID is used again
+                if ((i >= 128) && (trackHat_GetTransactionResult(&device, transactionIDs[i - 128], 1000) != TH_SUCCESS))
+                    failedCommands++;
+            }
+            for (size_t i = COMMANDS - 128; i < COMMANDS; i++)
+            {
+                if (trackHat_GetTransactionResult(&device, transactionIDs[i], 1000) != TH_SUCCESS)
+                    failedCommands++;
+            }
+            const double pipelinedUs = static_cast<double>(trackHat_GetTimestampUs() - pipelinedStartUs);
+            trackHat_Disconnect(&device);
+
+            std::sort(roundTripsUs.begin(), roundTripsUs.end());
+            report("set_register_round_trip", "p50", percentile(roundTripsUs, 0.5), "us");
+            report("set_register_round_trip", "p99", percentile(roundTripsUs, 0.99), "us");
+            report("set_register_round_trip", "failed", static_cast<double>(COMMANDS - roundTripsUs.size()), "commands");
+            report("set_register_pipelined", "per_command", pipelinedUs / COMMANDS, "us");
+            report("set_register_pipelined", "failed", static_cast<double>(failedCommands), "commands");
+        }
+        else
+        {
+            fprintf(stderr, "Cannot connect to the mock device.\n");
+        }
+
+        trackHat_Deinitialize(&device);
+    }
+}
+
+
+void printResults(OutputFormat format)
+{
+    switch (format)
+    {
+        case OutputFormat::CSV:
+            printf("benchmark,case,value,unit\n");
+            for (const BenchmarkResult& result : results)
+                printf("%s,%s,%.3f,%s\n", result.m_name.c_str(), result.m_case.c_str(), result.m_value, result.m_unit.c_str());
+            break;
+
+        case OutputFormat::JSON:
+            printf("{\n  \"version\": \"%s\",\n  \"results\": [\n", TRACK_HAT_LIBRARY_VERSION);
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                const BenchmarkResult& result = results[i];
+                printf("    { \"benchmark\": \"%s\", \"case\": \"%s\", \"value\": %.3f, \"unit\": \"%s\" }%s\n",
+                       result.m_name.c_str(), result.m_case.c_str(), result.m_value, result.m_unit.c_str(),
+                       (i + 1 < results.size()) ? "," : "");
+            }
+            printf("  ]\n}\n");
+            break;
+
+        default:
+            printf("TrackHat driver %s\n", TRACK_HAT_LIBRARY_VERSION);
+            for (const BenchmarkResult& result : results)
+                printf("%-30s %-28s %12.2f %s\n", result.m_name.c_str(), result.m_case.c_str(), result.m_value, result.m_unit.c_str());
+            break;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    OutputFormat format = OutputFormat::TEXT;
+    bool runEndToEnd = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (option == "--csv")
+        {
+            format = OutputFormat::CSV;
+        }
+        else if (option == "--json")
+        {
+            format = OutputFormat::JSON;
+        }
+        else if (option == "--no-end-to-end")
+        {
+            runEndToEnd = false;
+        }
+        else
+        {
+            printf("Benchmarks of the TrackHat driver.\n\n");
+            printf("  --csv             Print results as CSV.\n");
+            printf("  --json            Print results as JSON.\n");
+            printf("  --no-end-to-end   Skip the benchmarks with the mock device (3 s).\n");
+            return (option == "--help") ? 0 : 1;
+        }
+    }
+
+    benchmarkCrc();
+    benchmarkParser();
+    benchmarkExtendedPointConversion();
+    benchmarkPointsDecoding();
+    if (runEndToEnd)
+        benchmarkEndToEnd();
+
+    printResults(format);
+    return 0;
+}
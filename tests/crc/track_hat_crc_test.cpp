@@ -0,0 +1,104 @@
+// File:   track_hat_crc_test.cpp
+// Brief:  Tests of the CRC calculation against the bitwise reference
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "crc.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+
+static int failedChecks = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition))                                                       \
+        {                                                                       \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failedChecks++;                                                     \
+        }                                                                       \
+    } while (false)
+
+/* Longest checked message and the number of unaligned starts */
+static const size_t MAXIMUM_SIZE = 600;
+static const size_t OFFSET_COUNT = 8;
+
+/* Sizes of the coordinates and the extended coordinates frames without CRC */
+static const size_t FRAME_SIZES[] = {83, 259};
+
+
+/* Data of the messages: random, all bits zero and all bits one */
+static std::vector<std::vector<uint8_t>> makeBuffers()
+{
+    std::vector<std::vector<uint8_t>> buffers(3, std::vector<uint8_t>(MAXIMUM_SIZE + OFFSET_COUNT));
+
+    std::mt19937 random(0);
+    for (uint8_t& byte : buffers[0])
+        byte = static_cast<uint8_t>(random());
+    for (uint8_t& byte : buffers[2])
+        byte = 0xff;
+
+    return buffers;
+}
+
+/* Check the lookup tables of 'CRC16_CCITT_SLICE_SIZE' for every size and unaligned start */
+void testTable()
+{
+    for (const std::vector<uint8_t>& buffer : makeBuffers())
+    {
+        for (size_t offset = 0; offset < OFFSET_COUNT; offset++)
+        {
+            const uint8_t* message = buffer.data() + offset;
+            for (size_t size = 0; size <= MAXIMUM_SIZE; size++)
+                CHECK(calculateCCITTCRC16Table(message, size) == calculateCCITTCRC16Bitwise(message, size));
+
+            for (size_t size : FRAME_SIZES)
+                CHECK(calculateCCITTCRC16Table(message, size) == calculateCCITTCRC16Bitwise(message, size));
+        }
+    }
+}
+
+/* Check the folding with PCLMULQDQ and the selected implementation, if the CPU supports it */
+void testClmul()
+{
+    if (!isCCITTCRC16ClmulSupported())
+    {
+        std::printf("PCLMULQDQ is not supported, skipping its checks\n");
+        return;
+    }
+
+    // Every size up to 600 bytes covers the switch from the tables to the folding at
+    // 'CRC16_CCITT_CLMUL_MINIMUM_SIZE' and each multiple of 16 bytes plus and minus one
+    static_assert(MAXIMUM_SIZE > 2 * CRC16_CCITT_CLMUL_MINIMUM_SIZE, "Folding is not checked");
+
+    for (const std::vector<uint8_t>& buffer : makeBuffers())
+    {
+        for (size_t offset = 0; offset < OFFSET_COUNT; offset++)
+        {
+            const uint8_t* message = buffer.data() + offset;
+            for (size_t size = 0; size <= MAXIMUM_SIZE; size++)
+            {
+                CHECK(calculateCCITTCRC16Clmul(message, size) == calculateCCITTCRC16Bitwise(message, size));
+                CHECK(calculateCCITTCRC16(message, size) == calculateCCITTCRC16Bitwise(message, size));
+            }
+        }
+    }
+}
+
+
+int main()
+{
+    testTable();
+    testClmul();
+
+    if (failedChecks != 0)
+    {
+        std::printf("Slice of %d bytes: %d checks failed\n", CRC16_CCITT_SLICE_SIZE, failedChecks);
+        return 1;
+    }
+
+    std::printf("Slice of %d bytes: all checks passed\n", CRC16_CCITT_SLICE_SIZE);
+    return 0;
+}
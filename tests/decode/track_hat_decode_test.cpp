@@ -0,0 +1,202 @@
+// File:   track_hat_decode_test.cpp
+// Brief:  Tests of the vector decoders and the raw points against the scalar reference
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_decode.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+static int failedChecks = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition))                                                       \
+        {                                                                       \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failedChecks++;                                                     \
+        }                                                                       \
+    } while (false)
+
+/* Random payloads checked with each decoder */
+static const size_t PAYLOAD_COUNT = 20000;
+
+
+/* Decoder checked against the scalar one, if the CPU supports it */
+struct Decoder
+{
+    const char* m_name;
+    bool        m_isSupported;
+    void (*m_decodePoints)(const uint8_t*, trackHat_PointsSoA_t&);
+    void (*m_decodeExtendedPoints)(const uint8_t*, trackHat_ExtendedPointsSoA_t&);
+};
+
+static const Decoder DECODERS[] = {
+    { "ssse3",    Decode::isSsse3Supported(),                                 Decode::decodePointsSoASsse3, Decode::decodeExtendedPointsSoASsse3 },
+    { "avx2",     Decode::isAvx2Supported(),                                  Decode::decodePointsSoAAvx2,  Decode::decodeExtendedPointsSoAAvx2 },
+    { "neon",     std::strcmp(Decode::implementationName(), "neon") == 0,    Decode::decodePointsSoANeon,  Decode::decodeExtendedPointsSoANeon },
+    { "selected", true,                                                       Decode::decodePointsSoA,      Decode::decodeExtendedPointsSoA },
+};
+
+
+/**
+ * Payloads of the extended frame size, the basic frames use their beginning: random bytes
+ * with random empty slots of both point sizes, all bytes zero and all bytes one.
+ */
+static std::vector<std::vector<uint8_t>> makePayloads()
+{
+    std::vector<std::vector<uint8_t>> payloads;
+    payloads.push_back(std::vector<uint8_t>(Decode::ExtendedPointsPayloadSize, 0x00));
+    payloads.push_back(std::vector<uint8_t>(Decode::ExtendedPointsPayloadSize, 0xff));
+
+    std::mt19937 random(0);
+    for (size_t i = 0; i < PAYLOAD_COUNT; i++)
+    {
+        std::vector<uint8_t> payload(Decode::ExtendedPointsPayloadSize);
+        for (uint8_t& byte : payload)
+            byte = static_cast<uint8_t>(random());
+
+        const size_t pointSize = (i % 2 == 0) ? Decode::PointSize : Decode::ExtendedPointSize;
+        for (size_t slot = 0; slot < TRACK_HAT_NUMBER_OF_POINTS; slot++)
+        {
+            if (random() % 2 == 0)
+                std::memset(payload.data() + slot * pointSize, 0, pointSize);
+        }
+        payloads.push_back(payload);
+    }
+
+    return payloads;
+}
+
+void testDecoders()
+{
+    const std::vector<std::vector<uint8_t>> payloads = makePayloads();
+
+    for (const Decoder& decoder : DECODERS)
+    {
+        if (!decoder.m_isSupported)
+        {
+            std::printf("Decoder %s is not supported, skipping its checks\n", decoder.m_name);
+            continue;
+        }
+
+        int failedPayloads = 0;
+        for (const std::vector<uint8_t>& payload : payloads)
+        {
+            trackHat_PointsSoA_t expectedPoints = {};
+            trackHat_PointsSoA_t points = {};
+            Decode::decodePointsSoAScalar(payload.data(), expectedPoints);
+            decoder.m_decodePoints(payload.data(), points);
+
+            trackHat_ExtendedPointsSoA_t expectedExtendedPoints = {};
+            trackHat_ExtendedPointsSoA_t extendedPoints = {};
+            Decode::decodeExtendedPointsSoAScalar(payload.data(), expectedExtendedPoints);
+            decoder.m_decodeExtendedPoints(payload.data(), extendedPoints);
+
+            const bool isEqual = (std::memcmp(&points, &expectedPoints, sizeof(points)) == 0) &&
+                                 (std::memcmp(&extendedPoints, &expectedExtendedPoints, sizeof(extendedPoints)) == 0);
+            failedPayloads += isEqual ? 0 : 1;
+        }
+
+        if (failedPayloads != 0)
+            std::printf("Decoder %s differs on %d payloads\n", decoder.m_name, failedPayloads);
+        CHECK(failedPayloads == 0);
+    }
+}
+
+/* The scalar decoder into arrays against the decoder into points */
+void testScalarDecoder()
+{
+    for (const std::vector<uint8_t>& payload : makePayloads())
+    {
+        trackHat_Point_t expectedPoints[TRACK_HAT_NUMBER_OF_POINTS];
+        Decode::decodePoints(payload.data(), expectedPoints);
+
+        trackHat_PointsSoA_t points = {};
+        Decode::decodePointsSoAScalar(payload.data(), points);
+
+        Decode::ExtendedPointsView view(payload.data());
+        trackHat_ExtendedPointsSoA_t extendedPoints = {};
+        Decode::decodeExtendedPointsSoAScalar(payload.data(), extendedPoints);
+
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            CHECK(points.m_x[i] == expectedPoints[i].m_x);
+            CHECK(points.m_y[i] == expectedPoints[i].m_y);
+            CHECK(points.m_brightness[i] == expectedPoints[i].m_brightness);
+
+            trackHat_ExtendedPoint_t expectedPoint = {};
+            view[i].decode(expectedPoint);
+            CHECK(extendedPoints.m_area[i] == expectedPoint.m_area);
+            CHECK(extendedPoints.m_coordinateX[i] == expectedPoint.m_coordinateX);
+            CHECK(extendedPoints.m_coordinateY[i] == expectedPoint.m_coordinateY);
+            CHECK(extendedPoints.m_range[i] == expectedPoint.m_range);
+            CHECK(extendedPoints.m_radius[i] == expectedPoint.m_radius);
+            CHECK(extendedPoints.m_vy[i] == expectedPoint.m_vy);
+        }
+    }
+}
+
+/* The public accessors of the raw points and the decoder of the latest points against the view */
+void testRawPoints()
+{
+    for (const std::vector<uint8_t>& payload : makePayloads())
+    {
+        Decode::ExtendedPointsView view(payload.data());
+
+        trackHat_ExtendedPointsRaw_t rawPoints;
+        Decode::copyExtendedPointsRaw(payload.data(), rawPoints);
+
+        // The empty slots must be cleared, not left from the previous frame
+        trackHat_ExtendedPoints_t extendedPoints;
+        std::memset(&extendedPoints, 0xaa, sizeof(extendedPoints));
+        Decode::decodeExtendedPoints(payload.data(), extendedPoints);
+
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            const trackHat_ExtendedPointRaw_t* rawPoint = &rawPoints.m_point[i];
+            CHECK(trackHat_RawPointArea(rawPoint) == view[i].area());
+            CHECK(trackHat_RawPointX(rawPoint) == view[i].coordinateX());
+            CHECK(trackHat_RawPointY(rawPoint) == view[i].coordinateY());
+            CHECK(trackHat_RawPointRange(rawPoint) == view[i].range());
+            CHECK(trackHat_RawPointRadius(rawPoint) == view[i].radius());
+            CHECK(rawPoint->m_averageBrightness == view[i].averageBrightness());
+            CHECK(rawPoint->m_vy == view[i].vy());
+            CHECK((trackHat_RawPointIsDetected(rawPoint) != 0) == view[i].isDetected());
+
+            trackHat_ExtendedPoint_t expectedPoint = {};
+            view[i].decode(expectedPoint);
+            const trackHat_ExtendedPoint_t& point = extendedPoints.m_point[i];
+            CHECK(point.m_area == expectedPoint.m_area);
+            CHECK(point.m_coordinateX == expectedPoint.m_coordinateX);
+            CHECK(point.m_coordinateY == expectedPoint.m_coordinateY);
+            CHECK(point.m_range == expectedPoint.m_range);
+            CHECK(point.m_radius == expectedPoint.m_radius);
+            CHECK(point.m_boundryDown == expectedPoint.m_boundryDown);
+            CHECK(point.m_vy == expectedPoint.m_vy);
+        }
+    }
+}
+
+
+int main()
+{
+    std::printf("Selected decoder: %s\n", Decode::implementationName());
+
+    testScalarDecoder();
+    testRawPoints();
+    testDecoders();
+
+    if (failedChecks != 0)
+    {
+        std::printf("%d checks failed\n", failedChecks);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,405 @@
+// File:   track_hat_device_test.cpp
+// Brief:  Tests of the whole driver with the simulated and the replayed device
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_driver.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+static int failedChecks = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition))                                                       \
+        {                                                                       \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failedChecks++;                                                     \
+        }                                                                       \
+    } while (false)
+
+/* Points moving in the image of the simulated device, the other slots are empty */
+static const size_t MOCK_VISIBLE_POINTS = 4;
+
+/* Sets of points kept in the frame queue, more than the device sends in a test */
+static const uint32_t QUEUE_DEPTH = 8192;
+
+/* Capture file written and replayed by the test, in the working directory */
+static const char* CAPTURE_FILE_NAME = "track_hat_device_test.capture";
+
+
+void sleepMs(int timeMs)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeMs));
+}
+
+/* Seeded device sending 1000 sets of points per second, some of them with a damaged bit */
+trackHat_MockConfig_t mockConfig()
+{
+    trackHat_MockConfig_t config = {};
+    config.m_frameRateHz = 1000;
+    config.m_jitterUs = 200;
+    config.m_corruptedFramesPerMille = 50;
+    config.m_seed = 7;
+    config.m_serialNumber = 1;
+    return config;
+}
+
+/* Take all sets of points from the frame queue */
+std::vector<trackHat_Points_t> takeQueuedPoints(trackHat_Device_t* device)
+{
+    std::vector<trackHat_Points_t> points(QUEUE_DEPTH);
+    uint32_t count = 0;
+    CHECK(trackHat_GetDetectedPointsBatch(device, points.data(), QUEUE_DEPTH, &count) == TH_SUCCESS);
+    points.resize(count);
+    return points;
+}
+
+/* Frame sent by the simulated device, its points make one revolution in 360 frames */
+int mockFrameIndex(const trackHat_Points_t& points)
+{
+    const double PI = 3.14159265358979323846;
+    const double angle = std::atan2(points.m_point[0].m_y - 2048.0, points.m_point[0].m_x - 2048.0);
+    return (static_cast<int>(std::lround(angle * 180 / PI)) + 360) % 360;
+}
+
+/* Number of frames sent by the simulated device but not delivered, between the first and the last one */
+size_t countLostFrames(const std::vector<trackHat_Points_t>& frames)
+{
+    size_t lostFrames = 0;
+    for (size_t i = 1; i < frames.size(); i++)
+        lostFrames += (mockFrameIndex(frames[i]) - mockFrameIndex(frames[i - 1]) + 359) % 360;
+    return lostFrames;
+}
+
+/* Frames are numbered from zero without gaps and have the points of the simulated device */
+void checkFrameSequence(const std::vector<trackHat_Points_t>& frames)
+{
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        CHECK(frames[i].m_frameNumber == i);
+        if (i > 0)
+            CHECK(frames[i].m_timestampUs >= frames[i - 1].m_timestampUs);
+
+        for (size_t point = 0; point < TRACK_HAT_NUMBER_OF_POINTS; point++)
+        {
+            const trackHat_Point_t& p = frames[i].m_point[point];
+            const bool isDetected = (p.m_x != 0) || (p.m_y != 0) || (p.m_brightness != 0);
+            CHECK(isDetected == (point < MOCK_VISIBLE_POINTS));
+        }
+    }
+}
+
+
+/* Every set of points passed to the subscriber, with the frame numbers */
+struct SubscriberState
+{
+    std::vector<uint32_t> m_frameNumbers;
+};
+
+void frameSubscriber(void* context, TH_ErrorCode error, const trackHat_Points_t* const points)
+{
+    if (error == TH_SUCCESS)
+        static_cast<SubscriberState*>(context)->m_frameNumbers.push_back(points->m_frameNumber);
+}
+
+static std::atomic<uint32_t> callbackCount{0};
+
+void pointsCallback(TH_ErrorCode error, const trackHat_Points_t* const /*points*/)
+{
+    if (error == TH_SUCCESS)
+        callbackCount++;
+}
+
+void extendedPointsCallback(TH_ErrorCode error, const trackHat_ExtendedPoints_t* const /*points*/)
+{
+    if (error == TH_SUCCESS)
+        callbackCount++;
+}
+
+
+/**
+ * Basic frames with the callback thread, the subscribers and the pipelined register writes:
+ * every valid frame reaches the queue in order, the damaged ones are counted as CRC errors.
+ */
+void testMockDevice()
+{
+    trackHat_Device_t device;
+    CHECK(trackHat_Initialize(&device) == TH_SUCCESS);
+
+    const trackHat_MockConfig_t config = mockConfig();
+    CHECK(trackHat_DetectMockDevice(&device, &config) == TH_SUCCESS);
+    CHECK(trackHat_EnableFrameQueue(&device, QUEUE_DEPTH) == TH_SUCCESS);
+    CHECK(trackHat_Connect(&device, TH_FRAME_BASIC) == TH_SUCCESS);
+
+    SubscriberState everyFrame;
+    SubscriberState decimated;
+    const trackHat_SubscriptionConfig_t everyFrameConfig = {TH_DELIVER_EVERY_FRAME, TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH, 1};
+    const trackHat_SubscriptionConfig_t decimatedConfig = {TH_DELIVER_DECIMATED, TRACK_HAT_MAX_SUBSCRIPTION_QUEUE_DEPTH, 10};
+    uint32_t subscriptionIDs[2] = {};
+    CHECK(trackHat_Subscribe(&device, &everyFrameConfig, frameSubscriber, &everyFrame, &subscriptionIDs[0]) == TH_SUCCESS);
+    CHECK(trackHat_Subscribe(&device, &decimatedConfig, frameSubscriber, &decimated, &subscriptionIDs[1]) == TH_SUCCESS);
+
+    callbackCount = 0;
+    CHECK(trackHat_SetCallback(&device, pointsCallback) == TH_SUCCESS);
+
+    // More groups than the window of the commands in flight
+    std::vector<trackHat_SetRegister_t> registers;
+    for (uint32_t i = 0; i < 200; i++)
+        registers.push_back({static_cast<uint8_t>(i / 100), static_cast<uint8_t>(i % 100), static_cast<uint8_t>(i)});
+    std::vector<TH_ErrorCode> chunkResults((registers.size() + MAX_NUMBER_OF_REGISTERS - 1) / MAX_NUMBER_OF_REGISTERS, TH_ERROR_WRONG_PARAMETER);
+    CHECK(trackHat_SetRegisters(&device, registers.data(), static_cast<uint32_t>(registers.size()), chunkResults.data()) == TH_SUCCESS);
+    for (TH_ErrorCode chunkResult : chunkResults)
+        CHECK(chunkResult == TH_SUCCESS);
+
+    sleepMs(600);
+
+    for (uint32_t subscriptionID : subscriptionIDs)
+        CHECK(trackHat_Unsubscribe(&device, subscriptionID) == TH_SUCCESS);
+    CHECK(trackHat_SetCallback(&device, nullptr) == TH_SUCCESS);
+    CHECK(trackHat_Disconnect(&device) == TH_SUCCESS);
+
+    trackHat_Statistics_t statistics;
+    CHECK(trackHat_GetStatistics(&device, &statistics) == TH_SUCCESS);
+    trackHat_FrameQueueStatus_t status;
+    CHECK(trackHat_GetFrameQueueStatus(&device, &status) == TH_SUCCESS);
+    const std::vector<trackHat_Points_t> frames = takeQueuedPoints(&device);
+
+    std::printf("Mock device: %u frames, %u CRC errors, %u callbacks, %u and %u sets for the subscribers\n",
+                static_cast<unsigned>(frames.size()), static_cast<unsigned>(statistics.m_crcErrors),
+                static_cast<unsigned>(callbackCount.load()), static_cast<unsigned>(everyFrame.m_frameNumbers.size()),
+                static_cast<unsigned>(decimated.m_frameNumbers.size()));
+
+    CHECK(frames.size() > 300);
+    CHECK(frames.size() == statistics.m_coordinatesFrames);
+    CHECK(status.m_droppedPoints == 0);
+    checkFrameSequence(frames);
+
+    // About 5% of the frames are damaged and lost, each one gives at least one CRC error
+    const size_t lostFrames = countLostFrames(frames);
+    const size_t sentFrames = frames.size() + lostFrames;
+    std::printf("Mock device: %u frames lost\n", static_cast<unsigned>(lostFrames));
+    CHECK(lostFrames * 1000 >= sentFrames * 20);
+    CHECK(lostFrames * 1000 <= sentFrames * 100);
+    CHECK(statistics.m_crcErrors >= lostFrames);
+    CHECK(statistics.m_discardedBytes > 0);
+    CHECK(statistics.m_nackFrames == 0);
+    CHECK(statistics.m_commandTimeouts == 0);
+
+    CHECK((callbackCount > 0) && (callbackCount <= frames.size()));
+
+    CHECK(everyFrame.m_frameNumbers.size() > 300);
+    for (size_t i = 1; i < everyFrame.m_frameNumbers.size(); i++)
+        CHECK(everyFrame.m_frameNumbers[i] > everyFrame.m_frameNumbers[i - 1]);
+
+    CHECK(decimated.m_frameNumbers.size() > 30);
+    for (size_t i = 1; i < decimated.m_frameNumbers.size(); i++)
+        CHECK((decimated.m_frameNumbers[i] - decimated.m_frameNumbers[i - 1]) % 10 == 0);
+
+    trackHat_Deinitialize(&device);
+}
+
+/* Frames over the depth of the frame queue are dropped and counted */
+void testDroppedFrames()
+{
+    const uint32_t depth = 16;
+
+    trackHat_Device_t device;
+    CHECK(trackHat_Initialize(&device) == TH_SUCCESS);
+
+    const trackHat_MockConfig_t config = mockConfig();
+    CHECK(trackHat_DetectMockDevice(&device, &config) == TH_SUCCESS);
+    CHECK(trackHat_EnableFrameQueue(&device, depth) == TH_SUCCESS);
+    CHECK(trackHat_Connect(&device, TH_FRAME_BASIC) == TH_SUCCESS);
+    sleepMs(200);
+    CHECK(trackHat_Disconnect(&device) == TH_SUCCESS);
+
+    trackHat_Statistics_t statistics;
+    CHECK(trackHat_GetStatistics(&device, &statistics) == TH_SUCCESS);
+    trackHat_FrameQueueStatus_t status;
+    CHECK(trackHat_GetFrameQueueStatus(&device, &status) == TH_SUCCESS);
+
+    CHECK(status.m_pendingPoints == depth);
+    CHECK(status.m_droppedPoints + depth == statistics.m_coordinatesFrames);
+
+    // The oldest frames are kept
+    const std::vector<trackHat_Points_t> frames = takeQueuedPoints(&device);
+    CHECK(frames.size() == depth);
+    checkFrameSequence(frames);
+
+    trackHat_Deinitialize(&device);
+}
+
+/* Extended frames with the callback called by the receiver for every frame */
+void testInlineCallbacks()
+{
+    trackHat_Device_t device;
+    CHECK(trackHat_Initialize(&device) == TH_SUCCESS);
+
+    const trackHat_MockConfig_t config = mockConfig();
+    CHECK(trackHat_DetectMockDevice(&device, &config) == TH_SUCCESS);
+    CHECK(trackHat_EnableInlineCallbacks(&device, 1) == TH_SUCCESS);
+    CHECK(trackHat_Connect(&device, TH_FRAME_EXTENDED) == TH_SUCCESS);
+
+    // Only the frames received after the callback is set are passed to it
+    trackHat_Statistics_t statistics;
+    CHECK(trackHat_ResetStatistics(&device) == TH_SUCCESS);
+    callbackCount = 0;
+    CHECK(trackHat_SetExtendedPointsCallback(&device, extendedPointsCallback) == TH_SUCCESS);
+    sleepMs(300);
+    CHECK(trackHat_SetExtendedPointsCallback(&device, nullptr) == TH_SUCCESS);
+    CHECK(trackHat_GetStatistics(&device, &statistics) == TH_SUCCESS);
+    CHECK(trackHat_Disconnect(&device) == TH_SUCCESS);
+
+    std::printf("Inline callbacks: %u extended frames, %u callbacks\n",
+                static_cast<unsigned>(statistics.m_extendedCoordinatesFrames), static_cast<unsigned>(callbackCount.load()));
+
+    CHECK(statistics.m_extendedCoordinatesFrames > 100);
+    CHECK(callbackCount + 1 >= statistics.m_extendedCoordinatesFrames);
+    CHECK(callbackCount <= statistics.m_extendedCoordinatesFrames + 1);
+
+    trackHat_Deinitialize(&device);
+}
+
+/* Extended frames read as received and decoded by the reader, nothing is decoded by the receiver */
+void testExtendedRawPoints()
+{
+    trackHat_Device_t device;
+    CHECK(trackHat_Initialize(&device) == TH_SUCCESS);
+
+    const trackHat_MockConfig_t config = mockConfig();
+    CHECK(trackHat_DetectMockDevice(&device, &config) == TH_SUCCESS);
+    CHECK(trackHat_Connect(&device, TH_FRAME_EXTENDED) == TH_SUCCESS);
+
+    uint32_t lastFrameNumber = 0;
+    for (int frame = 0; frame < 20; frame++)
+    {
+        trackHat_ExtendedPointsRaw_t rawPoints;
+        trackHat_ExtendedPoints_t points;
+        CHECK(trackHat_GetDetectedPointsExtendedRaw(&device, &rawPoints) == TH_SUCCESS);
+        CHECK(trackHat_GetDetectedPointsExtended(&device, &points) == TH_SUCCESS);
+
+        CHECK((frame == 0) || (rawPoints.m_frameNumber > lastFrameNumber));
+        CHECK(points.m_frameNumber > rawPoints.m_frameNumber);
+        lastFrameNumber = points.m_frameNumber;
+
+        // The simulated points have constant areas, the other slots are empty
+        for (size_t i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
+        {
+            const uint16_t area = (i < MOCK_VISIBLE_POINTS) ? static_cast<uint16_t>(100 + 10 * i) : 0;
+            CHECK((trackHat_RawPointIsDetected(&rawPoints.m_point[i]) != 0) == (i < MOCK_VISIBLE_POINTS));
+            CHECK(trackHat_RawPointArea(&rawPoints.m_point[i]) == area);
+            CHECK(points.m_point[i].m_area == area);
+            CHECK((i < MOCK_VISIBLE_POINTS) || (points.m_point[i].m_coordinateX == 0));
+        }
+    }
+
+    CHECK(trackHat_Disconnect(&device) == TH_SUCCESS);
+    trackHat_Deinitialize(&device);
+}
+
+
+/* Frames of a recorded session are replayed in the same order, with the same errors */
+void testReplayDevice()
+{
+    std::vector<trackHat_Points_t> recordedFrames;
+    trackHat_Statistics_t recordedStatistics;
+    {
+        trackHat_Device_t device;
+        CHECK(trackHat_Initialize(&device) == TH_SUCCESS);
+
+        const trackHat_MockConfig_t config = mockConfig();
+        CHECK(trackHat_DetectMockDevice(&device, &config) == TH_SUCCESS);
+        CHECK(trackHat_EnableFrameQueue(&device, QUEUE_DEPTH) == TH_SUCCESS);
+        CHECK(trackHat_StartRecording(&device, CAPTURE_FILE_NAME) == TH_SUCCESS);
+        CHECK(trackHat_Connect(&device, TH_FRAME_BASIC) == TH_SUCCESS);
+        sleepMs(300);
+        CHECK(trackHat_Disconnect(&device) == TH_SUCCESS);
+        CHECK(trackHat_StopRecording(&device) == TH_SUCCESS);
+
+        CHECK(trackHat_GetStatistics(&device, &recordedStatistics) == TH_SUCCESS);
+        recordedFrames = takeQueuedPoints(&device);
+        trackHat_Deinitialize(&device);
+    }
+
+    std::vector<trackHat_Points_t> replayedFrames;
+    trackHat_Statistics_t replayedStatistics;
+    {
+        trackHat_Device_t device;
+        CHECK(trackHat_Initialize(&device) == TH_SUCCESS);
+        CHECK(trackHat_DetectReplayDevice(&device, CAPTURE_FILE_NAME, 0) == TH_SUCCESS);
+        CHECK(trackHat_EnableFrameQueue(&device, QUEUE_DEPTH) == TH_SUCCESS);
+        CHECK(trackHat_Connect(&device, TH_FRAME_BASIC) == TH_SUCCESS);
+
+        // The device is reported as disconnected at the end of the file
+        trackHat_Points_t points;
+        int waitMs = 0;
+        while ((trackHat_GetDetectedPoints(&device, &points) != TH_ERROR_DEVICE_DISCONNECTED) && (waitMs < 5000))
+        {
+            sleepMs(10);
+            waitMs += 10;
+        }
+        CHECK(waitMs < 5000);
+
+        CHECK(trackHat_GetStatistics(&device, &replayedStatistics) == TH_SUCCESS);
+        replayedFrames = takeQueuedPoints(&device);
+        trackHat_Disconnect(&device);
+        trackHat_Deinitialize(&device);
+    }
+
+    std::remove(CAPTURE_FILE_NAME);
+
+    std::printf("Replay: %u recorded and %u replayed frames, %u and %u CRC errors\n",
+                static_cast<unsigned>(recordedFrames.size()), static_cast<unsigned>(replayedFrames.size()),
+                static_cast<unsigned>(recordedStatistics.m_crcErrors), static_cast<unsigned>(replayedStatistics.m_crcErrors));
+
+    CHECK(recordedFrames.size() > 100);
+    CHECK(replayedFrames.size() == recordedFrames.size());
+    CHECK(replayedStatistics.m_crcErrors == recordedStatistics.m_crcErrors);
+    checkFrameSequence(replayedFrames);
+
+    for (size_t i = 0; (i < recordedFrames.size()) && (i < replayedFrames.size()); i++)
+    {
+        CHECK(replayedFrames[i].m_frameNumber == recordedFrames[i].m_frameNumber);
+        CHECK(std::memcmp(replayedFrames[i].m_point, recordedFrames[i].m_point, sizeof(recordedFrames[i].m_point)) == 0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* test = (argc > 1) ? argv[1] : "";
+
+    if (std::strcmp(test, "mock") == 0)
+    {
+        testMockDevice();
+        testDroppedFrames();
+        testInlineCallbacks();
+        testExtendedRawPoints();
+    }
+    else if (std::strcmp(test, "replay") == 0)
+    {
+        testReplayDevice();
+    }
+    else
+    {
+        std::printf("Usage: %s mock|replay\n", argv[0]);
+        return 1;
+    }
+
+    if (failedChecks != 0)
+    {
+        std::printf("%d checks failed\n", failedChecks);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+// File:   track_hat_registers_test.cpp
+// Brief:  Tests of the register cache of the TrackHat driver
+// Author: Piotr Nowicki <piotr.nowicki@wizzdev.pl>
+//------------------------------------------------------
+
+#include "track_hat_registers.h"
+
+#include <cstdio>
+
+
+static int failedChecks = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition))                                                       \
+        {                                                                       \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failedChecks++;                                                     \
+        }                                                                       \
+    } while (false)
+
+
+/* Number of the registers the cache lets through when writing 'reg' */
+static size_t countDirty(Registers::Shadow& shadow, trackHat_SetRegister_t reg)
+{
+    return shadow.removeClean(&reg, 1);
+}
+
+/* Acknowledged value is skipped, other values and rejected writes go out */
+void testAcknowledgedWrite()
+{
+    Registers::Shadow shadow;
+    shadow.enable(true);
+
+    const trackHat_SetRegister_t reg = {0x00, 0x19, 0x01};
+    CHECK(countDirty(shadow, reg) == 1);
+
+    shadow.send(1, &reg, 1);
+    CHECK(countDirty(shadow, reg) == 1);    // unknown until the ACK
+    shadow.complete(1, true);
+    CHECK(countDirty(shadow, reg) == 0);
+    CHECK(countDirty(shadow, {0x00, 0x19, 0x02}) == 1);
+
+    const trackHat_SetRegister_t other = {0x00, 0x19, 0x03};
+    shadow.send(2, &other, 1);
+    shadow.complete(2, false);
+    CHECK(countDirty(shadow, reg) == 1);
+    CHECK(countDirty(shadow, other) == 1);
+}
+
+/* The last write of a register repeated in one group is its value */
+void testDuplicateInGroup()
+{
+    Registers::Shadow shadow;
+    shadow.enable(true);
+
+    const trackHat_SetRegister_t group[] = {
+        {0x00, 0x19, 0x01},
+        {0x00, 0x1a, 0x05},
+        {0x00, 0x19, 0x02},
+    };
+    shadow.send(1, group, 3);
+    shadow.complete(1, true);
+
+    CHECK(countDirty(shadow, {0x00, 0x19, 0x01}) == 1);
+    CHECK(countDirty(shadow, {0x00, 0x19, 0x02}) == 0);
+    CHECK(countDirty(shadow, {0x00, 0x1a, 0x05}) == 0);
+}
+
+/* A later transaction writing the same register decides its value */
+void testOverlappingTransactions()
+{
+    Registers::Shadow shadow;
+    shadow.enable(true);
+
+    const trackHat_SetRegister_t first = {0x01, 0x10, 0x01};
+    const trackHat_SetRegister_t second = {0x01, 0x10, 0x02};
+    shadow.send(1, &first, 1);
+    shadow.send(2, &second, 1);
+    shadow.complete(1, true);
+    CHECK(countDirty(shadow, first) == 1);
+    CHECK(countDirty(shadow, second) == 1);
+
+    shadow.complete(2, true);
+    CHECK(countDirty(shadow, second) == 0);
+}
+
+
+int main()
+{
+    testAcknowledgedWrite();
+    testDuplicateInGroup();
+    testOverlappingTransactions();
+
+    if (failedChecks != 0)
+    {
+        std::printf("%d checks failed\n", failedChecks);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -10,9 +10,11 @@
 #include <iostream>
 #include <signal.h>
 #include <time.h>
-#include <Windows.h>
 #include <string>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
 
 
 /* Use callback to get the coordinates */
@@ -29,6 +31,12 @@ bool runApplication = true;
 /* Raprot error if detected */
 bool errorDetected = false;
 
+/* Use simulated camera instead of the one connected to USB port */
+bool useMockDevice = false;
+
+/* Only print the cameras connected to USB ports */
+bool listDevices = false;
+
 
 /* Operate the TrackHat camera after initializ and connect */
 void useCoordinates(trackHat_Device_t* device);
@@ -42,11 +50,41 @@ void printCoordinates(const trackHat_ExtendedPoints_t* const points);
 /* Print information aboit TrackHat device */
 void printTrackHatInfo(trackHat_Device_t* device);
 
+/* Print the counters of the communication with TrackHat device */
+void printTrackHatStatistics(trackHat_Device_t* device);
+
 /* New TrackHat points callback */
 void newPointCallback(TH_ErrorCode error, const trackHat_Points_t* const points);
 
 void newPointCallbackExtended(TH_ErrorCode error, const trackHat_ExtendedPoints_t* const points);
 
+/* Sleep the current thread */
+void sleepMs(int timeMs)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeMs));
+}
+
+/* Wait for a key press in the console */
+void pauseConsole()
+{
+#if defined(_WIN32)
+    system("pause");
+#else
+    printf("Press Enter to continue . . .\n");
+    getchar();
+#endif
+}
+
+/* Clear the console window */
+void clearConsole()
+{
+#if defined(_WIN32)
+    system("cls");
+#else
+    printf("\033[H\033[2J");
+#endif
+}
+
 /* handler for terminate signal */
 void signalHandler(int signal)
 {
@@ -60,6 +98,8 @@ void signalHandler(int signal)
 int processInputParameters(int argc, char* argv[])
 {
     const std::string HELP_OPTION = "--help";
+    const std::string MOCK_OPTION = "--mock";
+    const std::string LIST_OPTION = "--list";
     if (argc == 2)
     {
         if (argv[1] == HELP_OPTION)
@@ -67,6 +107,17 @@ int processInputParameters(int argc, char* argv[])
             std::cout << "Sample test application for TrackHat driver." << std::endl;
             std::cout << "This application can be used to connect PC with TrackHat Camera" << std::endl;
             std::cout << "using USB protocole based on TrackHat driver library." << std::endl;
+            std::cout << std::endl;
+            std::cout << "  --mock   Use simulated camera instead of the one connected to USB port." << std::endl;
+            std::cout << "  --list   Show all cameras connected to USB ports." << std::endl;
+        }
+        else if (argv[1] == MOCK_OPTION)
+        {
+            useMockDevice = true;
+        }
+        else if (argv[1] == LIST_OPTION)
+        {
+            listDevices = true;
         }
         else
         {
@@ -91,6 +142,18 @@ int main(int argc, char* argv[])
 {
     processInputParameters(argc, argv);
 
+    if (listDevices)
+    {
+        trackHat_DetectedDevice_t devices[8];
+        uint32_t count = 0;
+        trackHat_EnumerateDevices(devices, 8, &count);
+
+        printf("Found %u camera(s)\n", count);
+        for (uint32_t i = 0; (i < count) && (i < 8); i++)
+            printf("  %s  USB serial number: %s\n", devices[i].m_portName, devices[i].m_usbSerialNumber);
+        return 0;
+    }
+
     trackHat_Device_t device;
     TH_ErrorCode result;
 
@@ -108,7 +171,10 @@ int main(int argc, char* argv[])
     }
 
     // Detect device on USB port
-    result = trackHat_DetectDevice(&device);
+    if (useMockDevice)
+        result = trackHat_DetectMockDevice(&device, nullptr);
+    else
+        result = trackHat_DetectDevice(&device);
     if (result != TH_SUCCESS)
     {
         printf("Device not detected. Error %d\n", result);
@@ -133,7 +199,7 @@ int main(int argc, char* argv[])
     printTrackHatInfo(&device);
 
     printf("TrackHat camera is ready for use.\n");
-    system("pause");
+    pauseConsole();
 
     /*
      * Example how to set register group:
@@ -147,7 +213,8 @@ int main(int argc, char* argv[])
      *
      * trackHat_SetRegisterGroupValue(&device, &setRegisterGroup);
      *
-     * It's possible to set up to 19 registers
+     * It's possible to set up to 19 registers, 'trackHat_SetRegisters()' sets any number
+     * of registers in groups of 19.
      * */
 
     trackHat_SetRegisterGroup_t setRegisterGroup = {};
@@ -184,9 +251,9 @@ int main(int argc, char* argv[])
 //    trackHat_SetLeds_t setLedsSolid = {TH_LedState::TH_SOLID, TH_LedState::TH_SOLID, TH_LedState::TH_SOLID};
 //    trackHat_SetLeds_t setLedsOff = {TH_LedState::TH_OFF, TH_LedState::TH_OFF, TH_LedState::TH_OFF};
 //    trackHat_SetLeds(&device, &setLedsBlinking);
-//    ::Sleep(static_cast<time_t>(5000));
+//    sleepMs(5000);
 //    trackHat_SetLeds(&device, &setLedsSolid);
-//    ::Sleep(static_cast<time_t>(5000));
+//    sleepMs(5000);
 //    trackHat_SetLeds(&device, &setLedsOff);
 
     /*
@@ -214,6 +281,7 @@ int main(int argc, char* argv[])
         errorDetected = true;
     }
 
+    printTrackHatStatistics(&device);
     trackHat_Deinitialize(&device);
 
     if (errorDetected)
@@ -250,6 +318,33 @@ void printTrackHatInfo(trackHat_Device_t* device)
     }
 }
 
+void printTrackHatStatistics(trackHat_Device_t* device)
+{
+    trackHat_Statistics_t statistics;
+    if (trackHat_GetStatistics(device, &statistics) != TH_SUCCESS)
+        return;
+
+    const trackHat_Histogram_t& roundTrip = statistics.m_commandRoundTripUs;
+    const trackHat_Histogram_t& latency = statistics.m_callbackLatencyUs;
+
+    printf("TrackHat statistics:\n");
+    printf("    Received bytes    : %llu\n", static_cast<unsigned long long>(statistics.m_receivedBytes));
+    printf("    Frames            : %llu basic, %llu extended\n",
+           static_cast<unsigned long long>(statistics.m_coordinatesFrames),
+           static_cast<unsigned long long>(statistics.m_extendedCoordinatesFrames));
+    printf("    CRC errors        : %llu\n", static_cast<unsigned long long>(statistics.m_crcErrors));
+    printf("    Discarded bytes   : %llu\n", static_cast<unsigned long long>(statistics.m_discardedBytes));
+    printf("    ACK / NACK        : %llu / %llu\n",
+           static_cast<unsigned long long>(statistics.m_ackFrames),
+           static_cast<unsigned long long>(statistics.m_nackFrames));
+    printf("    Command timeouts  : %llu\n", static_cast<unsigned long long>(statistics.m_commandTimeouts));
+    if (roundTrip.m_count > 0)
+        printf("    Command RTT       : %.1f us on average\n", static_cast<double>(roundTrip.m_sum) / roundTrip.m_count);
+    if (latency.m_count > 0)
+        printf("    Callback latency  : %.1f us on average\n", static_cast<double>(latency.m_sum) / latency.m_count);
+    printf("\n");
+}
+
 void useCoordinates(trackHat_Device_t* device)
 {
 #if USE_CALLBACK_FUNCTION
@@ -261,7 +356,7 @@ void useCoordinates(trackHat_Device_t* device)
 
     while (runApplication)
     {
-        ::Sleep(100);
+        sleepMs(100);
     }
 
     trackHat_RemoveCallback(device);
@@ -275,7 +370,7 @@ void useCoordinates(trackHat_Device_t* device)
 
     while (runApplication)
     {
-        ::Sleep(100);
+        sleepMs(100);
     };
 
     trackHat_RemoveCallback(device);
@@ -297,7 +392,7 @@ void useCoordinates(trackHat_Device_t* device)
 
     while (1)//runApplication)
     {
-        ::Sleep(static_cast<DWORD>(timeoutSec * 1000));
+        sleepMs(static_cast<int>(timeoutSec * 1000));
 
 #if USE_EXTENDED_COORDINATES
         trackHat_ExtendedPoints_t extendedPoints;
@@ -317,7 +412,7 @@ void useCoordinates(trackHat_Device_t* device)
         {
             printf("Get coordinates error: %d\n", result);
             errorDetected = true;
-            ::Sleep(static_cast<DWORD>(timeoutSec * 1000));
+            sleepMs(static_cast<int>(timeoutSec * 1000));
         }
 #else
         trackHat_Points_t points;
@@ -337,7 +432,7 @@ void useCoordinates(trackHat_Device_t* device)
         {
             printf("Get coordinates error: %d\n", result);
             errorDetected = true;
-            ::Sleep(static_cast<DWORD>(timeoutSec * 1000));
+            sleepMs(static_cast<int>(timeoutSec * 1000));
         }
 #endif
 
@@ -397,7 +492,7 @@ void printCoordinates(const trackHat_Points_t* const points)
 {
     if (runApplication)
     {
-        system("cls");
+        clearConsole();
         printf("TrackHat points:\n");
         for (int i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
         {
@@ -414,7 +509,7 @@ void printCoordinates(const trackHat_ExtendedPoints_t* const points)
 {
     if (runApplication)
     {
-        system("cls");
+        clearConsole();
         printf("TrackHat points:\n");
         for (int i = 0; i < TRACK_HAT_NUMBER_OF_POINTS; i++)
         {